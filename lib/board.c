@@ -0,0 +1,162 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "board.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef HAVE_SHM_OPEN
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+struct DaliBoard {
+	char *name;
+	DaliBoardData *data;
+};
+
+DaliBoardPtr daliboard_new(const char *name) {
+#ifdef HAVE_SHM_OPEN
+	int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+	if (fd == -1) {
+		log_error("Error creating shared memory segment %s: %s", name, strerror(errno));
+		return NULL;
+	}
+	if (ftruncate(fd, sizeof(DaliBoardData)) == -1) {
+		log_error("Error resizing shared memory segment %s: %s", name, strerror(errno));
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+	void *data = mmap(NULL, sizeof(DaliBoardData), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		log_error("Error mapping shared memory segment %s: %s", name, strerror(errno));
+		shm_unlink(name);
+		return NULL;
+	}
+	DaliBoardPtr board = malloc(sizeof(struct DaliBoard));
+	if (!board) {
+		munmap(data, sizeof(DaliBoardData));
+		shm_unlink(name);
+		return NULL;
+	}
+	board->name = strdup(name);
+	board->data = (DaliBoardData *) data;
+	memset(board->data, 0, sizeof(DaliBoardData));
+	board->data->devices = DALISTATE_DEVICES;
+	board->data->version = DALIBOARD_VERSION;
+	// Readers check this last
+	__sync_synchronize();
+	board->data->magic = DALIBOARD_MAGIC;
+	return board;
+#else
+	log_error("Shared memory is not supported on this system");
+	return NULL;
+#endif
+}
+
+void daliboard_free(DaliBoardPtr board) {
+#ifdef HAVE_SHM_OPEN
+	if (board) {
+		munmap(board->data, sizeof(DaliBoardData));
+		if (board->name) {
+			shm_unlink(board->name);
+		}
+		free(board->name);
+		free(board);
+	}
+#endif
+}
+
+void daliboard_update(DaliBoardPtr board, DaliStatePtr state) {
+	if (board && state) {
+		DaliBoardData *data = board->data;
+		data->sequence++;
+		__sync_synchronize();
+		unsigned int i;
+		for (i = 0; i < DALISTATE_DEVICES; i++) {
+			const DaliDeviceState *device = dalistate_device(state, i);
+			data->device[i].flags = device->flags;
+			data->device[i].level = device->level;
+			data->device[i].status = device->status;
+			data->device[i].groups = device->groups;
+			data->device[i].changed = device->changed;
+		}
+		__sync_synchronize();
+		data->sequence++;
+	}
+}
+
+const DaliBoardData *daliboard_attach(const char *name) {
+#ifdef HAVE_SHM_OPEN
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd == -1) {
+		return NULL;
+	}
+	void *data = mmap(NULL, sizeof(DaliBoardData), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+	const DaliBoardData *board = (const DaliBoardData *) data;
+	if (board->magic != DALIBOARD_MAGIC || board->version != DALIBOARD_VERSION) {
+		munmap(data, sizeof(DaliBoardData));
+		return NULL;
+	}
+	return board;
+#else
+	return NULL;
+#endif
+}
+
+void daliboard_detach(const DaliBoardData *data) {
+#ifdef HAVE_SHM_OPEN
+	if (data) {
+		munmap((void *) data, sizeof(DaliBoardData));
+	}
+#endif
+}
+
+uint32_t daliboard_snapshot(const DaliBoardData *data, DaliBoardData *copy) {
+	uint32_t sequence;
+	while (1) {
+		sequence = data->sequence;
+		if (sequence & 1) {
+			// Update in progress
+			continue;
+		}
+		__sync_synchronize();
+		memcpy(copy, (const void *) data, sizeof(DaliBoardData));
+		__sync_synchronize();
+		if (data->sequence == sequence) {
+			break;
+		}
+	}
+	copy->sequence = sequence;
+	return sequence;
+}
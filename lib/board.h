@@ -0,0 +1,82 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _BOARD_H
+#define _BOARD_H
+
+#include <stdint.h>
+#include "state.h"
+
+// A read-only view of the device state table in POSIX shared memory
+// Local processes can map it and read the state without talking to the server.
+// The layout is fixed, readers should check magic and version.
+
+#define DALIBOARD_MAGIC 0x44414c49
+#define DALIBOARD_VERSION 1
+
+typedef struct {
+	// DALISTATE_ flags
+	uint8_t flags;
+	// Arc power level, 0 = off
+	uint8_t level;
+	// Last reported status byte
+	uint8_t status;
+	uint8_t reserved;
+	// Group membership, bit n = group n
+	uint16_t groups;
+	uint16_t reserved2;
+	// Time of the last change in msec on the monotonic clock (CLOCK_MONOTONIC)
+	uint64_t changed;
+} DaliBoardDevice;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	// Odd while the server is writing, incremented twice for each update
+	volatile uint32_t sequence;
+	uint32_t devices;
+	DaliBoardDevice device[DALISTATE_DEVICES];
+} DaliBoardData;
+
+struct DaliBoard;
+typedef struct DaliBoard *DaliBoardPtr;
+
+// Creates the shared memory segment name and publishes an empty table
+// name must start with a slash. Returns NULL if shared memory is not available.
+DaliBoardPtr daliboard_new(const char *name);
+// Unmaps and removes the segment
+void daliboard_free(DaliBoardPtr board);
+// Copies the current state table into the segment
+void daliboard_update(DaliBoardPtr board, DaliStatePtr state);
+// Maps an existing segment read-only, for readers
+// Returns NULL if it doesn't exist or has the wrong layout
+const DaliBoardData *daliboard_attach(const char *name);
+// Unmaps a segment mapped by daliboard_attach
+void daliboard_detach(const DaliBoardData *data);
+// Takes a consistent copy of the segment, retrying while the server is writing
+// Returns the sequence number of the copy
+uint32_t daliboard_snapshot(const DaliBoardData *data, DaliBoardData *copy);
+
+#endif /*_BOARD_H*/
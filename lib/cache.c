@@ -0,0 +1,268 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Number of short addresses on a bus
+#define DALICACHE_DEVICES 64
+// Queries that are cached, application extended queries depend on the enabled device type
+#define DALICACHE_FIRST_QUERY 0x90
+#define DALICACHE_LAST_QUERY 0xc4
+#define DALICACHE_QUERIES (DALICACHE_LAST_QUERY - DALICACHE_FIRST_QUERY + 1)
+
+// Responses that change when the lamp is switched or dimmed
+static const unsigned int DALICACHE_TTL_VOLATILE = 1000; //msec
+// Responses that only change with configuration commands
+static const unsigned int DALICACHE_TTL_CONFIG = 600000; //msec
+// Responses that never change
+static const unsigned int DALICACHE_TTL_CONSTANT = 3600000; //msec
+// Failure states can change at any time without a command
+static const unsigned int DALICACHE_TTL_FAILURE = 5000; //msec
+
+typedef struct {
+	// Time after which the entry is invalid, 0 if it's empty
+	unsigned long expires;
+	// Subscriber slots that have read the response, bit n = slot n
+	uint64_t readers;
+	uint8_t response;
+} DaliCacheEntry;
+
+struct DaliCache {
+	DaliCacheEntry entries[DALICACHE_DEVICES][DALICACHE_QUERIES];
+	// Allocated subscriber slots
+	uint64_t slots;
+	DaliCacheInvalidateCallback callback;
+	void *arg;
+};
+
+static int dalicache_volatile(uint8_t opcode);
+static int dalicache_member(DaliCachePtr cache, unsigned int device, unsigned int group, unsigned long now);
+static void dalicache_drop(DaliCachePtr cache, unsigned int device, int all);
+static void dalicache_notify(DaliCachePtr cache, unsigned int device, unsigned int query);
+static DaliCacheEntry *dalicache_entry(DaliCachePtr cache, DaliFramePtr frame);
+
+DaliCachePtr dalicache_new() {
+	DaliCachePtr cache = malloc(sizeof(struct DaliCache));
+	if (cache) {
+		memset(cache, 0, sizeof(struct DaliCache));
+	}
+	return cache;
+}
+
+void dalicache_free(DaliCachePtr cache) {
+	free(cache);
+}
+
+unsigned int dalicache_ttl(uint8_t opcode) {
+	switch (opcode) {
+	case 0x90: // status
+	case 0x93: // lamp power on
+	case 0x95: // reset state
+	case 0xa0: // actual level
+		return DALICACHE_TTL_VOLATILE;
+	case 0x91: // control gear present
+	case 0x92: // lamp failure
+	case 0x94: // limit error
+	case 0x96: // missing short address
+	case 0x9b: // power failure
+		return DALICACHE_TTL_FAILURE;
+	case 0x97: // version number
+	case 0x99: // device type
+	case 0x9a: // physical minimum level
+		return DALICACHE_TTL_CONSTANT;
+	case 0xa1: // max level
+	case 0xa2: // min level
+	case 0xa3: // power on level
+	case 0xa4: // system failure level
+	case 0xa5: // fade time and rate
+	case 0xc0: // groups 0-7
+	case 0xc1: // groups 8-15
+	case 0xc2: // random address
+	case 0xc3:
+	case 0xc4:
+		return DALICACHE_TTL_CONFIG;
+	default:
+		// Scene levels
+		if (opcode >= 0xb0 && opcode <= 0xbf) {
+			return DALICACHE_TTL_CONFIG;
+		}
+		// DTR contents, reserved and device type specific queries
+		return 0;
+	}
+}
+
+static int dalicache_volatile(uint8_t opcode) {
+	return dalicache_ttl(opcode) <= DALICACHE_TTL_FAILURE;
+}
+
+static DaliCacheEntry *dalicache_entry(DaliCachePtr cache, DaliFramePtr frame) {
+	// Only short addresses, the answers from groups may be a mix of several devices
+	if (cache && frame && frame->ecommand == 0 && daliframe_classify(frame) == DALIFRAME_CLASS_QUERY && (frame->address & 0x80) == 0) {
+		if (dalicache_ttl(frame->command) > 0) {
+			return &cache->entries[frame->address >> 1][frame->command - DALICACHE_FIRST_QUERY];
+		}
+	}
+	return NULL;
+}
+
+int dalicache_lookup(DaliCachePtr cache, DaliFramePtr frame, unsigned long now, uint8_t *response) {
+	DaliCacheEntry *entry = dalicache_entry(cache, frame);
+	if (entry && entry->expires > now) {
+		if (response) {
+			*response = entry->response;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+void dalicache_store(DaliCachePtr cache, DaliFramePtr frame, uint8_t response, unsigned long now) {
+	DaliCacheEntry *entry = dalicache_entry(cache, frame);
+	if (entry) {
+		// The state changed without a command we could see
+		if (entry->readers && entry->response != response) {
+			dalicache_notify(cache, frame->address >> 1, frame->command - DALICACHE_FIRST_QUERY);
+		}
+		entry->response = response;
+		entry->expires = now + dalicache_ttl(frame->command);
+	}
+}
+
+static int dalicache_member(DaliCachePtr cache, unsigned int device, unsigned int group, unsigned long now) {
+	DaliCacheEntry *entry = &cache->entries[device][(group < 8 ? 0xc0 : 0xc1) - DALICACHE_FIRST_QUERY];
+	if (entry->expires > now) {
+		return (entry->response >> (group & 7)) & 1;
+	}
+	// Unknown, assume it is
+	return 1;
+}
+
+static void dalicache_drop(DaliCachePtr cache, unsigned int device, int all) {
+	unsigned int i;
+	for (i = 0; i < DALICACHE_QUERIES; i++) {
+		if (all || dalicache_volatile((uint8_t) (DALICACHE_FIRST_QUERY + i))) {
+			cache->entries[device][i].expires = 0;
+			dalicache_notify(cache, device, i);
+		}
+	}
+}
+
+static void dalicache_notify(DaliCachePtr cache, unsigned int device, unsigned int query) {
+	uint64_t readers = cache->entries[device][query].readers;
+	cache->entries[device][query].readers = 0;
+	if (cache->callback) {
+		while (readers) {
+			unsigned int slot = __builtin_ctzll(readers);
+			readers &= readers - 1;
+			cache->callback(slot, (uint8_t) ((device << 1) | 1), (uint8_t) (DALICACHE_FIRST_QUERY + query), cache->arg);
+		}
+	}
+}
+
+unsigned int dalicache_invalidate(DaliCachePtr cache, DaliFramePtr frame, unsigned long now) {
+	unsigned int dropped = 0;
+	if (cache && frame) {
+		DaliFrameClass cls = daliframe_classify(frame);
+		unsigned int device;
+		switch (cls) {
+		case DALIFRAME_CLASS_QUERY:
+			break;
+		case DALIFRAME_CLASS_SPECIAL:
+			// Setting the DTRs and enabling device types doesn't change any query responses
+			if (frame->ecommand == 0 && (frame->address == 0xa3 || frame->address == 0xc1 || frame->address == 0xc3 || frame->address == 0xc5)) {
+				break;
+			}
+			// Addressing may change everything
+			dalicache_clear(cache);
+			dropped = DALICACHE_DEVICES;
+			break;
+		default:
+			for (device = 0; device < DALICACHE_DEVICES; device++) {
+				int affected;
+				if ((frame->address & 0x80) == 0) {
+					affected = (frame->address >> 1) == device;
+				} else if ((frame->address & 0xe0) == 0x80) {
+					affected = dalicache_member(cache, device, (frame->address >> 1) & 0x0f, now);
+				} else {
+					affected = 1;
+				}
+				if (affected) {
+					// Level changes don't touch the configuration
+					dalicache_drop(cache, device, cls == DALIFRAME_CLASS_CONFIG);
+					dropped++;
+				}
+			}
+			break;
+		}
+	}
+	return dropped;
+}
+
+void dalicache_clear(DaliCachePtr cache) {
+	if (cache) {
+		unsigned int device;
+		for (device = 0; device < DALICACHE_DEVICES; device++) {
+			dalicache_drop(cache, device, 1);
+		}
+	}
+}
+
+void dalicache_set_invalidate_callback(DaliCachePtr cache, DaliCacheInvalidateCallback callback, void *arg) {
+	if (cache) {
+		cache->callback = callback;
+		cache->arg = arg;
+	}
+}
+
+int dalicache_subscribe(DaliCachePtr cache) {
+	if (cache && cache->slots != ~(uint64_t) 0) {
+		int slot = __builtin_ctzll(~cache->slots);
+		cache->slots |= (uint64_t) 1 << slot;
+		return slot;
+	}
+	return -1;
+}
+
+void dalicache_unsubscribe(DaliCachePtr cache, int slot) {
+	if (cache && slot >= 0 && slot < DALICACHE_SLOTS) {
+		uint64_t mask = ~((uint64_t) 1 << slot);
+		unsigned int device, i;
+		for (device = 0; device < DALICACHE_DEVICES; device++) {
+			for (i = 0; i < DALICACHE_QUERIES; i++) {
+				cache->entries[device][i].readers &= mask;
+			}
+		}
+		cache->slots &= mask;
+	}
+}
+
+void dalicache_track(DaliCachePtr cache, DaliFramePtr frame, int slot) {
+	DaliCacheEntry *entry = dalicache_entry(cache, frame);
+	if (entry && slot >= 0 && slot < DALICACHE_SLOTS) {
+		entry->readers |= (uint64_t) 1 << slot;
+	}
+}
@@ -0,0 +1,69 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stdint.h>
+#include "frame.h"
+
+// Maximum number of connections that can track responses at the same time
+#define DALICACHE_SLOTS 64
+
+struct DaliCache;
+typedef struct DaliCache *DaliCachePtr;
+
+// Called when a response that was read by a subscriber has been invalidated or has changed
+// address is the short address as sent with the query (0AAAAAA1)
+typedef void (*DaliCacheInvalidateCallback)(unsigned int slot, uint8_t address, uint8_t opcode, void *arg);
+
+// Creates an empty cache for query responses of the 64 short addresses
+DaliCachePtr dalicache_new();
+// Destroys the cache
+void dalicache_free(DaliCachePtr cache);
+// Returns how long the response to a query may be cached in msec, 0 if it must not be
+unsigned int dalicache_ttl(uint8_t opcode);
+// Looks up the response to a query
+// Returns 1 and stores the response if there is a valid entry, 0 otherwise
+int dalicache_lookup(DaliCachePtr cache, DaliFramePtr frame, unsigned long now, uint8_t *response);
+// Stores the response to a query, frames that aren't cacheable are ignored
+void dalicache_store(DaliCachePtr cache, DaliFramePtr frame, uint8_t response, unsigned long now);
+// Drops all entries that may have been changed by a command
+// Queries don't change anything and are ignored.
+// Returns the number of devices whose entries were dropped
+unsigned int dalicache_invalidate(DaliCachePtr cache, DaliFramePtr frame, unsigned long now);
+// Drops all entries
+void dalicache_clear(DaliCachePtr cache);
+// Sets the callback for invalidation messages
+void dalicache_set_invalidate_callback(DaliCachePtr cache, DaliCacheInvalidateCallback callback, void *arg);
+// Allocates a subscriber slot, returns -1 if all slots are in use
+int dalicache_subscribe(DaliCachePtr cache);
+// Releases a subscriber slot and forgets everything it has read
+void dalicache_unsubscribe(DaliCachePtr cache, int slot);
+// Records that a subscriber has read the response to a query
+// The callback is called once when the response is invalidated, the query must be read again to get the next one
+void dalicache_track(DaliCachePtr cache, DaliFramePtr frame, int slot);
+
+#endif /*_CACHE_H*/
@@ -0,0 +1,364 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "commission.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Special commands
+#define DALICOMMISSION_TERMINATE 0xa1
+#define DALICOMMISSION_INITIALISE 0xa5
+#define DALICOMMISSION_RANDOMISE 0xa7
+#define DALICOMMISSION_COMPARE 0xa9
+#define DALICOMMISSION_WITHDRAW 0xab
+#define DALICOMMISSION_SEARCHADDRH 0xb1
+#define DALICOMMISSION_SEARCHADDRM 0xb3
+#define DALICOMMISSION_SEARCHADDRL 0xb5
+#define DALICOMMISSION_PROGRAM_SHORT_ADDRESS 0xb7
+#define DALICOMMISSION_VERIFY_SHORT_ADDRESS 0xb9
+// Query random address (low byte), H and M are the two commands before it
+#define DALICOMMISSION_QUERY_RANDOM_ADDRESSL 0xc4
+
+typedef enum {
+	DALICOMMISSION_PHASE_INITIALISE,
+	DALICOMMISSION_PHASE_RANDOMISE,
+	// Is there any device left in the search window?
+	DALICOMMISSION_PHASE_CHECK,
+	DALICOMMISSION_PHASE_SEARCH,
+	DALICOMMISSION_PHASE_PROGRAM,
+	DALICOMMISSION_PHASE_VERIFY,
+	// Fast mode: does the new address belong to the device that was searched?
+	DALICOMMISSION_PHASE_CONFIRM,
+	DALICOMMISSION_PHASE_WITHDRAW,
+	// Fast mode: is the part of the search window that had a single answer really empty now?
+	DALICOMMISSION_PHASE_GAP,
+	DALICOMMISSION_PHASE_TERMINATE,
+	DALICOMMISSION_PHASE_DONE,
+} DaliCommissionPhase;
+
+struct DaliCommission {
+	unsigned int flags;
+	DaliCommissionPhase phase;
+	// A frame was returned and its result hasn't been set yet
+	int waiting;
+	// The phase that handles the result, DALICOMMISSION_PHASE_DONE if it isn't needed
+	DaliCommissionPhase pending;
+	int failed;
+	uint64_t used;
+	// Short address for the next device
+	uint8_t address;
+	// Search window, the lowest remaining random address is in [low, high]
+	uint32_t low;
+	uint32_t high;
+	// Address that was compared last
+	uint32_t probe;
+	// The adapter's search address, bit n of search_valid = byte n is known
+	uint32_t search;
+	unsigned int search_valid;
+	// Fast mode: highest compare address with a single answer,
+	// lowest compare address with a collision in the current search
+	int64_t single;
+	int64_t collision;
+	int verified;
+	// Fast mode: random address bytes left to confirm
+	int confirm;
+	unsigned long frames;
+	DaliCommissionDevice devices[64];
+	size_t count;
+};
+
+static int dalicommission_next_address(DaliCommissionPtr commission);
+static int dalicommission_set_search(DaliCommissionPtr commission, uint32_t address, DaliFramePtr *frame);
+static DaliCommissionStatus dalicommission_send(DaliCommissionPtr commission, uint8_t address, uint8_t command, DaliCommissionPhase pending, DaliFramePtr *frame);
+static void dalicommission_next_window(DaliCommissionPtr commission);
+static void dalicommission_narrow(DaliCommissionPtr commission);
+static void dalicommission_fallback(DaliCommissionPtr commission);
+
+DaliCommissionPtr dalicommission_new(unsigned int flags, uint64_t used) {
+	DaliCommissionPtr commission = malloc(sizeof(struct DaliCommission));
+	if (commission) {
+		memset(commission, 0, sizeof(struct DaliCommission));
+		commission->flags = flags;
+		commission->phase = DALICOMMISSION_PHASE_INITIALISE;
+		commission->pending = DALICOMMISSION_PHASE_DONE;
+		commission->used = used;
+		commission->low = 0;
+		commission->high = DALICOMMISSION_RANDOM_MAX;
+		commission->single = -1;
+		commission->collision = -1;
+	}
+	return commission;
+}
+
+void dalicommission_free(DaliCommissionPtr commission) {
+	free(commission);
+}
+
+static int dalicommission_next_address(DaliCommissionPtr commission) {
+	if (~commission->used == 0) {
+		return 0;
+	}
+	commission->address = (uint8_t) __builtin_ctzll(~commission->used);
+	return 1;
+}
+
+static int dalicommission_set_search(DaliCommissionPtr commission, uint32_t address, DaliFramePtr *frame) {
+	// Only the bytes that changed are sent, a search step usually changes one
+	static const uint8_t commands[] = { DALICOMMISSION_SEARCHADDRL, DALICOMMISSION_SEARCHADDRM, DALICOMMISSION_SEARCHADDRH };
+	int i;
+	for (i = 2; i >= 0; i--) {
+		uint8_t byte = (uint8_t) (address >> (i * 8));
+		if (!(commission->search_valid & (1 << i)) || (uint8_t) (commission->search >> (i * 8)) != byte) {
+			commission->search = (commission->search & ~((uint32_t) 0xff << (i * 8))) | ((uint32_t) byte << (i * 8));
+			commission->search_valid |= 1 << i;
+			dalicommission_send(commission, commands[i], byte, DALICOMMISSION_PHASE_DONE, frame);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static DaliCommissionStatus dalicommission_send(DaliCommissionPtr commission, uint8_t address, uint8_t command, DaliCommissionPhase pending, DaliFramePtr *frame) {
+	*frame = daliframe_new(address, command);
+	if (!*frame) {
+		return DALICOMMISSION_ERROR;
+	}
+	commission->frames++;
+	commission->pending = pending;
+	commission->waiting = 1;
+	return DALICOMMISSION_SEND;
+}
+
+static void dalicommission_next_window(DaliCommissionPtr commission) {
+	uint32_t found = commission->low;
+	commission->high = DALICOMMISSION_RANDOM_MAX;
+	if (found == DALICOMMISSION_RANDOM_MAX) {
+		commission->phase = DALICOMMISSION_PHASE_TERMINATE;
+		return;
+	}
+	commission->low = found + 1;
+	commission->phase = DALICOMMISSION_PHASE_CHECK;
+	if (commission->flags & DALICOMMISSION_FAST) {
+		// A single answer at or above the device that was found means it was the only one
+		// up to there, unless several devices answered with the same 0xff. That is checked
+		// with one compare after the device is withdrawn.
+		if (commission->single >= (int64_t) commission->low) {
+			commission->phase = DALICOMMISSION_PHASE_GAP;
+			return;
+		}
+		dalicommission_narrow(commission);
+	}
+	commission->single = -1;
+	commission->collision = -1;
+}
+
+static void dalicommission_narrow(DaliCommissionPtr commission) {
+	// A collision means there is another device up to there
+	if (commission->collision >= (int64_t) commission->low) {
+		commission->high = (uint32_t) commission->collision;
+		commission->phase = DALICOMMISSION_PHASE_SEARCH;
+	}
+	if (commission->low > commission->high) {
+		commission->phase = DALICOMMISSION_PHASE_TERMINATE;
+	}
+}
+
+static void dalicommission_fallback(DaliCommissionPtr commission) {
+	// The answers can't be trusted on this bus, continue with the normal search
+	commission->flags &= ~DALICOMMISSION_FAST;
+	commission->single = -1;
+	commission->collision = -1;
+}
+
+DaliCommissionStatus dalicommission_step(DaliCommissionPtr commission, DaliFramePtr *frame, int *twice) {
+	if (!commission || !frame || !twice || commission->waiting) {
+		return DALICOMMISSION_ERROR;
+	}
+	*twice = 0;
+	for (;;) {
+		switch (commission->phase) {
+		case DALICOMMISSION_PHASE_INITIALISE:
+			*twice = 1;
+			commission->phase = DALICOMMISSION_PHASE_RANDOMISE;
+			commission->frames++;
+			return dalicommission_send(commission, DALICOMMISSION_INITIALISE, (commission->flags & DALICOMMISSION_UNADDRESSED) ? 0xff : 0x00, DALICOMMISSION_PHASE_INITIALISE, frame);
+		case DALICOMMISSION_PHASE_RANDOMISE:
+			*twice = 1;
+			commission->phase = DALICOMMISSION_PHASE_CHECK;
+			commission->frames++;
+			return dalicommission_send(commission, DALICOMMISSION_RANDOMISE, 0x00, DALICOMMISSION_PHASE_RANDOMISE, frame);
+		case DALICOMMISSION_PHASE_CHECK:
+			if (!dalicommission_next_address(commission)) {
+				commission->phase = DALICOMMISSION_PHASE_TERMINATE;
+				break;
+			}
+			if (dalicommission_set_search(commission, commission->high, frame)) {
+				return DALICOMMISSION_SEND;
+			}
+			commission->probe = commission->high;
+			return dalicommission_send(commission, DALICOMMISSION_COMPARE, 0x00, DALICOMMISSION_PHASE_CHECK, frame);
+		case DALICOMMISSION_PHASE_SEARCH:
+			if (commission->low >= commission->high) {
+				commission->phase = DALICOMMISSION_PHASE_PROGRAM;
+				break;
+			}
+			commission->probe = commission->low + (commission->high - commission->low) / 2;
+			if (dalicommission_set_search(commission, commission->probe, frame)) {
+				return DALICOMMISSION_SEND;
+			}
+			return dalicommission_send(commission, DALICOMMISSION_COMPARE, 0x00, DALICOMMISSION_PHASE_SEARCH, frame);
+		case DALICOMMISSION_PHASE_PROGRAM:
+			if (!dalicommission_next_address(commission)) {
+				commission->phase = DALICOMMISSION_PHASE_TERMINATE;
+				break;
+			}
+			if (dalicommission_set_search(commission, commission->low, frame)) {
+				return DALICOMMISSION_SEND;
+			}
+			commission->verified = 0;
+			commission->phase = DALICOMMISSION_PHASE_VERIFY;
+			if (commission->flags & DALICOMMISSION_FAST) {
+				commission->verified = 1;
+				commission->confirm = 3;
+				commission->phase = DALICOMMISSION_PHASE_CONFIRM;
+			}
+			return dalicommission_send(commission, DALICOMMISSION_PROGRAM_SHORT_ADDRESS, (uint8_t) ((commission->address << 1) | 1), DALICOMMISSION_PHASE_PROGRAM, frame);
+		case DALICOMMISSION_PHASE_VERIFY:
+			commission->phase = DALICOMMISSION_PHASE_WITHDRAW;
+			return dalicommission_send(commission, DALICOMMISSION_VERIFY_SHORT_ADDRESS, (uint8_t) ((commission->address << 1) | 1), DALICOMMISSION_PHASE_VERIFY, frame);
+		case DALICOMMISSION_PHASE_CONFIRM:
+			if (!commission->verified) {
+				// Nobody or somebody else has the address, search again from the same device
+				dalicommission_fallback(commission);
+				commission->high = DALICOMMISSION_RANDOM_MAX;
+				commission->phase = DALICOMMISSION_PHASE_CHECK;
+				break;
+			}
+			if (commission->confirm == 0) {
+				commission->phase = DALICOMMISSION_PHASE_WITHDRAW;
+				break;
+			}
+			commission->confirm--;
+			return dalicommission_send(commission, (uint8_t) ((commission->address << 1) | 1), (uint8_t) (DALICOMMISSION_QUERY_RANDOM_ADDRESSL - commission->confirm), DALICOMMISSION_PHASE_CONFIRM, frame);
+		case DALICOMMISSION_PHASE_WITHDRAW: {
+			DaliCommissionDevice *device = &commission->devices[commission->count++];
+			device->address = commission->address;
+			device->random = commission->low;
+			device->verified = commission->verified;
+			commission->used |= (uint64_t) 1 << commission->address;
+			dalicommission_next_window(commission);
+			return dalicommission_send(commission, DALICOMMISSION_WITHDRAW, 0x00, DALICOMMISSION_PHASE_WITHDRAW, frame);
+		}
+		case DALICOMMISSION_PHASE_GAP:
+			if (dalicommission_set_search(commission, (uint32_t) commission->single, frame)) {
+				return DALICOMMISSION_SEND;
+			}
+			return dalicommission_send(commission, DALICOMMISSION_COMPARE, 0x00, DALICOMMISSION_PHASE_GAP, frame);
+		case DALICOMMISSION_PHASE_TERMINATE:
+			commission->phase = DALICOMMISSION_PHASE_DONE;
+			return dalicommission_send(commission, DALICOMMISSION_TERMINATE, 0x00, DALICOMMISSION_PHASE_TERMINATE, frame);
+		case DALICOMMISSION_PHASE_DONE:
+			return commission->failed ? DALICOMMISSION_ERROR : DALICOMMISSION_DONE;
+		}
+	}
+}
+
+void dalicommission_response(DaliCommissionPtr commission, int response) {
+	if (!commission || !commission->waiting) {
+		return;
+	}
+	DaliCommissionPhase pending = commission->pending;
+	commission->waiting = 0;
+	commission->pending = DALICOMMISSION_PHASE_DONE;
+	if (response == DALICOMMISSION_SEND_FAILED) {
+		// Leave initialisation mode, the search can't be trusted anymore
+		commission->failed = 1;
+		commission->phase = pending == DALICOMMISSION_PHASE_TERMINATE ? DALICOMMISSION_PHASE_DONE : DALICOMMISSION_PHASE_TERMINATE;
+		return;
+	}
+	switch (pending) {
+	case DALICOMMISSION_PHASE_CHECK:
+	case DALICOMMISSION_PHASE_SEARCH:
+		if (response >= 0) {
+			// Several devices answering at the same time collide into something else than YES
+			if (response == 0xff) {
+				if ((int64_t) commission->probe > commission->single) {
+					commission->single = commission->probe;
+				}
+			} else if (commission->collision < 0 || (int64_t) commission->probe < commission->collision) {
+				commission->collision = commission->probe;
+			}
+			commission->high = commission->probe;
+			commission->phase = DALICOMMISSION_PHASE_SEARCH;
+		} else if (pending == DALICOMMISSION_PHASE_CHECK) {
+			// Nobody is left
+			commission->phase = DALICOMMISSION_PHASE_TERMINATE;
+		} else {
+			commission->low = commission->probe + 1;
+		}
+		break;
+	case DALICOMMISSION_PHASE_VERIFY:
+		commission->verified = response >= 0;
+		break;
+	case DALICOMMISSION_PHASE_CONFIRM:
+		if (response != (uint8_t) (commission->low >> (commission->confirm * 8))) {
+			commission->verified = 0;
+		}
+		break;
+	case DALICOMMISSION_PHASE_GAP:
+		if (response == DALICOMMISSION_NO_RESPONSE) {
+			commission->low = (uint32_t) commission->single + 1;
+			commission->phase = DALICOMMISSION_PHASE_CHECK;
+			dalicommission_narrow(commission);
+			commission->single = -1;
+			commission->collision = -1;
+		} else {
+			// Somebody is still there, search for it from the bottom of the gap
+			commission->high = (uint32_t) commission->single;
+			commission->phase = DALICOMMISSION_PHASE_SEARCH;
+			dalicommission_fallback(commission);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+size_t dalicommission_devices(DaliCommissionPtr commission, const DaliCommissionDevice **devices) {
+	if (commission) {
+		if (devices) {
+			*devices = commission->devices;
+		}
+		return commission->count;
+	}
+	return 0;
+}
+
+unsigned long dalicommission_frames(DaliCommissionPtr commission) {
+	if (commission) {
+		return commission->frames;
+	}
+	return 0;
+}
@@ -0,0 +1,95 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _COMMISSION_H
+#define _COMMISSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame.h"
+
+// Assigns short addresses to the devices on a bus with the random address search:
+// INITIALISE and RANDOMISE, then a binary search on the 24 bit random addresses
+// with COMPARE, PROGRAM SHORT ADDRESS to the lowest one, WITHDRAW, and repeat.
+// The engine only decides which frames to send, one at a time, so several buses
+// can be commissioned at the same time with one engine each.
+
+// Only assign addresses to devices that don't have one (INITIALISE 0xff),
+// otherwise all devices get a new address
+#define DALICOMMISSION_UNADDRESSED 0x01
+// Use collision detection to narrow the search for the next device. Several devices can
+// answer with the same 0xff without a collision, so each new address is confirmed with
+// QUERY RANDOM ADDRESS and each skipped part of the search with a COMPARE, and the engine
+// falls back to the normal search when one of them fails.
+#define DALICOMMISSION_FAST 0x02
+
+// Responses passed to dalicommission_response
+#define DALICOMMISSION_NO_RESPONSE -1
+#define DALICOMMISSION_SEND_FAILED -2
+
+// Highest random address
+#define DALICOMMISSION_RANDOM_MAX 0xffffff
+
+typedef enum {
+	// A frame must be sent, pass the result to dalicommission_response
+	DALICOMMISSION_SEND = 0,
+	// All devices have an address, or there are no free addresses left
+	DALICOMMISSION_DONE = 1,
+	// A frame could not be sent, the search was stopped
+	DALICOMMISSION_ERROR = 2,
+} DaliCommissionStatus;
+
+typedef struct {
+	// The short address that was assigned
+	uint8_t address;
+	// Random address of the device
+	uint32_t random;
+	// The device confirmed the address (VERIFY SHORT ADDRESS, or QUERY RANDOM ADDRESS in fast mode)
+	int verified;
+} DaliCommissionDevice;
+
+struct DaliCommission;
+typedef struct DaliCommission *DaliCommissionPtr;
+
+// Creates a commissioning engine
+// flags is a combination of DALICOMMISSION_ flags, used the short addresses that
+// must not be assigned (bit n = short address n)
+DaliCommissionPtr dalicommission_new(unsigned int flags, uint64_t used);
+// Destroys the engine
+void dalicommission_free(DaliCommissionPtr commission);
+// Returns the next frame to send
+// If DALICOMMISSION_SEND is returned, frame is set to a new frame that belongs to the caller,
+// and twice is set to 1 if it must be sent twice within 100 msec (as an atomic sequence).
+// The result must then be passed to dalicommission_response before continuing.
+DaliCommissionStatus dalicommission_step(DaliCommissionPtr commission, DaliFramePtr *frame, int *twice);
+// Sets the result of the frame that was sent: the response (0-255),
+// DALICOMMISSION_NO_RESPONSE or DALICOMMISSION_SEND_FAILED
+void dalicommission_response(DaliCommissionPtr commission, int response);
+// Returns the devices that got an address so far
+size_t dalicommission_devices(DaliCommissionPtr commission, const DaliCommissionDevice **devices);
+// Returns the number of frames sent so far, frames that are sent twice count twice
+unsigned long dalicommission_frames(DaliCommissionPtr commission);
+
+#endif /*_COMMISSION_H*/
@@ -146,6 +146,18 @@ void dispatch_add(DispatchPtr table, int fd, short events, DispatchReadyFunc rea
 	}
 }
 
+void dispatch_set_events(DispatchPtr table, int fd, short events) {
+	if (table) {
+		size_t i;
+		for (i = 0; i < table->numentries; i++) {
+			if (table->fds[i].fd == fd) {
+				log_debug("Poll events for fd %d are: 0x%x", fd, events);
+				table->fds[i].events = events;
+			}
+		}
+	}
+}
+
 void dispatch_remove_fd(DispatchPtr table, int fd) {
 	if (table) {
 		ssize_t i;
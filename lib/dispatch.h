@@ -72,6 +72,9 @@ DispatchStatus dispatch_run(DispatchPtr table, int timeout);
 // Any or all of the function pointers may be NULL, in which case no action will be taken upon receiving an event
 // arg is the first argument passed to the callbacks
 void dispatch_add(DispatchPtr table, int fd, short events, DispatchReadyFunc readyfn, DispatchErrorFunc errorfn, DispatchIndexFunc indexfn, void *arg);
+// Change the poll() events of a file descriptor
+// Pass 0 to stop waiting for input, errors and hangups are still reported
+void dispatch_set_events(DispatchPtr table, int fd, short events);
 // Remove a file descriptor from the queue
 // This may take linear time as the queue is searched first
 void dispatch_remove_fd(DispatchPtr table, int fd);
@@ -27,6 +27,95 @@
 #include <stdlib.h>
 #include <string.h>
 
+typedef struct {
+	uint8_t cls;
+	uint8_t flags;
+} DaliCommandInfo;
+
+// Commands from first to last that share their class and flags
+typedef struct {
+	uint8_t first;
+	uint8_t last;
+	DaliCommandInfo info;
+} DaliCommandRange;
+
+#define ARC(flags) { DALIFRAME_CLASS_ARC, (flags) }
+#define COMMAND(flags) { DALIFRAME_CLASS_COMMAND, (flags) }
+#define CONFIG(flags) { DALIFRAME_CLASS_CONFIG, (flags) }
+#define QUERY(flags) { DALIFRAME_CLASS_QUERY, (flags) }
+#define SPECIAL(flags) { DALIFRAME_CLASS_SPECIAL, (flags) }
+#define REPEATABLE DALIFRAME_FLAG_REPEATABLE
+#define ABSOLUTE (DALIFRAME_FLAG_REPEATABLE | DALIFRAME_FLAG_ABSOLUTE)
+#define ANSWERED (DALIFRAME_FLAG_ANSWERED | DALIFRAME_FLAG_REPEATABLE)
+#define TWICE DALIFRAME_FLAG_TWICE
+#define STORED DALIFRAME_FLAG_STORED
+
+// Direct arc power, the level is set whatever it was before
+static const DaliCommandInfo DALIFRAME_ARC = ARC(ABSOLUTE);
+// Commands to short addresses, groups and broadcast (YAAAAAA1)
+static const DaliCommandRange DALIFRAME_COMMAND_RANGES[] = {
+	// Off
+	{ 0x00, 0x00, COMMAND(ABSOLUTE) },
+	// Up, down, step up and down, relative to the current level
+	{ 0x01, 0x04, COMMAND(0) },
+	// Recall max and min level
+	{ 0x05, 0x06, COMMAND(ABSOLUTE) },
+	// Step down and off, on and step up, reserved
+	{ 0x07, 0x0f, COMMAND(0) },
+	// Go to scene
+	{ 0x10, 0x1f, COMMAND(ABSOLUTE) },
+	// Reset
+	{ 0x20, 0x20, CONFIG(TWICE | STORED) },
+	// Store actual level in DTR
+	{ 0x21, 0x21, CONFIG(TWICE) },
+	// Store DTR as max/min/failure/power on level, fade time and rate, scenes,
+	// group membership and short address
+	{ 0x22, 0x8f, CONFIG(TWICE | STORED) },
+	// Status, level, setting, scene and group queries
+	{ 0x90, 0xc4, QUERY(ANSWERED) },
+	// Read memory location advances DTR0, every answer is a different cell
+	{ 0xc5, 0xc5, QUERY(DALIFRAME_FLAG_ANSWERED) },
+	// Reserved
+	{ 0xc6, 0xdf, QUERY(ANSWERED) },
+	// Application extended commands, depend on the device type
+	{ 0xe0, 0xec, CONFIG(STORED) },
+	// Application extended queries
+	{ 0xed, 0xff, QUERY(ANSWERED) },
+};
+// Special commands at the odd addresses from 0xa1 to 0xdf, by (address - 0xa1) / 2
+static const DaliCommandRange DALIFRAME_SPECIAL_RANGES[] = {
+	// Terminate, DTR
+	{ 0x00, 0x01, SPECIAL(REPEATABLE) },
+	// Initialise, randomise
+	{ 0x02, 0x03, SPECIAL(TWICE) },
+	// Compare
+	{ 0x04, 0x04, SPECIAL(ANSWERED) },
+	// Withdraw
+	{ 0x05, 0x05, SPECIAL(REPEATABLE) },
+	// Reserved
+	{ 0x06, 0x07, SPECIAL(0) },
+	// Search address high, middle and low, program short address
+	{ 0x08, 0x0b, SPECIAL(REPEATABLE) },
+	// Verify short address, query short address
+	{ 0x0c, 0x0d, SPECIAL(ANSWERED) },
+	// Physical selection, reserved
+	{ 0x0e, 0x0f, SPECIAL(0) },
+	// Enable device type, DTR1, DTR2
+	{ 0x10, 0x12, SPECIAL(REPEATABLE) },
+	// Write memory location advances the DTR, the rest is reserved
+	{ 0x13, 0x1f, SPECIAL(0) },
+};
+// Extended frames and reserved addresses
+static const DaliCommandInfo DALIFRAME_RESERVED = SPECIAL(0);
+// Lookup tables, filled from the ranges on first use
+static DaliCommandInfo DALIFRAME_COMMANDS[256];
+static DaliCommandInfo DALIFRAME_SPECIALS[32];
+static int daliframe_tables_ready = 0;
+
+static void daliframe_fill(DaliCommandInfo *table, const DaliCommandRange *ranges, size_t count);
+static void daliframe_init_tables(void);
+static const DaliCommandInfo *daliframe_info(DaliFramePtr frame);
+
 DaliFramePtr daliframe_new(uint8_t address, uint8_t command) {
 	DaliFramePtr frame = malloc(sizeof(struct DaliFrame));
 	memset(frame, 0, sizeof(struct DaliFrame));
@@ -59,3 +148,67 @@ void daliframe_free(DaliFramePtr frame) {
 	}
 }
 
+static void daliframe_fill(DaliCommandInfo *table, const DaliCommandRange *ranges, size_t count) {
+	size_t i;
+	for (i = 0; i < count; i++) {
+		unsigned int command;
+		for (command = ranges[i].first; command <= ranges[i].last; command++) {
+			table[command] = ranges[i].info;
+		}
+	}
+}
+
+static void daliframe_init_tables(void) {
+	daliframe_fill(DALIFRAME_COMMANDS, DALIFRAME_COMMAND_RANGES, sizeof(DALIFRAME_COMMAND_RANGES) / sizeof(DALIFRAME_COMMAND_RANGES[0]));
+	daliframe_fill(DALIFRAME_SPECIALS, DALIFRAME_SPECIAL_RANGES, sizeof(DALIFRAME_SPECIAL_RANGES) / sizeof(DALIFRAME_SPECIAL_RANGES[0]));
+	daliframe_tables_ready = 1;
+}
+
+static const DaliCommandInfo *daliframe_info(DaliFramePtr frame) {
+	if (!daliframe_tables_ready) {
+		daliframe_init_tables();
+	}
+	if (!frame || frame->ecommand != 0) {
+		return &DALIFRAME_RESERVED;
+	}
+	// Short addresses are 0AAAAAAS, groups 100AAAAS and broadcast 1111111S,
+	// everything else is a special command
+	if ((frame->address & 0x80) == 0 || (frame->address & 0xe0) == 0x80 || (frame->address & 0xfe) == 0xfe) {
+		if ((frame->address & 0x01) == 0) {
+			return &DALIFRAME_ARC;
+		}
+		return &DALIFRAME_COMMANDS[frame->command];
+	}
+	if (frame->address >= 0xa1 && frame->address <= 0xdf && (frame->address & 0x01) != 0) {
+		return &DALIFRAME_SPECIALS[(frame->address - 0xa1) >> 1];
+	}
+	return &DALIFRAME_RESERVED;
+}
+
+DaliFrameClass daliframe_classify(DaliFramePtr frame) {
+	return (DaliFrameClass) daliframe_info(frame)->cls;
+}
+
+unsigned int daliframe_flags(DaliFramePtr frame) {
+	return daliframe_info(frame)->flags;
+}
+
+int daliframe_answered(DaliFramePtr frame) {
+	return (daliframe_flags(frame) & DALIFRAME_FLAG_ANSWERED) != 0;
+}
+
+const char *daliframe_class_name(DaliFrameClass cls) {
+	switch (cls) {
+	case DALIFRAME_CLASS_ARC:
+		return "arc";
+	case DALIFRAME_CLASS_COMMAND:
+		return "command";
+	case DALIFRAME_CLASS_CONFIG:
+		return "config";
+	case DALIFRAME_CLASS_QUERY:
+		return "query";
+	case DALIFRAME_CLASS_SPECIAL:
+		return "special";
+	}
+	return "unknown";
+}
@@ -35,6 +35,35 @@ struct DaliFrame {
 };
 typedef struct DaliFrame *DaliFramePtr;
 
+// Command classes, for deciding how a frame may be handled while queued
+typedef enum {
+	// Direct arc power (set level)
+	DALIFRAME_CLASS_ARC = 0,
+	// Indirect commands like off, up, down or recall
+	DALIFRAME_CLASS_COMMAND = 1,
+	// Configuration commands, these must be sent twice
+	DALIFRAME_CLASS_CONFIG = 2,
+	// Queries, the device answers with a backward frame
+	DALIFRAME_CLASS_QUERY = 3,
+	// Special commands (addressing, DTR, etc.) and extended frames
+	DALIFRAME_CLASS_SPECIAL = 4,
+} DaliFrameClass;
+#define DALIFRAME_CLASSES 5
+
+// Properties of a command, they tell how a frame may be scheduled
+typedef enum {
+	// The devices answer with a backward frame
+	DALIFRAME_FLAG_ANSWERED = 0x01,
+	// Receiving the frame twice does the same as receiving it once, it may be sent again after a failure
+	DALIFRAME_FLAG_REPEATABLE = 0x02,
+	// The result doesn't depend on earlier frames of the same kind, so a newer one supersedes an older one
+	DALIFRAME_FLAG_ABSOLUTE = 0x04,
+	// Only executed when it is received twice within 100 ms
+	DALIFRAME_FLAG_TWICE = 0x08,
+	// Stored in non-volatile memory, devices and adapters may take longer to process it
+	DALIFRAME_FLAG_STORED = 0x10,
+} DaliFrameFlag;
+
 // Allocate a Dali frame
 DaliFramePtr daliframe_new(uint8_t address, uint8_t command);
 DaliFramePtr daliframe_enew(uint8_t ecommand, uint8_t address, uint8_t command);
@@ -42,6 +71,16 @@ DaliFramePtr daliframe_enew(uint8_t ecommand, uint8_t address, uint8_t command);
 DaliFramePtr daliframe_clone(DaliFramePtr frame);
 // Deallocate a Dali frame
 void daliframe_free(DaliFramePtr frame);
+// Determine the command class of a frame
+DaliFrameClass daliframe_classify(DaliFramePtr frame);
+// Returns the properties of a frame, a set of DaliFrameFlag
+// Extended frames and reserved commands have none.
+unsigned int daliframe_flags(DaliFramePtr frame);
+// Returns the name of a command class
+const char *daliframe_class_name(DaliFrameClass cls);
+// Returns 1 if the devices answer the frame with a backward frame: queries,
+// and the special commands COMPARE, VERIFY SHORT ADDRESS and QUERY SHORT ADDRESS
+int daliframe_answered(DaliFramePtr frame);
 
 #endif /*_FRAME_H*/
 
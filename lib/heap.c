@@ -0,0 +1,161 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "heap.h"
+#include <stdlib.h>
+
+static const size_t HEAP_ALLOC_INCREASE = 16;
+
+struct Heap {
+	HeapCompareFunc compare;
+	HeapIndexFunc indexfn;
+	size_t length;
+	size_t allocated;
+	void **data;
+};
+
+static void heap_set(HeapPtr heap, size_t index, void *data);
+static void heap_up(HeapPtr heap, size_t index);
+static void heap_down(HeapPtr heap, size_t index);
+
+HeapPtr heap_new(HeapCompareFunc compare, HeapIndexFunc indexfn) {
+	if (!compare) {
+		return NULL;
+	}
+	HeapPtr heap = malloc(sizeof(struct Heap));
+	if (heap) {
+		heap->compare = compare;
+		heap->indexfn = indexfn;
+		heap->length = 0;
+		heap->allocated = 0;
+		heap->data = NULL;
+	}
+	return heap;
+}
+
+void heap_free(HeapPtr heap) {
+	if (heap) {
+		free(heap->data);
+		free(heap);
+	}
+}
+
+size_t heap_length(HeapPtr heap) {
+	if (heap) {
+		return heap->length;
+	}
+	return 0;
+}
+
+static void heap_set(HeapPtr heap, size_t index, void *data) {
+	heap->data[index] = data;
+	if (heap->indexfn) {
+		heap->indexfn(data, (ssize_t) index);
+	}
+}
+
+static void heap_up(HeapPtr heap, size_t index) {
+	void *data = heap->data[index];
+	while (index > 0) {
+		size_t parent = (index - 1) / 2;
+		if (heap->compare(data, heap->data[parent]) >= 0) {
+			break;
+		}
+		heap_set(heap, index, heap->data[parent]);
+		index = parent;
+	}
+	heap_set(heap, index, data);
+}
+
+static void heap_down(HeapPtr heap, size_t index) {
+	void *data = heap->data[index];
+	while (index * 2 + 1 < heap->length) {
+		size_t child = index * 2 + 1;
+		if (child + 1 < heap->length && heap->compare(heap->data[child + 1], heap->data[child]) < 0) {
+			child++;
+		}
+		if (heap->compare(heap->data[child], data) >= 0) {
+			break;
+		}
+		heap_set(heap, index, heap->data[child]);
+		index = child;
+	}
+	heap_set(heap, index, data);
+}
+
+int heap_push(HeapPtr heap, void *data) {
+	if (heap) {
+		if (heap->length >= heap->allocated) {
+			void **newdata = realloc(heap->data, sizeof(void *) * (heap->allocated + HEAP_ALLOC_INCREASE));
+			if (!newdata) {
+				return 0;
+			}
+			heap->data = newdata;
+			heap->allocated += HEAP_ALLOC_INCREASE;
+		}
+		heap->data[heap->length] = data;
+		heap->length++;
+		heap_up(heap, heap->length - 1);
+		return 1;
+	}
+	return 0;
+}
+
+void *heap_peek(HeapPtr heap) {
+	if (heap && heap->length > 0) {
+		return heap->data[0];
+	}
+	return NULL;
+}
+
+void *heap_pop(HeapPtr heap) {
+	return heap_remove(heap, 0);
+}
+
+void *heap_remove(HeapPtr heap, size_t index) {
+	if (heap && index < heap->length) {
+		void *data = heap->data[index];
+		heap->length--;
+		if (index < heap->length) {
+			heap->data[index] = heap->data[heap->length];
+			heap_update(heap, index);
+		}
+		if (heap->indexfn) {
+			heap->indexfn(data, -1);
+		}
+		return data;
+	}
+	return NULL;
+}
+
+void heap_update(HeapPtr heap, size_t index) {
+	if (heap && index < heap->length) {
+		if (index > 0 && heap->compare(heap->data[index], heap->data[(index - 1) / 2]) < 0) {
+			heap_up(heap, index);
+		} else {
+			heap_down(heap, index);
+		}
+	}
+}
@@ -0,0 +1,60 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _HEAP_H
+#define _HEAP_H
+
+#include <sys/types.h>
+
+struct Heap;
+typedef struct Heap *HeapPtr;
+
+// Returns a negative value if a must come before b, 0 if they are equal
+// and a positive value if a must come after b
+typedef int (*HeapCompareFunc)(void *a, void *b);
+// Called whenever the position of an element in the heap changes
+// index is -1 when the element was removed
+typedef void (*HeapIndexFunc)(void *data, ssize_t index);
+
+// Creates a new empty binary min-heap
+// indexfn may be NULL if elements don't need to know their position
+HeapPtr heap_new(HeapCompareFunc compare, HeapIndexFunc indexfn);
+// Destroys the heap, the elements are not freed
+void heap_free(HeapPtr heap);
+// Returns the number of elements in the heap
+size_t heap_length(HeapPtr heap);
+// Adds an element to the heap
+// Returns 0 if the heap could not be enlarged
+int heap_push(HeapPtr heap, void *data);
+// Returns the first element without removing it, or NULL if the heap is empty
+void *heap_peek(HeapPtr heap);
+// Removes the first element and returns it, or NULL if the heap is empty
+void *heap_pop(HeapPtr heap);
+// Removes the element at index and returns it
+void *heap_remove(HeapPtr heap, size_t index);
+// Restores the heap order after the key of the element at index has changed
+void heap_update(HeapPtr heap, size_t index);
+
+#endif /*_HEAP_H*/
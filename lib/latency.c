@@ -0,0 +1,139 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "latency.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+struct DaliLatency {
+	unsigned int floor;
+	unsigned int ceiling;
+	// Ring buffer of the recent samples, clamped to the ceiling
+	uint16_t samples[DALILATENCY_SAMPLES];
+	size_t next;
+	size_t length;
+	// Number of samples per msec, 0..ceiling
+	unsigned int *histogram;
+	// Timeout derived from the current samples
+	unsigned int timeout;
+};
+
+static void dalilatency_update(DaliLatencyPtr latency);
+
+DaliLatencyPtr dalilatency_new(unsigned int floor, unsigned int ceiling) {
+	if (ceiling < floor || ceiling > UINT16_MAX) {
+		return NULL;
+	}
+	DaliLatencyPtr latency = malloc(sizeof(struct DaliLatency));
+	if (latency) {
+		latency->histogram = calloc(ceiling + 1, sizeof(unsigned int));
+		if (!latency->histogram) {
+			free(latency);
+			return NULL;
+		}
+		latency->floor = floor;
+		latency->ceiling = ceiling;
+		memset(latency->samples, 0, sizeof(latency->samples));
+		latency->next = 0;
+		latency->length = 0;
+		latency->timeout = ceiling;
+	}
+	return latency;
+}
+
+void dalilatency_free(DaliLatencyPtr latency) {
+	if (latency) {
+		free(latency->histogram);
+		free(latency);
+	}
+}
+
+void dalilatency_add(DaliLatencyPtr latency, unsigned long msec) {
+	if (latency) {
+		uint16_t sample = msec > latency->ceiling ? latency->ceiling : (uint16_t) msec;
+		if (latency->length == DALILATENCY_SAMPLES) {
+			// The oldest sample makes room
+			latency->histogram[latency->samples[latency->next]]--;
+		} else {
+			latency->length++;
+		}
+		latency->samples[latency->next] = sample;
+		latency->histogram[sample]++;
+		latency->next = (latency->next + 1) % DALILATENCY_SAMPLES;
+		dalilatency_update(latency);
+	}
+}
+
+void dalilatency_expired(DaliLatencyPtr latency) {
+	if (latency) {
+		dalilatency_add(latency, latency->ceiling);
+	}
+}
+
+size_t dalilatency_length(DaliLatencyPtr latency) {
+	if (latency) {
+		return latency->length;
+	}
+	return 0;
+}
+
+unsigned int dalilatency_percentile(DaliLatencyPtr latency, unsigned int percent) {
+	if (latency && latency->length > 0) {
+		// Rank of the sample, rounded up
+		size_t rank = (latency->length * (percent > 100 ? 100 : percent) + 99) / 100;
+		size_t seen = 0;
+		unsigned int msec;
+		for (msec = 0; msec < latency->ceiling; msec++) {
+			seen += latency->histogram[msec];
+			if (seen >= rank) {
+				return msec;
+			}
+		}
+		return latency->ceiling;
+	}
+	return 0;
+}
+
+unsigned int dalilatency_timeout(DaliLatencyPtr latency) {
+	if (latency) {
+		return latency->timeout;
+	}
+	return 0;
+}
+
+static void dalilatency_update(DaliLatencyPtr latency) {
+	if (latency->length < DALILATENCY_MIN_SAMPLES) {
+		latency->timeout = latency->ceiling;
+		return;
+	}
+	unsigned long timeout = (unsigned long) dalilatency_percentile(latency, 99) * DALILATENCY_FACTOR;
+	if (timeout < latency->floor) {
+		timeout = latency->floor;
+	} else if (timeout > latency->ceiling) {
+		timeout = latency->ceiling;
+	}
+	latency->timeout = (unsigned int) timeout;
+}
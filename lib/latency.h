@@ -0,0 +1,61 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+#include <stddef.h>
+
+// Latency tracking for adapter transfers: keeps the most recent transfer
+// times and derives a timeout from their 99th percentile, so a lost response
+// is detected after a few times the usual latency instead of a fixed delay.
+
+// Number of recent transfers that are kept
+#define DALILATENCY_SAMPLES 256
+// Transfers that must be seen before the timeout adapts, the ceiling is used until then
+#define DALILATENCY_MIN_SAMPLES 16
+// Timeout as a multiple of the 99th percentile
+#define DALILATENCY_FACTOR 3
+
+struct DaliLatency;
+typedef struct DaliLatency *DaliLatencyPtr;
+
+// Creates a tracker whose timeouts are between floor and ceiling msec
+DaliLatencyPtr dalilatency_new(unsigned int floor, unsigned int ceiling);
+// Destroys the tracker
+void dalilatency_free(DaliLatencyPtr latency);
+// Records a transfer that completed after msec
+void dalilatency_add(DaliLatencyPtr latency, unsigned long msec);
+// Records a transfer that timed out, it counts as taking the ceiling
+// If timeouts become more frequent than 1 in 100 transfers, the timeout rises to the ceiling.
+void dalilatency_expired(DaliLatencyPtr latency);
+// Returns the number of recorded transfers, up to DALILATENCY_SAMPLES
+size_t dalilatency_length(DaliLatencyPtr latency);
+// Returns the latency in msec that percent of the recorded transfers didn't exceed, 0 if there are none
+unsigned int dalilatency_percentile(DaliLatencyPtr latency, unsigned int percent);
+// Returns the timeout to use for the next transfer in msec
+unsigned int dalilatency_timeout(DaliLatencyPtr latency);
+
+#endif /*_LATENCY_H*/
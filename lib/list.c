@@ -86,6 +86,30 @@ ListNodePtr list_enqueue(ListPtr list, void *data) {
 	return NULL;
 }
 
+ListNodePtr list_push(ListPtr list, void *data) {
+	if (list) {
+		struct ListNode *node = malloc(sizeof(struct ListNode));
+		if (!node) {
+			return NULL;
+		}
+		node->prev = NULL;
+		node->data = data;
+		list_lock(list);
+		node->next = list->head;
+		if (list->head) {
+			list->head->prev = node;
+		}
+		list->head = node;
+		if (!list->tail) {
+			list->tail = node;
+		}
+		list->length++;
+		list_unlock(list);
+		return node;
+	}
+	return NULL;
+}
+
 void *list_dequeue(ListPtr list) {
 	void *data = NULL;
 	if (list) {
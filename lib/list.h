@@ -48,6 +48,8 @@ size_t list_length(ListPtr list);
 ListNodePtr list_enqueue(ListPtr list, void *data);
 // Removes the last entry from the list and returns its data pointer
 void *list_dequeue(ListPtr list);
+// Inserts a new entry in front of all others, so it is dequeued next
+ListNodePtr list_push(ListPtr list, void *data);
 // Removes an element from the list and returns its data pointer
 void *list_remove(ListPtr list, ListNodePtr node);
 // Gets the data pointer from a list element
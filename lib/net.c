@@ -45,6 +45,7 @@ struct Server {
 	void *arg;
 	ConnectionDestroyFunc conndestroy;
 	void *conndestroyarg;
+	int paused;
 };
 
 struct Connection {
@@ -54,6 +55,8 @@ struct Connection {
 	int waiting;
 	ConnectionDestroyFunc destroy;
 	void *destroyarg;
+	void *data;
+	char address[INET_ADDRSTRLEN];
 };
 
 // Queue up 50 connections at most
@@ -63,7 +66,7 @@ static void server_listener_ready(void *arg);
 static void server_listener_error(void *arg, DispatchError err);
 static void server_connection_remove(ServerPtr server,	ConnectionPtr conn);
 
-static ConnectionPtr connection_new(ServerPtr server, int socket);
+static ConnectionPtr connection_new(ServerPtr server, int socket, const char *address);
 static void connection_free(ConnectionPtr conn);
 static void connection_ready(void *arg);
 static void connection_error(void *arg, DispatchError err);
@@ -95,6 +98,7 @@ ServerPtr server_open(DispatchPtr dispatch, const char *listenaddr, unsigned int
 							server->arg = arg;
 							server->conndestroy = NULL;
 							server->conndestroyarg = NULL;
+							server->paused = 0;
 							return server;
 						} else {
 							log_error("Error listening on socket: %s", strerror(errno));
@@ -142,9 +146,9 @@ static void server_listener_ready(void *arg) {
 			if (incoming.sin_family != AF_INET) {
 				log_error("Invalid address family from incoming connection %d", incoming.sin_family);
 			} else {
-				char addr[16];
+				char addr[INET_ADDRSTRLEN];
 				log_info("Got connection from %s:%u", inet_ntop(incoming.sin_family, &incoming.sin_addr, addr, sizeof(addr)), incoming.sin_port);
-				ConnectionPtr conn = connection_new(server, socket);
+				ConnectionPtr conn = connection_new(server, socket, addr);
 				list_enqueue(server->connections, conn);
 			}
 		}
@@ -170,7 +174,7 @@ static void server_connection_remove(ServerPtr server, ConnectionPtr conn) {
 	}
 }
 
-static ConnectionPtr connection_new(ServerPtr server, int socket) {
+static ConnectionPtr connection_new(ServerPtr server, int socket, const char *address) {
 	if (server) {
 		ConnectionPtr conn = malloc(sizeof(struct Connection));
 		if (conn) {
@@ -180,8 +184,11 @@ static ConnectionPtr connection_new(ServerPtr server, int socket) {
 			conn->waiting = 0;
 			conn->destroy = server->conndestroy;
 			conn->destroyarg = server->conndestroyarg;
+			conn->data = NULL;
+			strncpy(conn->address, address ? address : "", sizeof(conn->address) - 1);
+			conn->address[sizeof(conn->address) - 1] = 0;
 			if (server->dispatch) {
-				dispatch_add(server->dispatch, socket, -1, connection_ready, connection_error, NULL, conn);
+				dispatch_add(server->dispatch, socket, server->paused ? 0 : POLLIN, connection_ready, connection_error, NULL, conn);
 			}
 		}
 		return conn;
@@ -288,9 +295,43 @@ void server_broadcast(ServerPtr server, const char *buffer, size_t bufsize) {
 	}
 }
 
+void server_pause(ServerPtr server, int pause) {
+	if (server && server->paused != pause) {
+		log_info("%s reading from connections", pause ? "Pausing" : "Resuming");
+		server->paused = pause;
+		if (server->dispatch) {
+			ListNodePtr node;
+			for (node = list_first(server->connections); node; node = list_next(node)) {
+				ConnectionPtr conn = list_data(node);
+				dispatch_set_events(server->dispatch, conn->socket, pause ? 0 : POLLIN);
+			}
+		}
+	}
+}
+
 void server_set_connection_destroy_callback(ServerPtr server, ConnectionDestroyFunc destroy, void *arg) {
 	if (server) {
 		server->conndestroy = destroy;
 		server->conndestroyarg = arg;
 	}
 }
+
+void connection_set_data(ConnectionPtr conn, void *data) {
+	if (conn) {
+		conn->data = data;
+	}
+}
+
+void *connection_get_data(ConnectionPtr conn) {
+	if (conn) {
+		return conn->data;
+	}
+	return NULL;
+}
+
+const char *connection_get_address(ConnectionPtr conn) {
+	if (conn) {
+		return conn->address;
+	}
+	return NULL;
+}
@@ -44,10 +44,20 @@ ServerPtr server_open(DispatchPtr dispatch, const char *listenaddr, unsigned int
 void server_close(ServerPtr server);
 // Sends a message to all connections not waiting for a reply
 void server_broadcast(ServerPtr server, const char *buffer, size_t bufsize);
+// Stops (pause=1) or resumes (pause=0) reading requests from all connections
+// New connections are accepted, but not read from while the server is paused.
+void server_pause(ServerPtr server, int pause);
 // Assigns a handler to be called before a connection object is destroyed
 void server_set_connection_destroy_callback(ServerPtr conn, ConnectionDestroyFunc destroy, void *arg);
 
 // Sends a reply
 void connection_reply(ConnectionPtr conn, const char *buffer, size_t bufsize);
+// Attaches arbitrary data to a connection
+// The data is not freed automatically, use the destroy callback for that
+void connection_set_data(ConnectionPtr conn, void *data);
+// Returns the data attached to a connection, or NULL if there is none
+void *connection_get_data(ConnectionPtr conn);
+// Returns the remote address of a connection in text form
+const char *connection_get_address(ConnectionPtr conn);
 
 #endif //_NET_H
@@ -0,0 +1,263 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "poller.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Estimated bus time of a query and its answer
+static const unsigned int DALIPOLLER_FRAME_COST = 25; //msec
+// Length of the utilization measurement window
+static const unsigned long DALIPOLLER_WINDOW = 1000; //msec
+// Share of the bus that polling may always use, even if the target is exceeded
+static const unsigned int DALIPOLLER_MIN_SHARE = 5; //percent
+// Last result of a query that wasn't answered yet
+#define DALIPOLLER_UNKNOWN -3
+
+typedef struct {
+	uint8_t queries[DALIPOLLER_MAX_QUERIES];
+	size_t count;
+	// Short addresses to poll, 0 = all present devices
+	uint64_t devices;
+	// Result of the previous cycle for each device and query
+	int16_t last[64][DALIPOLLER_MAX_QUERIES];
+} DaliPollerSet;
+
+struct DaliPoller {
+	unsigned long cycle;
+	unsigned int target;
+	DaliPollerSet *sets[DALIPOLLER_MAX_SETS];
+	size_t count;
+	// Position of the next query
+	size_t set;
+	unsigned int device;
+	size_t query;
+	// Position of the query that was sent, if waiting is set
+	int waiting;
+	size_t sent_set;
+	unsigned int sent_device;
+	size_t sent_query;
+	// Earliest time at which the next query may be sent
+	unsigned long due;
+	// Start of the current cycle and queries sent in it
+	unsigned long cycle_start;
+	unsigned long polled;
+	unsigned long cycles;
+	// Utilization measurement: frames in the current window, and moving average in percent
+	unsigned long window;
+	unsigned long busy;
+	unsigned int utilization;
+};
+
+static uint64_t dalipoller_targets(DaliPollerSet *set, uint64_t present);
+static int dalipoller_find(DaliPollerPtr poller, uint64_t present);
+static int dalipoller_advance(DaliPollerPtr poller, uint64_t present);
+static void dalipoller_update(DaliPollerPtr poller, unsigned long now);
+static unsigned long dalipoller_gap(DaliPollerPtr poller, unsigned long now);
+
+DaliPollerPtr dalipoller_new(unsigned long cycle, unsigned int target) {
+	DaliPollerPtr poller = malloc(sizeof(struct DaliPoller));
+	if (poller) {
+		memset(poller, 0, sizeof(struct DaliPoller));
+		poller->cycle = cycle;
+		poller->target = target > 100 ? 100 : target;
+	}
+	return poller;
+}
+
+void dalipoller_free(DaliPollerPtr poller) {
+	if (poller) {
+		size_t i;
+		for (i = 0; i < poller->count; i++) {
+			free(poller->sets[i]);
+		}
+		free(poller);
+	}
+}
+
+int dalipoller_add(DaliPollerPtr poller, const uint8_t *queries, size_t count, uint64_t devices) {
+	if (!poller || !queries || count == 0 || count > DALIPOLLER_MAX_QUERIES || poller->count >= DALIPOLLER_MAX_SETS) {
+		return 0;
+	}
+	DaliPollerSet *set = malloc(sizeof(DaliPollerSet));
+	if (!set) {
+		return 0;
+	}
+	memcpy(set->queries, queries, count);
+	set->count = count;
+	set->devices = devices;
+	unsigned int device;
+	size_t query;
+	for (device = 0; device < 64; device++) {
+		for (query = 0; query < DALIPOLLER_MAX_QUERIES; query++) {
+			set->last[device][query] = DALIPOLLER_UNKNOWN;
+		}
+	}
+	poller->sets[poller->count++] = set;
+	return 1;
+}
+
+void dalipoller_busy(DaliPollerPtr poller, unsigned long now) {
+	if (poller) {
+		dalipoller_update(poller, now);
+		poller->busy++;
+	}
+}
+
+unsigned int dalipoller_utilization(DaliPollerPtr poller, unsigned long now) {
+	if (poller) {
+		dalipoller_update(poller, now);
+		return poller->utilization;
+	}
+	return 0;
+}
+
+long dalipoller_wait(DaliPollerPtr poller, uint64_t present, unsigned long now) {
+	if (!poller || poller->waiting || !dalipoller_advance(poller, present)) {
+		return -1;
+	}
+	return poller->due > now ? (long) (poller->due - now) : 0;
+}
+
+DaliFramePtr dalipoller_next(DaliPollerPtr poller, uint64_t present, unsigned long now) {
+	if (!poller || poller->waiting || !dalipoller_advance(poller, present) || poller->due > now) {
+		return NULL;
+	}
+	DaliPollerSet *set = poller->sets[poller->set];
+	DaliFramePtr frame = daliframe_new((uint8_t) ((poller->device << 1) | 1), set->queries[poller->query]);
+	if (frame) {
+		if (poller->polled == 0) {
+			poller->cycle_start = now;
+		}
+		poller->polled++;
+		poller->waiting = 1;
+		poller->sent_set = poller->set;
+		poller->sent_device = poller->device;
+		poller->sent_query = poller->query;
+		poller->query++;
+	}
+	return frame;
+}
+
+int dalipoller_response(DaliPollerPtr poller, int response, unsigned long now) {
+	if (!poller || !poller->waiting) {
+		return 0;
+	}
+	poller->waiting = 0;
+	poller->due = now + dalipoller_gap(poller, now);
+	if (response == DALIPOLLER_SEND_FAILED) {
+		return 0;
+	}
+	int16_t *last = &poller->sets[poller->sent_set]->last[poller->sent_device][poller->sent_query];
+	int changed = *last != DALIPOLLER_UNKNOWN && *last != response;
+	*last = (int16_t) response;
+	return changed;
+}
+
+unsigned long dalipoller_cycles(DaliPollerPtr poller) {
+	if (poller) {
+		return poller->cycles;
+	}
+	return 0;
+}
+
+static uint64_t dalipoller_targets(DaliPollerSet *set, uint64_t present) {
+	return set->devices ? set->devices : present;
+}
+
+// Finds the first query to send at or after the current position in this cycle
+static int dalipoller_find(DaliPollerPtr poller, uint64_t present) {
+	while (poller->set < poller->count) {
+		DaliPollerSet *set = poller->sets[poller->set];
+		uint64_t targets = dalipoller_targets(set, present);
+		if (poller->query >= set->count) {
+			poller->query = 0;
+			poller->device++;
+		}
+		if (poller->device >= 64 || (targets >> poller->device) == 0) {
+			poller->device = 0;
+			poller->query = 0;
+			poller->set++;
+		} else if ((targets >> poller->device) & 1) {
+			return 1;
+		} else {
+			poller->device++;
+		}
+	}
+	return 0;
+}
+
+// Moves to the next query to send, starting a new cycle at the end of the current one
+// Returns 0 if there is nothing to poll
+static int dalipoller_advance(DaliPollerPtr poller, uint64_t present) {
+	if (dalipoller_find(poller, present)) {
+		return 1;
+	}
+	poller->set = 0;
+	poller->device = 0;
+	poller->query = 0;
+	if (poller->polled > 0) {
+		poller->cycles++;
+		poller->polled = 0;
+		unsigned long restart = poller->cycle_start + poller->cycle;
+		if (restart > poller->due) {
+			poller->due = restart;
+		}
+	}
+	return dalipoller_find(poller, present);
+}
+
+static void dalipoller_update(DaliPollerPtr poller, unsigned long now) {
+	if (now < poller->window + DALIPOLLER_WINDOW) {
+		return;
+	}
+	unsigned long windows = (now - poller->window) / DALIPOLLER_WINDOW;
+	unsigned long sample = poller->busy * DALIPOLLER_FRAME_COST * 100 / DALIPOLLER_WINDOW;
+	if (sample > 100) {
+		sample = 100;
+	}
+	poller->utilization = (unsigned int) ((poller->utilization * 3 + sample) / 4);
+	// The windows after it were idle
+	unsigned long i;
+	for (i = 1; i < windows && poller->utilization > 0; i++) {
+		poller->utilization = poller->utilization * 3 / 4;
+	}
+	poller->busy = 0;
+	poller->window += windows * DALIPOLLER_WINDOW;
+}
+
+// Time between the end of a query and the start of the next one,
+// so polling uses the share of the bus between other traffic and the target
+static unsigned long dalipoller_gap(DaliPollerPtr poller, unsigned long now) {
+	unsigned int utilization = dalipoller_utilization(poller, now);
+	unsigned int share = poller->target > utilization ? poller->target - utilization : 0;
+	if (share < DALIPOLLER_MIN_SHARE) {
+		share = poller->target < DALIPOLLER_MIN_SHARE ? poller->target : DALIPOLLER_MIN_SHARE;
+	}
+	if (share == 0) {
+		share = 1;
+	}
+	return DALIPOLLER_FRAME_COST * 100 / share - DALIPOLLER_FRAME_COST;
+}
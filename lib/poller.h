@@ -0,0 +1,81 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POLLER_H
+#define _POLLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame.h"
+
+// Background status polling: cycles through sets of queries for each device,
+// one frame at a time. The poller only decides what to send and when, the
+// caller sends a frame only when the bus is otherwise idle.
+// The time between frames adapts to the bus utilization of the other traffic,
+// so polling takes at most a share of the bus time that is left.
+
+// Maximum number of query sets
+#define DALIPOLLER_MAX_SETS 8
+// Maximum number of queries in a set
+#define DALIPOLLER_MAX_QUERIES 8
+
+// Responses passed to dalipoller_response
+#define DALIPOLLER_NO_RESPONSE -1
+#define DALIPOLLER_SEND_FAILED -2
+
+struct DaliPoller;
+typedef struct DaliPoller *DaliPollerPtr;
+
+// Creates a poller
+// cycle is the minimum time in msec between the starts of two polling cycles,
+// target the bus utilization in percent up to which polling fills the bus.
+DaliPollerPtr dalipoller_new(unsigned long cycle, unsigned int target);
+// Destroys the poller
+void dalipoller_free(DaliPollerPtr poller);
+// Adds a set of count query opcodes that are sent to each short address in devices
+// (bit n = short address n, 0 = all devices that are present)
+// Returns 0 if there are too many sets or queries
+int dalipoller_add(DaliPollerPtr poller, const uint8_t *queries, size_t count, uint64_t devices);
+// Records a frame of other traffic that used the bus at time now
+void dalipoller_busy(DaliPollerPtr poller, unsigned long now);
+// Returns the estimated bus utilization of other traffic in percent
+unsigned int dalipoller_utilization(DaliPollerPtr poller, unsigned long now);
+// Returns the time in msec until the next frame is due, 0 if it is due now,
+// or -1 if nothing needs to be sent or a frame is still outstanding.
+// present is the set of short addresses that are known to be present.
+long dalipoller_wait(DaliPollerPtr poller, uint64_t present, unsigned long now);
+// Returns the next query to send if it is due, or NULL
+// The frame belongs to the caller. Its result must be passed to dalipoller_response
+// before the next one is returned.
+DaliFramePtr dalipoller_next(DaliPollerPtr poller, uint64_t present, unsigned long now);
+// Sets the result of the last query: the response (0-255),
+// DALIPOLLER_NO_RESPONSE or DALIPOLLER_SEND_FAILED
+// Returns 1 if the result differs from the one of the previous cycle, 0 otherwise.
+// The first result for a device and query is never reported as a change.
+int dalipoller_response(DaliPollerPtr poller, int response, unsigned long now);
+// Returns the number of completed polling cycles
+unsigned long dalipoller_cycles(DaliPollerPtr poller);
+
+#endif /*_POLLER_H*/
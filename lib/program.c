@@ -0,0 +1,336 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "program.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Number of operand bytes of each opcode
+static const uint8_t DALIPROGRAM_OPERANDS[] = {
+	0, // END
+	2, // SEND
+	1, // SENDX
+	1, // DEV
+	1, // DEVX
+	1, // ARC
+	1, // LOADX
+	0, // SAVEX
+	8, // SET
+	0, // PRESENT
+	1, // GROUP
+	1, // EACH
+	1, // JUMP
+	1, // JNONE
+	2, // JEQ
+	2, // JNE
+	2, // JMASK
+	0, // EMIT
+};
+#define DALIPROGRAM_OPCODES (sizeof(DALIPROGRAM_OPERANDS) / sizeof(DALIPROGRAM_OPERANDS[0]))
+
+struct DaliProgram {
+	uint8_t code[DALIPROGRAM_MAX_LENGTH];
+	size_t length;
+};
+
+struct DaliRun {
+	uint8_t code[DALIPROGRAM_MAX_LENGTH];
+	size_t length;
+	size_t pc;
+	unsigned int steps;
+	DaliStatePtr state;
+	// Current device, -1 if there is none
+	int device;
+	uint8_t x;
+	uint64_t set;
+	// Response to the last frame, or DALIRUN_NO_RESPONSE/DALIRUN_SEND_FAILED
+	int response;
+	// A frame was returned and its result hasn't been set yet
+	int pending;
+	uint8_t results[DALIPROGRAM_MAX_RESULTS * DALIPROGRAM_RECORD_SIZE];
+	size_t count;
+};
+
+static int daliprogram_target(uint8_t opcode, const uint8_t *operands, uint8_t *target);
+static int dalirun_frame(DaliRunPtr run, size_t pc, struct DaliFrame *frame);
+static int dalirun_setup(DaliFramePtr frame);
+static DaliRunStatus dalirun_send(DaliRunPtr run, const struct DaliFrame *batch, size_t count, DaliFramePtr *frames, size_t *length);
+
+static int daliprogram_target(uint8_t opcode, const uint8_t *operands, uint8_t *target) {
+	switch (opcode) {
+	case DALIPROGRAM_EACH:
+	case DALIPROGRAM_JUMP:
+	case DALIPROGRAM_JNONE:
+		*target = operands[0];
+		return 1;
+	case DALIPROGRAM_JEQ:
+	case DALIPROGRAM_JNE:
+	case DALIPROGRAM_JMASK:
+		*target = operands[1];
+		return 1;
+	}
+	return 0;
+}
+
+DaliProgramPtr daliprogram_new(const uint8_t *code, size_t length) {
+	if (!code || length == 0 || length > DALIPROGRAM_MAX_LENGTH) {
+		return NULL;
+	}
+	// Mark the start of each instruction, the end of the program is a valid target too
+	uint8_t starts[DALIPROGRAM_MAX_LENGTH + 1];
+	memset(starts, 0, sizeof(starts));
+	size_t pc = 0;
+	while (pc < length) {
+		if (code[pc] >= DALIPROGRAM_OPCODES || pc + 1 + DALIPROGRAM_OPERANDS[code[pc]] > length) {
+			return NULL;
+		}
+		starts[pc] = 1;
+		pc += 1 + DALIPROGRAM_OPERANDS[code[pc]];
+	}
+	starts[length] = 1;
+	for (pc = 0; pc < length; pc += 1 + DALIPROGRAM_OPERANDS[code[pc]]) {
+		uint8_t target;
+		if (daliprogram_target(code[pc], &code[pc + 1], &target) && (target > length || !starts[target])) {
+			return NULL;
+		}
+	}
+	DaliProgramPtr program = malloc(sizeof(struct DaliProgram));
+	if (program) {
+		memcpy(program->code, code, length);
+		program->length = length;
+	}
+	return program;
+}
+
+void daliprogram_free(DaliProgramPtr program) {
+	free(program);
+}
+
+size_t daliprogram_length(DaliProgramPtr program) {
+	if (program) {
+		return program->length;
+	}
+	return 0;
+}
+
+DaliRunPtr dalirun_new(DaliProgramPtr program, DaliStatePtr state, uint8_t x) {
+	if (!program) {
+		return NULL;
+	}
+	DaliRunPtr run = malloc(sizeof(struct DaliRun));
+	if (run) {
+		memcpy(run->code, program->code, program->length);
+		run->length = program->length;
+		run->pc = 0;
+		run->steps = 0;
+		run->state = state;
+		run->device = -1;
+		run->x = x;
+		run->set = 0;
+		run->response = DALIRUN_NO_RESPONSE;
+		run->pending = 0;
+		run->count = 0;
+	}
+	return run;
+}
+
+void dalirun_free(DaliRunPtr run) {
+	free(run);
+}
+
+// Returns the frame of the send instruction at pc: 1 if there is one,
+// 0 if it is another instruction, -1 if it needs a current device and there is none
+static int dalirun_frame(DaliRunPtr run, size_t pc, struct DaliFrame *frame) {
+	const uint8_t *operands = &run->code[pc + 1];
+	frame->ecommand = 0;
+	switch (run->code[pc]) {
+	case DALIPROGRAM_SEND:
+		frame->address = operands[0];
+		frame->command = operands[1];
+		return 1;
+	case DALIPROGRAM_SENDX:
+		frame->address = operands[0];
+		frame->command = run->x;
+		return 1;
+	case DALIPROGRAM_DEV:
+	case DALIPROGRAM_DEVX:
+	case DALIPROGRAM_ARC:
+		if (run->device < 0) {
+			return -1;
+		}
+		if (run->code[pc] == DALIPROGRAM_ARC) {
+			frame->address = (uint8_t) (run->device << 1);
+			frame->command = operands[0];
+		} else {
+			frame->address = (uint8_t) ((run->device << 1) | 1);
+			frame->command = (uint8_t) (run->code[pc] == DALIPROGRAM_DEVX ? operands[0] + run->x : operands[0]);
+		}
+		return 1;
+	}
+	return 0;
+}
+
+// DTR, DTR1, DTR2 and enable device type prepare the configuration commands that follow them
+static int dalirun_setup(DaliFramePtr frame) {
+	return frame->ecommand == 0 && (frame->address == 0xa3 || frame->address == 0xc1 || frame->address == 0xc3 || frame->address == 0xc5);
+}
+
+static DaliRunStatus dalirun_send(DaliRunPtr run, const struct DaliFrame *batch, size_t count, DaliFramePtr *frames, size_t *length) {
+	size_t i;
+	for (i = 0; i < count; i++) {
+		frames[i] = daliframe_clone((DaliFramePtr) &batch[i]);
+		if (!frames[i]) {
+			while (i > 0) {
+				daliframe_free(frames[--i]);
+			}
+			return DALIRUN_ERROR;
+		}
+	}
+	*length = count;
+	run->pending = 1;
+	return DALIRUN_SEND;
+}
+
+DaliRunStatus dalirun_step(DaliRunPtr run, DaliFramePtr *frames, size_t *length) {
+	if (!run || !frames || !length || run->pending) {
+		return DALIRUN_ERROR;
+	}
+	while (run->pc < run->length) {
+		if (++run->steps > DALIPROGRAM_MAX_STEPS) {
+			return DALIRUN_ERROR;
+		}
+		uint8_t opcode = run->code[run->pc];
+		const uint8_t *operands = &run->code[run->pc + 1];
+		struct DaliFrame batch[DALIRUN_MAX_SEQUENCE];
+		int found = dalirun_frame(run, run->pc, &batch[0]);
+		// Jumps overwrite this
+		run->pc += 1 + DALIPROGRAM_OPERANDS[opcode];
+		if (found < 0) {
+			return DALIRUN_ERROR;
+		}
+		if (found > 0) {
+			// DTR writes and the configuration commands that use them are sent as one sequence,
+			// so no other client can change the DTR or come between the two copies of a command
+			size_t count = 1;
+			if (dalirun_setup(&batch[0]) || (daliframe_flags(&batch[0]) & DALIFRAME_FLAG_TWICE)) {
+				while (count < DALIRUN_MAX_SEQUENCE && run->pc < run->length && dalirun_frame(run, run->pc, &batch[count]) > 0 &&
+					(dalirun_setup(&batch[count]) || (daliframe_flags(&batch[count]) & DALIFRAME_FLAG_TWICE))) {
+					if (++run->steps > DALIPROGRAM_MAX_STEPS) {
+						return DALIRUN_ERROR;
+					}
+					run->pc += 1 + DALIPROGRAM_OPERANDS[run->code[run->pc]];
+					count++;
+				}
+			}
+			return dalirun_send(run, batch, count, frames, length);
+		}
+		switch (opcode) {
+		case DALIPROGRAM_END:
+			run->pc = run->length;
+			break;
+		case DALIPROGRAM_LOADX:
+			run->x = operands[0];
+			break;
+		case DALIPROGRAM_SAVEX:
+			run->x = run->response >= 0 ? (uint8_t) run->response : 0;
+			break;
+		case DALIPROGRAM_SET: {
+			unsigned int i;
+			run->set = 0;
+			for (i = 0; i < 8; i++) {
+				run->set = (run->set << 8) | operands[i];
+			}
+		} break;
+		case DALIPROGRAM_PRESENT:
+			run->set = dalistate_inventory(run->state, DALISTATE_PRESENT);
+			break;
+		case DALIPROGRAM_GROUP:
+			run->set = dalistate_members(run->state, operands[0]);
+			break;
+		case DALIPROGRAM_EACH:
+			if (run->set == 0) {
+				run->pc = operands[0];
+			} else {
+				run->device = __builtin_ctzll(run->set);
+				run->set &= run->set - 1;
+			}
+			break;
+		case DALIPROGRAM_JUMP:
+			run->pc = operands[0];
+			break;
+		case DALIPROGRAM_JNONE:
+			if (run->response < 0) {
+				run->pc = operands[0];
+			}
+			break;
+		case DALIPROGRAM_JEQ:
+			if (run->response == operands[0]) {
+				run->pc = operands[1];
+			}
+			break;
+		case DALIPROGRAM_JNE:
+			if (run->response != operands[0]) {
+				run->pc = operands[1];
+			}
+			break;
+		case DALIPROGRAM_JMASK:
+			if (run->response >= 0 && (run->response & operands[0])) {
+				run->pc = operands[1];
+			}
+			break;
+		case DALIPROGRAM_EMIT: {
+			if (run->count >= DALIPROGRAM_MAX_RESULTS) {
+				return DALIRUN_ERROR;
+			}
+			uint8_t *record = &run->results[run->count * DALIPROGRAM_RECORD_SIZE];
+			record[0] = run->device < 0 ? 0xff : (uint8_t) run->device;
+			record[1] = run->response >= 0 ? DALIPROGRAM_ANSWERED : (run->response == DALIRUN_SEND_FAILED ? DALIPROGRAM_FAILED : 0);
+			record[2] = run->response >= 0 ? (uint8_t) run->response : 0;
+			run->count++;
+		} break;
+		default:
+			// Can't happen, the program was checked
+			return DALIRUN_ERROR;
+		}
+	}
+	return DALIRUN_DONE;
+}
+
+void dalirun_response(DaliRunPtr run, int response) {
+	if (run && run->pending) {
+		run->response = response;
+		run->pending = 0;
+	}
+}
+
+size_t dalirun_results(DaliRunPtr run, const uint8_t **results) {
+	if (run) {
+		if (results) {
+			*results = run->results;
+		}
+		return run->count * DALIPROGRAM_RECORD_SIZE;
+	}
+	return 0;
+}
@@ -0,0 +1,144 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PROGRAM_H
+#define _PROGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame.h"
+#include "state.h"
+
+// Programs are short byte code sequences that are executed by the server,
+// so multi-step procedures don't need a network round trip per frame.
+// Each instruction is an opcode followed by its operands (bytes).
+// Jump targets are absolute offsets into the program.
+// There are three registers: the current device (a short address, set by EACH),
+// X (an argument, set when the program is started) and the response to the last frame.
+typedef enum {
+	// Stop the program
+	DALIPROGRAM_END = 0x00,
+	// address command: send a frame
+	DALIPROGRAM_SEND = 0x01,
+	// address: send a frame with X as the command (DTR = X, for example)
+	DALIPROGRAM_SENDX = 0x02,
+	// command: send a command or query to the current device
+	DALIPROGRAM_DEV = 0x03,
+	// command: send command + X to the current device (store scene X, for example)
+	DALIPROGRAM_DEVX = 0x04,
+	// level: send a direct arc power level to the current device
+	DALIPROGRAM_ARC = 0x05,
+	// value: X = value
+	DALIPROGRAM_LOADX = 0x06,
+	// X = the response to the last frame
+	DALIPROGRAM_SAVEX = 0x07,
+	// 8 bytes: set the address set to a big endian bitmap of short addresses
+	DALIPROGRAM_SET = 0x08,
+	// Set the address set to the devices that are known to be present
+	DALIPROGRAM_PRESENT = 0x09,
+	// group: set the address set to the known members of a group
+	DALIPROGRAM_GROUP = 0x0a,
+	// target: remove the lowest short address from the address set and make it
+	// the current device, jump to target if the set is empty
+	DALIPROGRAM_EACH = 0x0b,
+	// target: jump
+	DALIPROGRAM_JUMP = 0x0c,
+	// target: jump if the last frame was not answered
+	DALIPROGRAM_JNONE = 0x0d,
+	// value target: jump if the response to the last frame is equal to value
+	DALIPROGRAM_JEQ = 0x0e,
+	// value target: jump if the last frame was not answered with value
+	DALIPROGRAM_JNE = 0x0f,
+	// mask target: jump if any bit of mask is set in the response to the last frame
+	DALIPROGRAM_JMASK = 0x10,
+	// Add a result record for the current device and the last response
+	DALIPROGRAM_EMIT = 0x11,
+} DaliProgramOpcode;
+
+// Maximum length of a program in bytes
+#define DALIPROGRAM_MAX_LENGTH 255
+// Maximum number of instructions executed in one run, so broken programs can't loop forever
+#define DALIPROGRAM_MAX_STEPS 16384
+// Maximum number of result records of one run
+#define DALIPROGRAM_MAX_RESULTS 256
+// Size of a result record: device (0xff if there is none), flags, response
+#define DALIPROGRAM_RECORD_SIZE 3
+
+// Maximum number of frames that are sent as one sequence
+#define DALIRUN_MAX_SEQUENCE 8
+
+// Flags of result records
+// The device answered, the response is valid
+#define DALIPROGRAM_ANSWERED 0x01
+// The frame could not be sent
+#define DALIPROGRAM_FAILED 0x02
+
+// Responses passed to dalirun_response
+#define DALIRUN_NO_RESPONSE -1
+#define DALIRUN_SEND_FAILED -2
+
+typedef enum {
+	// A frame must be sent, pass the result to dalirun_response
+	DALIRUN_SEND = 0,
+	// The program has ended
+	DALIRUN_DONE = 1,
+	// The program did something invalid and was stopped
+	DALIRUN_ERROR = 2,
+} DaliRunStatus;
+
+struct DaliProgram;
+typedef struct DaliProgram *DaliProgramPtr;
+struct DaliRun;
+typedef struct DaliRun *DaliRunPtr;
+
+// Checks a program and creates a copy of it
+// Returns NULL if an opcode is unknown, an operand is missing, a jump target
+// is not the start of an instruction, or if there is not enough memory.
+DaliProgramPtr daliprogram_new(const uint8_t *code, size_t length);
+// Destroys a program
+void daliprogram_free(DaliProgramPtr program);
+// Returns the length of a program in bytes
+size_t daliprogram_length(DaliProgramPtr program);
+
+// Starts a program with the given value of X
+// The run keeps its own copy of the code, the program may be freed while it is running.
+// The state table is used for the address sets, it must stay valid.
+DaliRunPtr dalirun_new(DaliProgramPtr program, DaliStatePtr state, uint8_t x);
+// Destroys a run
+void dalirun_free(DaliRunPtr run);
+// Executes instructions until frames must be sent or the program ends
+// If DALIRUN_SEND is returned, frames is filled with length new frames that belong to the caller
+// (at most DALIRUN_MAX_SEQUENCE). Consecutive DTR writes and configuration commands that must be
+// received twice are returned together, they must be sent as one atomic sequence.
+// The result must then be passed to dalirun_response before continuing.
+DaliRunStatus dalirun_step(DaliRunPtr run, DaliFramePtr *frames, size_t *length);
+// Sets the result of the frames that were sent: the response to the last one (0-255),
+// DALIRUN_NO_RESPONSE, or DALIRUN_SEND_FAILED if any of them could not be sent
+void dalirun_response(DaliRunPtr run, int response);
+// Returns the result records collected so far, DALIPROGRAM_RECORD_SIZE bytes each
+// The return value is the length in bytes.
+size_t dalirun_results(DaliRunPtr run, const uint8_t **results);
+
+#endif /*_PROGRAM_H*/
@@ -0,0 +1,877 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "queue.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "list.h"
+#include "heap.h"
+
+// Estimated bus time of a 16bit forward frame, including settling time
+static const unsigned int DALIQUEUE_COST_16BIT = 25; //msec
+// Estimated bus time of a 24bit forward frame, including settling time
+static const unsigned int DALIQUEUE_COST_24BIT = 32; //msec
+// Bus time credited to an owner each round, must be at least the largest cost
+static const unsigned int DALIQUEUE_QUANTUM = 32; //msec
+// Number of hash buckets in the coalescing index
+#define DALIQUEUE_INDEX_BUCKETS 64
+
+typedef struct {
+	void *owner;
+	ListPtr transactions;
+	unsigned int deficit;
+	int active;
+} DaliFlow;
+
+struct DaliQueue {
+	// Flows with queued transactions, in round robin order
+	ListPtr flows[DALIQUEUE_PRIORITIES];
+	size_t lengths[DALIQUEUE_PRIORITIES];
+	size_t length;
+	unsigned long cost;
+	// Transactions with a deadline, the earliest first
+	HeapPtr deadlines;
+	// Queued transactions that may be merged with later ones, by coalescing key
+	ListPtr index[DALIQUEUE_INDEX_BUCKETS];
+	// The remaining frames of the sequence that is on the bus, they are sent before anything else
+	DaliTransactionPtr sequence;
+	// The remaining frames of a sequence whose first frame expired before it was sent
+	DaliTransactionPtr expired;
+	// Transactions that wait for frames to merge with, in the order they were queued
+	ListPtr held;
+	// Known group members and devices reached by a broadcast, 0 = unknown
+	uint64_t groups[DALIQUEUE_GROUPS];
+	uint64_t devices;
+};
+
+static DaliFlow *daliflow_new(void *owner);
+static void daliflow_free(DaliFlow *flow);
+static int daliflow_owner_equal(void *data, void *arg);
+static int dalitransaction_deadline_compare(void *a, void *b);
+static void dalitransaction_heap_index(void *data, ssize_t index);
+static void daliqueue_unlink(DaliQueuePtr queue, size_t priority, ListNodePtr fnode, ListNodePtr node);
+static void daliqueue_release(DaliQueuePtr queue, DaliTransactionPtr transaction);
+static unsigned long dalitransaction_sequence_cost(DaliTransactionPtr transaction);
+static DaliTransactionPtr daliqueue_next_in_sequence(DaliQueuePtr queue);
+static int daliqueue_removable(DaliTransactionPtr transaction, unsigned int classes);
+static int daliqueue_key(DaliFramePtr frame, uint32_t *key);
+static int daliqueue_overlap(DaliFramePtr a, DaliFramePtr b);
+static void daliqueue_index_remove(DaliQueuePtr queue, DaliTransactionPtr transaction);
+static void daliqueue_index_invalidate(DaliQueuePtr queue, DaliFramePtr frame);
+static void daliqueue_set_deadline(DaliQueuePtr queue, DaliTransactionPtr transaction, unsigned long deadline);
+static int daliqueue_groupable(DaliTransactionPtr transaction);
+static int daliqueue_indexed(DaliQueuePtr queue, DaliTransactionPtr transaction);
+static int daliqueue_groupmate(DaliQueuePtr queue, DaliTransactionPtr transaction, DaliTransactionPtr other);
+static uint8_t daliqueue_group_address(DaliQueuePtr queue, uint64_t targets, int final);
+static size_t daliqueue_merge(DaliQueuePtr queue, DaliTransactionPtr transaction, int final, unsigned long *cost);
+static int daliqueue_absorb(DaliQueuePtr queue, DaliTransactionPtr transaction, DaliTransactionPtr other);
+
+DaliTransactionPtr dalitransaction_new(DaliFramePtr request, DaliQueuePriority priority, void *arg) {
+	DaliTransactionPtr transaction = malloc(sizeof(DaliTransaction));
+	if (transaction) {
+		memset(transaction, 0, sizeof(DaliTransaction));
+		transaction->request = request;
+		transaction->priority = priority;
+		if (request && request->ecommand != 0) {
+			transaction->cost = DALIQUEUE_COST_24BIT;
+		} else {
+			transaction->cost = DALIQUEUE_COST_16BIT;
+		}
+		transaction->owner = arg;
+		transaction->deadline = 0;
+		transaction->heap_index = -1;
+		transaction->arg = arg;
+		transaction->waiters = NULL;
+		transaction->next = NULL;
+		transaction->gap = 0;
+		transaction->hold = 0;
+		transaction->in_sequence = 0;
+		transaction->retries = 0;
+	}
+	return transaction;
+}
+
+void dalitransaction_free(DaliTransactionPtr transaction) {
+	while (transaction) {
+		DaliTransactionPtr next = transaction->next;
+		daliframe_free(transaction->request);
+		list_free(transaction->waiters);
+		free(transaction);
+		transaction = next;
+	}
+}
+
+void dalitransaction_append(DaliTransactionPtr transaction, DaliTransactionPtr next, unsigned int gap) {
+	if (transaction && next) {
+		while (transaction->next) {
+			transaction = transaction->next;
+		}
+		next->gap = gap;
+		next->in_sequence = 1;
+		transaction->in_sequence = 1;
+		transaction->next = next;
+	}
+}
+
+size_t dalitransaction_length(DaliTransactionPtr transaction) {
+	size_t length = 0;
+	for (; transaction; transaction = transaction->next) {
+		length++;
+	}
+	return length;
+}
+
+static unsigned long dalitransaction_sequence_cost(DaliTransactionPtr transaction) {
+	unsigned long cost = 0;
+	for (; transaction; transaction = transaction->next) {
+		cost += transaction->cost;
+	}
+	return cost;
+}
+
+int dalitransaction_add_waiter(DaliTransactionPtr transaction, void *arg) {
+	if (transaction) {
+		if (!transaction->waiters) {
+			transaction->waiters = list_new(NULL);
+			if (!transaction->waiters) {
+				return 0;
+			}
+		}
+		return list_enqueue(transaction->waiters, arg) != NULL;
+	}
+	return 0;
+}
+
+void *dalitransaction_next_waiter(DaliTransactionPtr transaction) {
+	if (transaction && list_length(transaction->waiters) > 0) {
+		return list_dequeue(transaction->waiters);
+	}
+	return NULL;
+}
+
+void dalitransaction_cancel(DaliTransactionPtr transaction, void *arg) {
+	if (arg) {
+		for (; transaction; transaction = transaction->next) {
+			if (transaction->arg == arg) {
+				transaction->arg = NULL;
+			}
+			ListNodePtr node;
+			while ((node = list_find(transaction->waiters, list_equal, arg))) {
+				list_remove(transaction->waiters, node);
+			}
+		}
+	}
+}
+
+static int dalitransaction_deadline_compare(void *a, void *b) {
+	unsigned long da = ((DaliTransactionPtr) a)->deadline;
+	unsigned long db = ((DaliTransactionPtr) b)->deadline;
+	return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+static void dalitransaction_heap_index(void *data, ssize_t index) {
+	((DaliTransactionPtr) data)->heap_index = index;
+}
+
+static DaliFlow *daliflow_new(void *owner) {
+	DaliFlow *flow = malloc(sizeof(DaliFlow));
+	if (flow) {
+		flow->owner = owner;
+		flow->transactions = list_new((ListDataFreeFunc) dalitransaction_free);
+		flow->deficit = 0;
+		flow->active = 0;
+		if (!flow->transactions) {
+			free(flow);
+			flow = NULL;
+		}
+	}
+	return flow;
+}
+
+static void daliflow_free(DaliFlow *flow) {
+	if (flow) {
+		list_free(flow->transactions);
+		free(flow);
+	}
+}
+
+static int daliflow_owner_equal(void *data, void *arg) {
+	return ((DaliFlow *) data)->owner == arg;
+}
+
+int dalitransaction_same_query(DaliTransactionPtr transaction, DaliFramePtr frame) {
+	if (transaction && transaction->request && frame) {
+		DaliFramePtr request = transaction->request;
+		// Queries with side effects must be sent for each requester
+		return daliframe_classify(request) == DALIFRAME_CLASS_QUERY && (daliframe_flags(request) & DALIFRAME_FLAG_REPEATABLE) && request->ecommand == frame->ecommand && request->address == frame->address && request->command == frame->command;
+	}
+	return 0;
+}
+
+DaliQueuePtr daliqueue_new() {
+	DaliQueuePtr queue = malloc(sizeof(struct DaliQueue));
+	if (queue) {
+		size_t i;
+		for (i = 0; i < DALIQUEUE_PRIORITIES; i++) {
+			queue->flows[i] = list_new((ListDataFreeFunc) daliflow_free);
+			queue->lengths[i] = 0;
+		}
+		queue->length = 0;
+		queue->cost = 0;
+		queue->deadlines = heap_new(dalitransaction_deadline_compare, dalitransaction_heap_index);
+		for (i = 0; i < DALIQUEUE_INDEX_BUCKETS; i++) {
+			queue->index[i] = list_new(NULL);
+		}
+		queue->sequence = NULL;
+		queue->expired = NULL;
+		queue->held = list_new(NULL);
+		memset(queue->groups, 0, sizeof(queue->groups));
+		queue->devices = 0;
+	}
+	return queue;
+}
+
+void daliqueue_free(DaliQueuePtr queue) {
+	if (queue) {
+		size_t i;
+		heap_free(queue->deadlines);
+		for (i = 0; i < DALIQUEUE_INDEX_BUCKETS; i++) {
+			list_free(queue->index[i]);
+		}
+		for (i = 0; i < DALIQUEUE_PRIORITIES; i++) {
+			list_free(queue->flows[i]);
+		}
+		dalitransaction_free(queue->sequence);
+		dalitransaction_free(queue->expired);
+		list_free(queue->held);
+		free(queue);
+	}
+}
+
+size_t daliqueue_length(DaliQueuePtr queue) {
+	if (queue) {
+		return queue->length;
+	}
+	return 0;
+}
+
+size_t daliqueue_length_priority(DaliQueuePtr queue, DaliQueuePriority priority) {
+	if (queue && priority < DALIQUEUE_PRIORITIES) {
+		return queue->lengths[priority];
+	}
+	return 0;
+}
+
+size_t daliqueue_length_owner(DaliQueuePtr queue, void *owner) {
+	size_t length = 0;
+	if (queue) {
+		size_t i;
+		for (i = 0; i < DALIQUEUE_PRIORITIES; i++) {
+			DaliFlow *flow = list_data(list_find(queue->flows[i], daliflow_owner_equal, owner));
+			if (flow) {
+				length += list_length(flow->transactions);
+			}
+		}
+	}
+	return length;
+}
+
+unsigned long daliqueue_cost(DaliQueuePtr queue) {
+	if (queue) {
+		return queue->cost;
+	}
+	return 0;
+}
+
+static int daliqueue_key(DaliFramePtr frame, uint32_t *key) {
+	switch (daliframe_classify(frame)) {
+	case DALIFRAME_CLASS_ARC:
+		// The level is what gets replaced
+		*key = (uint32_t) frame->ecommand << 16 | (uint32_t) frame->address << 8;
+		return 1;
+	case DALIFRAME_CLASS_COMMAND:
+		// Off, recall max/min and go to scene, the others are relative
+		if (daliframe_flags(frame) & DALIFRAME_FLAG_ABSOLUTE) {
+			*key = (uint32_t) frame->ecommand << 16 | (uint32_t) frame->address << 8 | frame->command;
+			return 1;
+		}
+		return 0;
+	case DALIFRAME_CLASS_QUERY:
+		// All requesters get the same response, unless asking changes it
+		if (!(daliframe_flags(frame) & DALIFRAME_FLAG_REPEATABLE)) {
+			return 0;
+		}
+		*key = (uint32_t) 1 << 24 | (uint32_t) frame->ecommand << 16 | (uint32_t) frame->address << 8 | frame->command;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static int daliqueue_overlap(DaliFramePtr a, DaliFramePtr b) {
+	// Group membership isn't known here, so anything but two short addresses may overlap
+	if ((a->address & 0x80) != 0 || (b->address & 0x80) != 0) {
+		return 1;
+	}
+	return (a->address >> 1) == (b->address >> 1);
+}
+
+static void daliqueue_index_remove(DaliQueuePtr queue, DaliTransactionPtr transaction) {
+	uint32_t key;
+	if (daliqueue_key(transaction->request, &key)) {
+		ListPtr bucket = queue->index[key % DALIQUEUE_INDEX_BUCKETS];
+		list_remove(bucket, list_find(bucket, list_equal, transaction));
+	}
+}
+
+static void daliqueue_index_invalidate(DaliQueuePtr queue, DaliFramePtr frame) {
+	size_t i;
+	for (i = 0; i < DALIQUEUE_INDEX_BUCKETS; i++) {
+		ListNodePtr node = list_first(queue->index[i]);
+		while (node) {
+			ListNodePtr next = list_next(node);
+			DaliTransactionPtr transaction = list_data(node);
+			if (daliqueue_overlap(transaction->request, frame)) {
+				list_remove(queue->index[i], node);
+			}
+			node = next;
+		}
+	}
+}
+
+static void daliqueue_set_deadline(DaliQueuePtr queue, DaliTransactionPtr transaction, unsigned long deadline) {
+	transaction->deadline = deadline;
+	if (transaction->heap_index >= 0) {
+		if (deadline == 0) {
+			heap_remove(queue->deadlines, (size_t) transaction->heap_index);
+		} else {
+			heap_update(queue->deadlines, (size_t) transaction->heap_index);
+		}
+	} else if (deadline != 0) {
+		heap_push(queue->deadlines, transaction);
+	}
+}
+
+DaliTransactionPtr daliqueue_coalesce(DaliQueuePtr queue, DaliTransactionPtr transaction) {
+	uint32_t key;
+	if (queue && transaction && !transaction->next && daliqueue_key(transaction->request, &key)) {
+		ListNodePtr node;
+		for (node = list_first(queue->index[key % DALIQUEUE_INDEX_BUCKETS]); node; node = list_next(node)) {
+			DaliTransactionPtr queued = list_data(node);
+			uint32_t qkey;
+			if (queued->priority == transaction->priority && daliqueue_key(queued->request, &qkey) && qkey == key) {
+				if (!dalitransaction_add_waiter(queued, transaction->arg)) {
+					return NULL;
+				}
+				void *waiter;
+				while ((waiter = dalitransaction_next_waiter(transaction))) {
+					dalitransaction_add_waiter(queued, waiter);
+				}
+				queued->request->command = transaction->request->command;
+				// Keep the later deadline, no deadline is the latest
+				if (queued->deadline != 0 && (transaction->deadline == 0 || transaction->deadline > queued->deadline)) {
+					daliqueue_set_deadline(queue, queued, transaction->deadline);
+				}
+				return queued;
+			}
+		}
+	}
+	return NULL;
+}
+
+int daliqueue_push(DaliQueuePtr queue, DaliTransactionPtr transaction) {
+	if (queue && transaction) {
+		if (transaction->priority >= DALIQUEUE_PRIORITIES) {
+			transaction->priority = DALIQUEUE_PRIORITY_BACKGROUND;
+		}
+		if (transaction->deadline != 0 && !heap_push(queue->deadlines, transaction)) {
+			return 0;
+		}
+		ListPtr flows = queue->flows[transaction->priority];
+		DaliFlow *flow = list_data(list_find(flows, daliflow_owner_equal, transaction->owner));
+		if (!flow) {
+			flow = daliflow_new(transaction->owner);
+			if (!flow) {
+				if (transaction->heap_index >= 0) {
+					heap_remove(queue->deadlines, (size_t) transaction->heap_index);
+				}
+				return 0;
+			}
+			list_enqueue(flows, flow);
+		}
+		list_enqueue(flow->transactions, transaction);
+		DaliTransactionPtr frame;
+		for (frame = transaction; frame; frame = frame->next) {
+			frame->priority = transaction->priority;
+			frame->owner = transaction->owner;
+			// Older frames to the same devices must not be changed anymore
+			daliqueue_index_invalidate(queue, frame->request);
+			queue->lengths[frame->priority]++;
+			queue->length++;
+			queue->cost += frame->cost;
+		}
+		uint32_t key;
+		if (!transaction->next && daliqueue_key(transaction->request, &key)) {
+			list_enqueue(queue->index[key % DALIQUEUE_INDEX_BUCKETS], transaction);
+		}
+		if (transaction->hold != 0) {
+			if (daliqueue_groupable(transaction)) {
+				list_enqueue(queue->held, transaction);
+			} else {
+				transaction->hold = 0;
+			}
+		}
+		return 1;
+	}
+	return 0;
+}
+
+int daliqueue_requeue(DaliQueuePtr queue, DaliTransactionPtr transaction, unsigned long hold) {
+	if (queue && transaction && !transaction->in_sequence && transaction->priority < DALIQUEUE_PRIORITIES) {
+		if (transaction->deadline != 0 && !heap_push(queue->deadlines, transaction)) {
+			return 0;
+		}
+		ListPtr flows = queue->flows[transaction->priority];
+		DaliFlow *flow = list_data(list_find(flows, daliflow_owner_equal, transaction->owner));
+		if (!flow) {
+			flow = daliflow_new(transaction->owner);
+			if (!flow) {
+				if (transaction->heap_index >= 0) {
+					heap_remove(queue->deadlines, (size_t) transaction->heap_index);
+				}
+				return 0;
+			}
+			list_enqueue(flows, flow);
+		}
+		if (!list_push(flow->transactions, transaction)) {
+			if (transaction->heap_index >= 0) {
+				heap_remove(queue->deadlines, (size_t) transaction->heap_index);
+			}
+			if (list_length(flow->transactions) == 0) {
+				list_remove(flows, list_find(flows, list_equal, flow));
+				daliflow_free(flow);
+			}
+			return 0;
+		}
+		transaction->retries++;
+		queue->lengths[transaction->priority]++;
+		queue->length++;
+		queue->cost += transaction->cost;
+		// Not indexed, frames that were queued after it must not be merged into it
+		transaction->hold = hold;
+		if (hold != 0) {
+			list_enqueue(queue->held, transaction);
+		}
+		return 1;
+	}
+	return 0;
+}
+
+static void daliqueue_unlink(DaliQueuePtr queue, size_t priority, ListNodePtr fnode, ListNodePtr node) {
+	DaliFlow *flow = list_data(fnode);
+	DaliTransactionPtr transaction = list_remove(flow->transactions, node);
+	if (transaction->heap_index >= 0) {
+		heap_remove(queue->deadlines, (size_t) transaction->heap_index);
+	}
+	daliqueue_index_remove(queue, transaction);
+	if (transaction->hold != 0) {
+		list_remove(queue->held, list_find(queue->held, list_equal, transaction));
+		transaction->hold = 0;
+	}
+	daliqueue_release(queue, transaction);
+	if (list_length(flow->transactions) == 0) {
+		// Idle flows don't keep their credit
+		list_remove(queue->flows[priority], fnode);
+		daliflow_free(flow);
+	}
+}
+
+static void daliqueue_release(DaliQueuePtr queue, DaliTransactionPtr transaction) {
+	queue->lengths[transaction->priority]--;
+	queue->length--;
+	queue->cost -= transaction->cost;
+}
+
+static DaliTransactionPtr daliqueue_next_in_sequence(DaliQueuePtr queue) {
+	DaliTransactionPtr transaction = queue->sequence;
+	queue->sequence = transaction->next;
+	transaction->next = NULL;
+	daliqueue_release(queue, transaction);
+	return transaction;
+}
+
+DaliTransactionPtr daliqueue_pop(DaliQueuePtr queue) {
+	if (queue) {
+		if (queue->sequence) {
+			return daliqueue_next_in_sequence(queue);
+		}
+		size_t i;
+		for (i = 0; i < DALIQUEUE_PRIORITIES; i++) {
+			ListPtr flows = queue->flows[i];
+			// Flows that are waiting for a held transaction sit out until it is released
+			size_t ready = 0;
+			ListNodePtr fnode;
+			for (fnode = list_first(flows); fnode; fnode = list_next(fnode)) {
+				DaliTransactionPtr transaction = list_data(list_first(((DaliFlow *) list_data(fnode))->transactions));
+				if (transaction->hold == 0) {
+					ready++;
+				}
+			}
+			while (ready > 0) {
+				fnode = list_first(flows);
+				DaliFlow *flow = list_data(fnode);
+				ListNodePtr node = list_first(flow->transactions);
+				DaliTransactionPtr transaction = list_data(node);
+				if (transaction->hold != 0) {
+					flow->active = 0;
+					list_enqueue(flows, list_dequeue(flows));
+					continue;
+				}
+				if (!flow->active) {
+					// Start of this flow's turn
+					flow->deficit += DALIQUEUE_QUANTUM;
+					flow->active = 1;
+				}
+				// A sequence is paid for as a whole, it may take several rounds to save up for it
+				unsigned long cost = dalitransaction_sequence_cost(transaction);
+				if (cost <= flow->deficit) {
+					flow->deficit -= cost;
+					daliqueue_unlink(queue, i, fnode, node);
+					queue->sequence = transaction->next;
+					transaction->next = NULL;
+					return transaction;
+				}
+				// Turn is over, move to the end of the round
+				flow->active = 0;
+				list_enqueue(flows, list_dequeue(flows));
+			}
+		}
+	}
+	return NULL;
+}
+
+void daliqueue_finish(DaliQueuePtr queue, unsigned long now, int failed) {
+	if (queue && queue->sequence) {
+		if (failed) {
+			queue->sequence->deadline = now;
+		} else if (queue->sequence->gap > 0) {
+			queue->sequence->deadline = now + queue->sequence->gap;
+		}
+	}
+}
+
+DaliTransactionPtr daliqueue_expire(DaliQueuePtr queue, unsigned long now) {
+	if (queue) {
+		if (queue->expired) {
+			DaliTransactionPtr transaction = queue->expired;
+			queue->expired = transaction->next;
+			transaction->next = NULL;
+			daliqueue_release(queue, transaction);
+			return transaction;
+		}
+		if (queue->sequence && queue->sequence->deadline != 0 && queue->sequence->deadline <= now) {
+			DaliTransactionPtr transaction = daliqueue_next_in_sequence(queue);
+			// Without this frame, the rest is useless
+			if (queue->sequence) {
+				queue->sequence->deadline = now;
+			}
+			return transaction;
+		}
+		DaliTransactionPtr transaction = heap_peek(queue->deadlines);
+		if (transaction && transaction->deadline <= now) {
+			size_t priority = transaction->priority;
+			ListNodePtr fnode = list_find(queue->flows[priority], daliflow_owner_equal, transaction->owner);
+			DaliFlow *flow = list_data(fnode);
+			if (flow) {
+				ListNodePtr node = list_find(flow->transactions, list_equal, transaction);
+				if (node) {
+					daliqueue_unlink(queue, priority, fnode, node);
+					// The rest of the sequence expires with it, another sequence may be on the bus
+					queue->expired = transaction->next;
+					transaction->next = NULL;
+					return transaction;
+				}
+			}
+			// Not queued, shouldn't happen
+			heap_pop(queue->deadlines);
+		}
+	}
+	return NULL;
+}
+
+static int daliqueue_removable(DaliTransactionPtr transaction, unsigned int classes) {
+	for (; transaction; transaction = transaction->next) {
+		if (!(classes & (1 << daliframe_classify(transaction->request)))) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+size_t daliqueue_remove(DaliQueuePtr queue, void *arg, unsigned int classes) {
+	size_t removed = 0;
+	if (queue && arg && classes) {
+		size_t i;
+		for (i = 0; i < DALIQUEUE_PRIORITIES; i++) {
+			ListNodePtr fnode = list_first(queue->flows[i]);
+			while (fnode) {
+				ListNodePtr fnext = list_next(fnode);
+				DaliFlow *flow = list_data(fnode);
+				ListNodePtr node = list_first(flow->transactions);
+				while (node) {
+					// The flow is freed with its last transaction, next is NULL then
+					ListNodePtr next = list_next(node);
+					DaliTransactionPtr transaction = (DaliTransactionPtr) list_data(node);
+					if (transaction->arg == arg && daliqueue_removable(transaction, classes)) {
+						dalitransaction_cancel(transaction, arg);
+						void *waiter = dalitransaction_next_waiter(transaction);
+						if (waiter) {
+							// Somebody else is still interested in the result
+							transaction->arg = waiter;
+						} else {
+							daliqueue_unlink(queue, i, fnode, node);
+							DaliTransactionPtr frame;
+							for (frame = transaction->next; frame; frame = frame->next) {
+								daliqueue_release(queue, frame);
+							}
+							dalitransaction_free(transaction);
+							removed++;
+						}
+					}
+					node = next;
+				}
+				fnode = fnext;
+			}
+		}
+	}
+	return removed;
+}
+
+void daliqueue_cancel(DaliQueuePtr queue, void *arg) {
+	if (queue && arg) {
+		size_t i;
+		for (i = 0; i < DALIQUEUE_PRIORITIES; i++) {
+			ListNodePtr fnode;
+			for (fnode = list_first(queue->flows[i]); fnode; fnode = list_next(fnode)) {
+				DaliFlow *flow = list_data(fnode);
+				ListNodePtr node;
+				for (node = list_first(flow->transactions); node; node = list_next(node)) {
+					dalitransaction_cancel((DaliTransactionPtr) list_data(node), arg);
+				}
+			}
+		}
+		dalitransaction_cancel(queue->sequence, arg);
+		dalitransaction_cancel(queue->expired, arg);
+	}
+}
+
+void daliqueue_set_groups(DaliQueuePtr queue, const uint64_t *groups, uint64_t devices) {
+	if (queue) {
+		if (groups) {
+			memcpy(queue->groups, groups, sizeof(queue->groups));
+		} else {
+			memset(queue->groups, 0, sizeof(queue->groups));
+		}
+		queue->devices = devices;
+	}
+}
+
+static int daliqueue_groupable(DaliTransactionPtr transaction) {
+	uint32_t key;
+	DaliFramePtr frame = transaction->request;
+	// Only what a group frame could do as well
+	return !transaction->next && frame && frame->ecommand == 0 && (frame->address & 0x80) == 0 && daliframe_classify(frame) != DALIFRAME_CLASS_QUERY && daliqueue_key(frame, &key);
+}
+
+static int daliqueue_indexed(DaliQueuePtr queue, DaliTransactionPtr transaction) {
+	uint32_t key;
+	if (daliqueue_key(transaction->request, &key)) {
+		return list_find(queue->index[key % DALIQUEUE_INDEX_BUCKETS], list_equal, transaction) != NULL;
+	}
+	return 0;
+}
+
+static int daliqueue_groupmate(DaliQueuePtr queue, DaliTransactionPtr transaction, DaliTransactionPtr other) {
+	DaliFramePtr a = transaction->request;
+	DaliFramePtr b = other->request;
+	// Frames that were overtaken by another one to the same device aren't in the index anymore,
+	// neither are frames that are sent again
+	return other != transaction && other->priority == transaction->priority && (a->address & 0x01) == (b->address & 0x01) && a->command == b->command && daliqueue_indexed(queue, other) && daliqueue_indexed(queue, transaction);
+}
+
+static uint8_t daliqueue_group_address(DaliQueuePtr queue, uint64_t targets, int final) {
+	uint8_t address = 0;
+	int larger = 0;
+	unsigned int group;
+	for (group = 0; group <= DALIQUEUE_GROUPS; group++) {
+		// The broadcast comes last
+		uint64_t members = group < DALIQUEUE_GROUPS ? queue->groups[group] : queue->devices;
+		if (members != 0 && members == targets) {
+			if (address == 0) {
+				address = group < DALIQUEUE_GROUPS ? 0x80 | group << 1 : 0xfe;
+			}
+		} else if ((members & targets) == targets) {
+			larger = 1;
+		}
+	}
+	// The frames for a larger group may still come in
+	if (larger && !final) {
+		return 0;
+	}
+	// 0 is not a valid group address
+	return address;
+}
+
+static int daliqueue_absorb(DaliQueuePtr queue, DaliTransactionPtr transaction, DaliTransactionPtr other) {
+	// Cancelled requests don't need a result
+	if (other->arg && !dalitransaction_add_waiter(transaction, other->arg)) {
+		return 0;
+	}
+	void *waiter;
+	while ((waiter = dalitransaction_next_waiter(other))) {
+		dalitransaction_add_waiter(transaction, waiter);
+	}
+	// Keep the later deadline, no deadline is the latest
+	if (transaction->deadline != 0 && (other->deadline == 0 || other->deadline > transaction->deadline)) {
+		daliqueue_set_deadline(queue, transaction, other->deadline);
+	}
+	size_t priority = other->priority;
+	ListNodePtr fnode = list_find(queue->flows[priority], daliflow_owner_equal, other->owner);
+	DaliFlow *flow = list_data(fnode);
+	if (flow) {
+		daliqueue_unlink(queue, priority, fnode, list_find(flow->transactions, list_equal, other));
+	}
+	dalitransaction_free(other);
+	return 1;
+}
+
+static size_t daliqueue_merge(DaliQueuePtr queue, DaliTransactionPtr transaction, int final, unsigned long *cost) {
+	size_t saved = 0;
+	if (transaction->hold != 0) {
+		uint64_t targets = (uint64_t) 1 << (transaction->request->address >> 1);
+		size_t mates = 0;
+		ListNodePtr node;
+		for (node = list_first(queue->held); node; node = list_next(node)) {
+			DaliTransactionPtr other = list_data(node);
+			if (daliqueue_groupmate(queue, transaction, other)) {
+				targets |= (uint64_t) 1 << (other->request->address >> 1);
+				mates++;
+			}
+		}
+		uint8_t address = daliqueue_group_address(queue, targets, final);
+		if (mates > 0 && address != 0) {
+			// transaction is the latest of them, nothing after it was sent to the same devices
+			node = list_first(queue->held);
+			while (node) {
+				ListNodePtr next = list_next(node);
+				DaliTransactionPtr other = list_data(node);
+				if (daliqueue_groupmate(queue, transaction, other)) {
+					// The unlinked node may have been the next one
+					unsigned long other_cost = other->cost;
+					if (daliqueue_absorb(queue, transaction, other)) {
+						saved++;
+						if (cost) {
+							*cost += other_cost;
+						}
+						next = list_first(queue->held);
+					}
+				}
+				node = next;
+			}
+			daliqueue_index_remove(queue, transaction);
+			list_remove(queue->held, list_find(queue->held, list_equal, transaction));
+			transaction->hold = 0;
+			transaction->request->address = address | (transaction->request->address & 0x01);
+			// Older frames to the members must not be changed anymore
+			daliqueue_index_invalidate(queue, transaction->request);
+			uint32_t key;
+			if (daliqueue_key(transaction->request, &key)) {
+				list_enqueue(queue->index[key % DALIQUEUE_INDEX_BUCKETS], transaction);
+			}
+		}
+	}
+	return saved;
+}
+
+size_t daliqueue_group(DaliQueuePtr queue, DaliTransactionPtr transaction, unsigned long *cost) {
+	if (queue && transaction) {
+		return daliqueue_merge(queue, transaction, 0, cost);
+	}
+	return 0;
+}
+
+size_t daliqueue_length_held(DaliQueuePtr queue) {
+	if (queue) {
+		return list_length(queue->held);
+	}
+	return 0;
+}
+
+long daliqueue_hold_wait(DaliQueuePtr queue, unsigned long now) {
+	long wait = -1;
+	if (queue) {
+		ListNodePtr node;
+		for (node = list_first(queue->held); node; node = list_next(node)) {
+			DaliTransactionPtr transaction = list_data(node);
+			long remaining = transaction->hold > now ? (long) (transaction->hold - now) : 0;
+			if (wait < 0 || remaining < wait) {
+				wait = remaining;
+			}
+		}
+	}
+	return wait;
+}
+
+size_t daliqueue_unhold(DaliQueuePtr queue, unsigned long now, unsigned long *cost) {
+	size_t saved = 0;
+	if (queue) {
+		ListNodePtr node = list_first(queue->held);
+		while (node) {
+			DaliTransactionPtr transaction = list_data(node);
+			if (transaction->hold > now) {
+				node = list_next(node);
+				continue;
+			}
+			// Last chance to merge it with the frames that came in after it
+			DaliTransactionPtr latest = NULL;
+			ListNodePtr mate;
+			for (mate = list_next(node); mate; mate = list_next(mate)) {
+				if (daliqueue_groupmate(queue, list_data(mate), transaction)) {
+					latest = list_data(mate);
+				}
+			}
+			size_t merged = latest ? daliqueue_merge(queue, latest, 1, cost) : 0;
+			if (merged == 0) {
+				transaction->hold = 0;
+				list_remove(queue->held, node);
+			}
+			saved += merged;
+			// Merging may have removed any of the nodes
+			node = list_first(queue->held);
+		}
+	}
+	return saved;
+}
@@ -0,0 +1,191 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _QUEUE_H
+#define _QUEUE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "frame.h"
+#include "list.h"
+
+// Scheduling classes, lower values are served first
+typedef enum {
+	// Reserved for time-triggered commands of the server, so they are sent on time
+	DALIQUEUE_PRIORITY_SCHEDULED = 0,
+	// Wall switches, user interfaces, emergency commands
+	DALIQUEUE_PRIORITY_INTERACTIVE = 1,
+	// Default class for all requests
+	DALIQUEUE_PRIORITY_NORMAL = 2,
+	// Status polling and monitoring
+	DALIQUEUE_PRIORITY_BACKGROUND = 3,
+} DaliQueuePriority;
+
+// Number of priority classes
+#define DALIQUEUE_PRIORITIES 4
+// Number of DALI groups that frames can be merged into
+#define DALIQUEUE_GROUPS 16
+
+typedef struct DaliTransaction {
+	unsigned int seq_num;
+	DaliFramePtr request;
+	DaliQueuePriority priority;
+	// Estimated bus time in msec, used for fair scheduling
+	unsigned int cost;
+	// The submitter, transactions are scheduled fairly between owners
+	void *owner;
+	// Time after which the transaction must not be sent anymore
+	// (msec on the monotonic clock, 0 if there is no deadline)
+	unsigned long deadline;
+	// Position in the deadline heap, -1 if not queued
+	ssize_t heap_index;
+	void *arg;
+	// Callback arguments of merged requests, NULL if there are none
+	ListPtr waiters;
+	// The following frame of an atomic sequence, NULL if there is none
+	struct DaliTransaction *next;
+	// Maximum time in msec between the end of the previous frame of the sequence
+	// and the start of this one, 0 = no limit
+	unsigned int gap;
+	// Time until which the frame waits for others that can be merged with it into a group frame,
+	// or before it is sent again after a failure (msec on the monotonic clock, 0 if it may be sent right away)
+	unsigned long hold;
+	// 1 if the frame belongs to an atomic sequence
+	int in_sequence;
+	// Number of times the frame was sent again after a failed transfer
+	unsigned int retries;
+} DaliTransaction;
+typedef DaliTransaction *DaliTransactionPtr;
+
+struct DaliQueue;
+typedef struct DaliQueue *DaliQueuePtr;
+
+// Allocates a transaction, taking ownership of the request frame
+// The owner is initialised to arg
+DaliTransactionPtr dalitransaction_new(DaliFramePtr request, DaliQueuePriority priority, void *arg);
+// Deallocates a transaction and its request frame, and the rest of its sequence
+void dalitransaction_free(DaliTransactionPtr transaction);
+// Appends next to the sequence that starts with transaction, taking ownership of it
+// The frames of a sequence are sent back to back, no other frame is sent in between.
+// next must be sent at most gap msec after the frame before it, 0 = no limit.
+void dalitransaction_append(DaliTransactionPtr transaction, DaliTransactionPtr next, unsigned int gap);
+// Returns the number of frames in the sequence that starts with transaction
+size_t dalitransaction_length(DaliTransactionPtr transaction);
+// Adds another callback argument that is waiting for the result of a transaction
+// Returns 0 if there is not enough memory
+int dalitransaction_add_waiter(DaliTransactionPtr transaction, void *arg);
+// Removes and returns the next additional waiter, NULL if there are none left
+void *dalitransaction_next_waiter(DaliTransactionPtr transaction);
+// Sets arg to NULL and removes all waiters if they are equal to arg
+// The rest of the sequence is cancelled as well.
+void dalitransaction_cancel(DaliTransactionPtr transaction, void *arg);
+// Returns 1 if transaction is a query and frame is the same query,
+// so that the response can be shared
+int dalitransaction_same_query(DaliTransactionPtr transaction, DaliFramePtr frame);
+
+// Creates an empty transaction queue
+DaliQueuePtr daliqueue_new();
+// Destroys the queue and all transactions still contained in it
+void daliqueue_free(DaliQueuePtr queue);
+// Returns the total number of queued frames, including those of an unfinished sequence
+size_t daliqueue_length(DaliQueuePtr queue);
+// Returns the number of queued transactions in a priority class
+size_t daliqueue_length_priority(DaliQueuePtr queue, DaliQueuePriority priority);
+// Returns the number of queued transactions submitted by owner
+size_t daliqueue_length_owner(DaliQueuePtr queue, void *owner);
+// Returns the estimated bus time of all queued transactions in msec
+unsigned long daliqueue_cost(DaliQueuePtr queue);
+// Merges a transaction into a queued one that it supersedes
+// Direct arc power frames replace the level of a queued frame to the same address,
+// identical idempotent commands (off, recall, go to scene) and identical queries
+// are sent only once.
+// Queued frames are not merged if another frame to the same devices was queued after them.
+// Returns the queued transaction on success, the submitter of transaction is added as a
+// waiter then and transaction should be freed. Returns NULL if it can't be merged.
+// Sequences are never merged.
+DaliTransactionPtr daliqueue_coalesce(DaliQueuePtr queue, DaliTransactionPtr transaction);
+// Appends a transaction to its owner's queue in its priority class
+// A sequence is queued as a whole, all its frames get the class and owner of the first one.
+// If the transaction has a hold time, it is not sent before that time unless daliqueue_group
+// merges other frames into it. Only single commands to short addresses that could become
+// group commands are held, the hold time of other transactions is cleared.
+// Returns 0 if the transaction could not be queued, the caller keeps ownership then
+int daliqueue_push(DaliQueuePtr queue, DaliTransactionPtr transaction);
+// Removes and returns the next transaction, serving higher priority classes first
+// Inside a class, owners are served by deficit round robin, so each gets
+// an equal share of bus time regardless of how many frames it has queued.
+// Once the first frame of a sequence was returned, the following frames of the
+// sequence are returned next, one by one, regardless of their class.
+// Held transactions are skipped, their owners wait for them.
+// Returns NULL if the queue is empty or everything is held
+DaliTransactionPtr daliqueue_pop(DaliQueuePtr queue);
+// Puts a single transaction that was returned by daliqueue_pop back in front of its owner's
+// queue, so it is sent again before the owner's other frames, but not before hold (0 = right away).
+// It is never merged with other frames again, and its retry counter is incremented.
+// Sequences can't be requeued.
+// Returns 0 if the transaction could not be queued, the caller keeps ownership then
+int daliqueue_requeue(DaliQueuePtr queue, DaliTransactionPtr transaction, unsigned long hold);
+// Must be called when a transaction returned by daliqueue_pop has left the bus
+// If it belongs to a sequence, the next frame expires unless it is sent within its gap from now.
+// If failed is non-zero, the rest of the sequence expires right away.
+void daliqueue_finish(DaliQueuePtr queue, unsigned long now, int failed);
+// Removes and returns a transaction whose deadline is before or at now
+// Returns NULL if there are no expired transactions
+// Call this repeatedly before daliqueue_pop to make sure stale transactions aren't sent.
+// When a frame of a sequence expires, all following frames of the sequence expire with it.
+DaliTransactionPtr daliqueue_expire(DaliQueuePtr queue, unsigned long now);
+// Removes all transactions whose arg is equal to arg and whose frame class
+// is in classes (a bit mask of 1 << DaliFrameClass)
+// Sequences that haven't started are only removed if all their frames are in classes.
+// Returns the number of transactions that were removed
+size_t daliqueue_remove(DaliQueuePtr queue, void *arg, unsigned int classes);
+// Sets the callback argument of all queued transactions to NULL if they are equal to arg
+void daliqueue_cancel(DaliQueuePtr queue, void *arg);
+// Sets the group memberships that daliqueue_group relies on, bit n = short address n
+// groups contains the members of each group, devices all devices that a broadcast reaches.
+// A group or broadcast that is 0 is never used. groups may be NULL to clear all groups.
+void daliqueue_set_groups(DaliQueuePtr queue, const uint64_t *groups, uint64_t devices);
+// Merges held frames with the same command into transaction if their short addresses,
+// together with that of transaction, are exactly the members of a group or all devices.
+// transaction must be the last one pushed, with a hold time. It is turned into a group or
+// broadcast frame that is sent without waiting any further, the merged transactions are
+// freed and their submitters are added as its waiters.
+// Frames are only merged within a priority class, and not if another frame to the same
+// devices was queued after them. While the frames may still become part of a larger group,
+// they are not merged yet; daliqueue_unhold does that when their time is up.
+// Returns the number of frames saved, 0 if nothing was merged. The estimated bus time
+// saved is added to cost if it isn't NULL.
+size_t daliqueue_group(DaliQueuePtr queue, DaliTransactionPtr transaction, unsigned long *cost);
+// Returns the number of transactions that are held back
+size_t daliqueue_length_held(DaliQueuePtr queue);
+// Returns the time in msec until the next held transaction may be sent, 0 if one may be
+// sent right away, -1 if nothing is held
+long daliqueue_hold_wait(DaliQueuePtr queue, unsigned long now);
+// Lets held transactions whose hold time is before or at now be sent by daliqueue_pop
+// If they and the frames that were held after them address a group, they are merged first.
+// Returns the number of frames saved like daliqueue_group
+size_t daliqueue_unhold(DaliQueuePtr queue, unsigned long now, unsigned long *cost);
+
+#endif /*_QUEUE_H*/
@@ -0,0 +1,163 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ratelimit.h"
+#include <stdlib.h>
+#include <string.h>
+#include "list.h"
+
+// Tokens are counted in thousandths, so a rate in tokens/sec is a rate in units/msec
+static const unsigned long TOKEN_UNIT = 1000;
+
+typedef struct {
+	char *key;
+	TokenBucket bucket;
+} RateLimitEntry;
+
+struct RateLimitTable {
+	unsigned int rate;
+	unsigned int burst;
+	ListPtr entries;
+};
+
+static void tokenbucket_refill(TokenBucket *bucket, unsigned long now);
+static void ratelimit_entry_free(RateLimitEntry *entry);
+
+void tokenbucket_init(TokenBucket *bucket, unsigned int rate, unsigned int burst, unsigned long now) {
+	if (bucket) {
+		bucket->rate = rate;
+		bucket->burst = burst ? burst : rate;
+		if (bucket->burst == 0) {
+			bucket->burst = 1;
+		}
+		bucket->tokens = bucket->burst * TOKEN_UNIT;
+		bucket->last = now;
+	}
+}
+
+static void tokenbucket_refill(TokenBucket *bucket, unsigned long now) {
+	unsigned long max = bucket->burst * TOKEN_UNIT;
+	if (now > bucket->last) {
+		unsigned long elapsed = now - bucket->last;
+		if (elapsed >= max / bucket->rate) {
+			bucket->tokens = max;
+		} else {
+			bucket->tokens += elapsed * bucket->rate;
+			if (bucket->tokens > max) {
+				bucket->tokens = max;
+			}
+		}
+	}
+	bucket->last = now;
+}
+
+unsigned int tokenbucket_take(TokenBucket *bucket, unsigned long now) {
+	if (!bucket || bucket->rate == 0) {
+		return 0;
+	}
+	tokenbucket_refill(bucket, now);
+	if (bucket->tokens >= TOKEN_UNIT) {
+		bucket->tokens -= TOKEN_UNIT;
+		return 0;
+	}
+	return (unsigned int) ((TOKEN_UNIT - bucket->tokens + bucket->rate - 1) / bucket->rate);
+}
+
+int tokenbucket_full(TokenBucket *bucket, unsigned long now) {
+	if (!bucket || bucket->rate == 0) {
+		return 1;
+	}
+	tokenbucket_refill(bucket, now);
+	return bucket->tokens >= bucket->burst * TOKEN_UNIT;
+}
+
+RateLimitTablePtr ratelimit_table_new(unsigned int rate, unsigned int burst) {
+	RateLimitTablePtr table = malloc(sizeof(struct RateLimitTable));
+	if (table) {
+		table->rate = rate;
+		table->burst = burst;
+		table->entries = list_new((ListDataFreeFunc) ratelimit_entry_free);
+		if (!table->entries) {
+			free(table);
+			table = NULL;
+		}
+	}
+	return table;
+}
+
+void ratelimit_table_free(RateLimitTablePtr table) {
+	if (table) {
+		list_free(table->entries);
+		free(table);
+	}
+}
+
+static void ratelimit_entry_free(RateLimitEntry *entry) {
+	if (entry) {
+		free(entry->key);
+		free(entry);
+	}
+}
+
+unsigned int ratelimit_table_take(RateLimitTablePtr table, const char *key, unsigned long now) {
+	if (!table || !key || table->rate == 0) {
+		return 0;
+	}
+	RateLimitEntry *found = NULL;
+	ListNodePtr node = list_first(table->entries);
+	while (node) {
+		ListNodePtr next = list_next(node);
+		RateLimitEntry *entry = list_data(node);
+		if (strcmp(entry->key, key) == 0) {
+			found = entry;
+		} else if (tokenbucket_full(&entry->bucket, now)) {
+			list_remove(table->entries, node);
+			ratelimit_entry_free(entry);
+		}
+		node = next;
+	}
+	if (!found) {
+		found = malloc(sizeof(RateLimitEntry));
+		if (!found) {
+			// Don't punish clients for our own problems
+			return 0;
+		}
+		found->key = strdup(key);
+		if (!found->key) {
+			free(found);
+			return 0;
+		}
+		tokenbucket_init(&found->bucket, table->rate, table->burst, now);
+		list_enqueue(table->entries, found);
+	}
+	return tokenbucket_take(&found->bucket, now);
+}
+
+size_t ratelimit_table_length(RateLimitTablePtr table) {
+	if (table) {
+		return list_length(table->entries);
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _RATELIMIT_H
+#define _RATELIMIT_H
+
+#include <stddef.h>
+
+// A token bucket
+// One token is needed for each frame, tokens are kept in 1/1000 units
+typedef struct {
+	// Tokens added per second, 0 means unlimited
+	unsigned int rate;
+	// Maximum number of tokens in the bucket
+	unsigned int burst;
+	unsigned long tokens;
+	// Time of the last refill in msec
+	unsigned long last;
+} TokenBucket;
+
+struct RateLimitTable;
+typedef struct RateLimitTable *RateLimitTablePtr;
+
+// Initializes a full token bucket
+// If burst is 0, rate is used instead (one second worth of tokens)
+void tokenbucket_init(TokenBucket *bucket, unsigned int rate, unsigned int burst, unsigned long now);
+// Takes one token from the bucket
+// Returns 0 if a token was available, or the time in msec until one will be
+unsigned int tokenbucket_take(TokenBucket *bucket, unsigned long now);
+// Returns 1 if the bucket is full at time now
+int tokenbucket_full(TokenBucket *bucket, unsigned long now);
+
+// Creates a table of token buckets that are looked up by name (i.e. a client address)
+// All buckets use the same rate and burst size
+RateLimitTablePtr ratelimit_table_new(unsigned int rate, unsigned int burst);
+// Destroys the table and all buckets in it
+void ratelimit_table_free(RateLimitTablePtr table);
+// Takes one token from the bucket for key, creating it if necessary
+// Returns 0 if a token was available, or the time in msec until one will be
+// Buckets that have filled up again are removed as they are equivalent to new ones.
+unsigned int ratelimit_table_take(RateLimitTablePtr table, const char *key, unsigned long now);
+// Returns the number of buckets in the table
+size_t ratelimit_table_length(RateLimitTablePtr table);
+
+#endif /*_RATELIMIT_H*/
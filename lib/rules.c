@@ -0,0 +1,214 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rules.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	unsigned int id;
+	DaliRulePattern pattern;
+	DaliFramePtr frames[DALIRULES_MAX_FRAMES];
+	size_t count;
+} DaliRule;
+typedef DaliRule *DaliRulePtr;
+
+struct DaliRules {
+	DaliRulePtr rules[DALIRULES_MAX];
+	size_t length;
+	// Rules that can match each address byte, in the order of their IDs
+	// Updated when a rule is added or removed, so lookups don't allocate.
+	DaliRulePtr *index[256];
+	size_t index_length[256];
+	size_t index_size[256];
+};
+
+static void dalirule_free(DaliRulePtr rule);
+static int dalirules_reserve(DaliRulesPtr rules, const DaliRulePattern *pattern);
+static void dalirules_index(DaliRulesPtr rules, DaliRulePtr rule);
+static void dalirules_unindex(DaliRulesPtr rules, DaliRulePtr rule);
+static void dalirules_clear_index(DaliRulesPtr rules);
+
+DaliRulesPtr dalirules_new() {
+	DaliRulesPtr rules = malloc(sizeof(struct DaliRules));
+	if (rules) {
+		memset(rules, 0, sizeof(struct DaliRules));
+	}
+	return rules;
+}
+
+void dalirules_free(DaliRulesPtr rules) {
+	if (rules) {
+		dalirules_clear_index(rules);
+		unsigned int id;
+		for (id = 0; id < DALIRULES_MAX; id++) {
+			dalirule_free(rules->rules[id]);
+		}
+		free(rules);
+	}
+}
+
+int dalirules_add(DaliRulesPtr rules, unsigned int id, const DaliRulePattern *pattern, const uint8_t *frames, size_t count) {
+	if (!rules || id >= DALIRULES_MAX || !pattern || !frames || count == 0 || count > DALIRULES_MAX_FRAMES) {
+		return 0;
+	}
+	DaliRulePtr rule = malloc(sizeof(DaliRule));
+	if (!rule) {
+		return 0;
+	}
+	rule->id = id;
+	rule->pattern = *pattern;
+	rule->count = 0;
+	size_t i;
+	for (i = 0; i < count; i++) {
+		rule->frames[i] = daliframe_new(frames[i * 2], frames[i * 2 + 1]);
+		if (!rule->frames[i] || daliframe_answered(rule->frames[i])) {
+			daliframe_free(rule->frames[i]);
+			dalirule_free(rule);
+			return 0;
+		}
+		rule->count++;
+	}
+	// Make room first, so the old rule stays in place if there isn't enough memory
+	if (!dalirules_reserve(rules, pattern)) {
+		dalirule_free(rule);
+		return 0;
+	}
+	if (rules->rules[id]) {
+		dalirules_unindex(rules, rules->rules[id]);
+		dalirule_free(rules->rules[id]);
+	} else {
+		rules->length++;
+	}
+	rules->rules[id] = rule;
+	dalirules_index(rules, rule);
+	return 1;
+}
+
+int dalirules_remove(DaliRulesPtr rules, unsigned int id) {
+	if (rules && id < DALIRULES_MAX && rules->rules[id]) {
+		dalirules_unindex(rules, rules->rules[id]);
+		dalirule_free(rules->rules[id]);
+		rules->rules[id] = NULL;
+		rules->length--;
+		return 1;
+	}
+	return 0;
+}
+
+size_t dalirules_length(DaliRulesPtr rules) {
+	if (rules) {
+		return rules->length;
+	}
+	return 0;
+}
+
+size_t dalirules_match(DaliRulesPtr rules, DaliFramePtr frame, DaliRulesAction action, void *arg) {
+	if (!rules || !frame || rules->length == 0) {
+		return 0;
+	}
+	size_t matched = 0;
+	DaliRulePtr *candidates = rules->index[frame->address];
+	size_t i;
+	for (i = 0; i < rules->index_length[frame->address]; i++) {
+		DaliRulePattern *pattern = &candidates[i]->pattern;
+		if ((frame->command & pattern->command_mask) == (pattern->command & pattern->command_mask) &&
+			(frame->ecommand & pattern->ecommand_mask) == (pattern->ecommand & pattern->ecommand_mask)) {
+			matched++;
+			if (action) {
+				action(candidates[i]->id, candidates[i]->frames, candidates[i]->count, arg);
+			}
+		}
+	}
+	return matched;
+}
+
+static void dalirule_free(DaliRulePtr rule) {
+	if (rule) {
+		size_t i;
+		for (i = 0; i < rule->count; i++) {
+			daliframe_free(rule->frames[i]);
+		}
+		free(rule);
+	}
+}
+
+// Makes room for one more rule in the buckets of all address bytes the pattern can match
+// Returns 0 if there isn't enough memory, the index is unchanged then
+static int dalirules_reserve(DaliRulesPtr rules, const DaliRulePattern *pattern) {
+	unsigned int address;
+	for (address = 0; address < 256; address++) {
+		if ((address & pattern->address_mask) == (pattern->address & pattern->address_mask) && rules->index_length[address] == rules->index_size[address]) {
+			size_t size = rules->index_size[address] ? rules->index_size[address] * 2 : 4;
+			DaliRulePtr *bucket = realloc(rules->index[address], size * sizeof(DaliRulePtr));
+			if (!bucket) {
+				return 0;
+			}
+			rules->index[address] = bucket;
+			rules->index_size[address] = size;
+		}
+	}
+	return 1;
+}
+
+// Sorts the rule into the buckets of all address bytes it can match, room must be reserved
+static void dalirules_index(DaliRulesPtr rules, DaliRulePtr rule) {
+	unsigned int address;
+	for (address = 0; address < 256; address++) {
+		if ((address & rule->pattern.address_mask) == (rule->pattern.address & rule->pattern.address_mask)) {
+			DaliRulePtr *bucket = rules->index[address];
+			size_t i = rules->index_length[address];
+			while (i > 0 && bucket[i - 1]->id > rule->id) {
+				bucket[i] = bucket[i - 1];
+				i--;
+			}
+			bucket[i] = rule;
+			rules->index_length[address]++;
+		}
+	}
+}
+
+static void dalirules_unindex(DaliRulesPtr rules, DaliRulePtr rule) {
+	unsigned int address;
+	for (address = 0; address < 256; address++) {
+		DaliRulePtr *bucket = rules->index[address];
+		size_t i;
+		for (i = 0; i < rules->index_length[address] && bucket[i] != rule; i++);
+		if (i < rules->index_length[address]) {
+			memmove(&bucket[i], &bucket[i + 1], (rules->index_length[address] - i - 1) * sizeof(DaliRulePtr));
+			rules->index_length[address]--;
+		}
+	}
+}
+
+static void dalirules_clear_index(DaliRulesPtr rules) {
+	unsigned int address;
+	for (address = 0; address < 256; address++) {
+		free(rules->index[address]);
+		rules->index[address] = NULL;
+		rules->index_length[address] = 0;
+		rules->index_size[address] = 0;
+	}
+}
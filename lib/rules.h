@@ -0,0 +1,80 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _RULES_H
+#define _RULES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame.h"
+
+// Local reactions to frames from other bus masters, like push buttons and sensors
+// Each rule has a pattern with a value and a mask for each byte of the frame,
+// and a batch of frames that is sent when a frame matches it.
+// Rules are looked up through an index by address byte that is updated
+// when rules are added or removed, so matching never allocates.
+
+// Number of rule IDs
+#define DALIRULES_MAX 256
+// Maximum number of frames in a batch
+#define DALIRULES_MAX_FRAMES 16
+
+typedef struct {
+	uint8_t ecommand;
+	uint8_t ecommand_mask;
+	uint8_t address;
+	uint8_t address_mask;
+	uint8_t command;
+	uint8_t command_mask;
+} DaliRulePattern;
+
+struct DaliRules;
+typedef struct DaliRules *DaliRulesPtr;
+
+// Called for each rule that matches a frame, in the order of rule IDs
+// frames belong to the rule, they must be copied if they are kept
+typedef void (*DaliRulesAction)(unsigned int id, DaliFramePtr const *frames, size_t count, void *arg);
+
+// Creates an empty rule table
+DaliRulesPtr dalirules_new();
+// Destroys the rule table
+void dalirules_free(DaliRulesPtr rules);
+// Adds or replaces the rule with this id
+// A frame matches if (byte & mask) == (value & mask) for all three bytes.
+// frames are count address and command byte pairs.
+// Returns 0 if the id or the batch is invalid: empty, too long, or containing
+// frames that are answered by the devices, or if there isn't enough memory.
+// A rule with the same id is kept then.
+int dalirules_add(DaliRulesPtr rules, unsigned int id, const DaliRulePattern *pattern, const uint8_t *frames, size_t count);
+// Removes the rule with this id
+// Returns 0 if there is none
+int dalirules_remove(DaliRulesPtr rules, unsigned int id);
+// Returns the number of rules
+size_t dalirules_length(DaliRulesPtr rules);
+// Calls action for every rule that matches frame
+// Returns the number of matching rules
+size_t dalirules_match(DaliRulesPtr rules, DaliFramePtr frame, DaliRulesAction action, void *arg);
+
+#endif /*_RULES_H*/
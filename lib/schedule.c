@@ -0,0 +1,260 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "schedule.h"
+#include <stdlib.h>
+#include <sys/types.h>
+#include "heap.h"
+
+typedef struct {
+	unsigned int id;
+	DaliFramePtr frames[DALISCHEDULE_MAX_FRAMES];
+	size_t count;
+	// Next trigger time in msec
+	unsigned long due;
+	// 0 = only once
+	unsigned long period;
+	// Order of insertion, for entries with the same trigger time
+	unsigned long serial;
+	// Position in the heap
+	ssize_t heap_index;
+	// Position in the entry table
+	size_t table_index;
+} DaliScheduleEntry;
+typedef DaliScheduleEntry *DaliScheduleEntryPtr;
+
+struct DaliSchedule {
+	HeapPtr heap;
+	// All entries, for finding them by id
+	DaliScheduleEntryPtr *table;
+	size_t length;
+	size_t allocated;
+	unsigned long serial;
+	unsigned long missed;
+};
+
+static int dalischedule_compare(void *a, void *b);
+static void dalischedule_heap_index(void *data, ssize_t index);
+static DaliScheduleEntryPtr dalischedule_find(DaliSchedulePtr schedule, unsigned int id);
+static void dalischedule_delete(DaliSchedulePtr schedule, DaliScheduleEntryPtr entry);
+static void dalischedule_entry_free(DaliScheduleEntryPtr entry);
+
+DaliSchedulePtr dalischedule_new() {
+	DaliSchedulePtr schedule = malloc(sizeof(struct DaliSchedule));
+	if (schedule) {
+		schedule->heap = heap_new(dalischedule_compare, dalischedule_heap_index);
+		if (!schedule->heap) {
+			free(schedule);
+			return NULL;
+		}
+		schedule->table = NULL;
+		schedule->length = 0;
+		schedule->allocated = 0;
+		schedule->serial = 0;
+		schedule->missed = 0;
+	}
+	return schedule;
+}
+
+void dalischedule_free(DaliSchedulePtr schedule) {
+	if (schedule) {
+		size_t i;
+		for (i = 0; i < schedule->length; i++) {
+			dalischedule_entry_free(schedule->table[i]);
+		}
+		free(schedule->table);
+		heap_free(schedule->heap);
+		free(schedule);
+	}
+}
+
+int dalischedule_add(DaliSchedulePtr schedule, unsigned int id, const uint8_t *frames, size_t count, unsigned long due, unsigned long period) {
+	if (!schedule || !frames || count == 0 || count > DALISCHEDULE_MAX_FRAMES) {
+		return 0;
+	}
+	size_t i;
+	for (i = 0; i < count; i++) {
+		struct DaliFrame frame = { 0, frames[i * 2], frames[i * 2 + 1] };
+		if (daliframe_answered(&frame)) {
+			return 0;
+		}
+	}
+	DaliScheduleEntryPtr entry = malloc(sizeof(DaliScheduleEntry));
+	if (!entry) {
+		return 0;
+	}
+	entry->id = id;
+	entry->count = 0;
+	entry->due = due;
+	entry->period = period;
+	entry->serial = schedule->serial++;
+	entry->heap_index = -1;
+	for (i = 0; i < count; i++) {
+		entry->frames[i] = daliframe_new(frames[i * 2], frames[i * 2 + 1]);
+		if (!entry->frames[i]) {
+			dalischedule_entry_free(entry);
+			return 0;
+		}
+		entry->count++;
+	}
+	if (schedule->length == schedule->allocated) {
+		size_t allocated = schedule->allocated ? schedule->allocated * 2 : 16;
+		DaliScheduleEntryPtr *table = realloc(schedule->table, allocated * sizeof(DaliScheduleEntryPtr));
+		if (!table) {
+			dalischedule_entry_free(entry);
+			return 0;
+		}
+		schedule->table = table;
+		schedule->allocated = allocated;
+	}
+	if (!heap_push(schedule->heap, entry)) {
+		dalischedule_entry_free(entry);
+		return 0;
+	}
+	DaliScheduleEntryPtr old = dalischedule_find(schedule, id);
+	if (old) {
+		dalischedule_delete(schedule, old);
+	}
+	entry->table_index = schedule->length;
+	schedule->table[schedule->length++] = entry;
+	return 1;
+}
+
+int dalischedule_remove(DaliSchedulePtr schedule, unsigned int id) {
+	DaliScheduleEntryPtr entry = dalischedule_find(schedule, id);
+	if (entry) {
+		dalischedule_delete(schedule, entry);
+		return 1;
+	}
+	return 0;
+}
+
+size_t dalischedule_length(DaliSchedulePtr schedule) {
+	if (schedule) {
+		return schedule->length;
+	}
+	return 0;
+}
+
+long dalischedule_wait(DaliSchedulePtr schedule, unsigned long now) {
+	if (schedule) {
+		DaliScheduleEntryPtr entry = heap_peek(schedule->heap);
+		if (entry) {
+			return entry->due > now ? (long) (entry->due - now) : 0;
+		}
+	}
+	return -1;
+}
+
+size_t dalischedule_next(DaliSchedulePtr schedule, unsigned long now, DaliFramePtr *frames, unsigned int *id, unsigned long *due) {
+	if (!schedule || !frames) {
+		return 0;
+	}
+	DaliScheduleEntryPtr entry = heap_peek(schedule->heap);
+	if (!entry || entry->due > now) {
+		return 0;
+	}
+	size_t count = 0;
+	size_t i;
+	for (i = 0; i < entry->count; i++) {
+		frames[count] = daliframe_clone(entry->frames[i]);
+		if (frames[count]) {
+			count++;
+		}
+	}
+	if (id) {
+		*id = entry->id;
+	}
+	if (due) {
+		*due = entry->due;
+	}
+	if (entry->period > 0) {
+		entry->due += entry->period;
+		// Don't catch up on triggers that are already a period late
+		if (entry->due < now) {
+			unsigned long skipped = (now - entry->due + entry->period - 1) / entry->period;
+			schedule->missed += skipped;
+			entry->due += skipped * entry->period;
+		}
+		entry->serial = schedule->serial++;
+		heap_update(schedule->heap, (size_t) entry->heap_index);
+	} else {
+		dalischedule_delete(schedule, entry);
+	}
+	return count;
+}
+
+unsigned long dalischedule_missed(DaliSchedulePtr schedule) {
+	if (schedule) {
+		return schedule->missed;
+	}
+	return 0;
+}
+
+static int dalischedule_compare(void *a, void *b) {
+	DaliScheduleEntryPtr ea = (DaliScheduleEntryPtr) a;
+	DaliScheduleEntryPtr eb = (DaliScheduleEntryPtr) b;
+	if (ea->due != eb->due) {
+		return ea->due < eb->due ? -1 : 1;
+	}
+	if (ea->serial != eb->serial) {
+		return ea->serial < eb->serial ? -1 : 1;
+	}
+	return 0;
+}
+
+static void dalischedule_heap_index(void *data, ssize_t index) {
+	((DaliScheduleEntryPtr) data)->heap_index = index;
+}
+
+static DaliScheduleEntryPtr dalischedule_find(DaliSchedulePtr schedule, unsigned int id) {
+	if (schedule) {
+		size_t i;
+		for (i = 0; i < schedule->length; i++) {
+			if (schedule->table[i]->id == id) {
+				return schedule->table[i];
+			}
+		}
+	}
+	return NULL;
+}
+
+static void dalischedule_delete(DaliSchedulePtr schedule, DaliScheduleEntryPtr entry) {
+	if (entry->heap_index >= 0) {
+		heap_remove(schedule->heap, (size_t) entry->heap_index);
+	}
+	DaliScheduleEntryPtr last = schedule->table[--schedule->length];
+	schedule->table[entry->table_index] = last;
+	last->table_index = entry->table_index;
+	dalischedule_entry_free(entry);
+}
+
+static void dalischedule_entry_free(DaliScheduleEntryPtr entry) {
+	size_t i;
+	for (i = 0; i < entry->count; i++) {
+		daliframe_free(entry->frames[i]);
+	}
+	free(entry);
+}
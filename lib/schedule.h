@@ -0,0 +1,76 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SCHEDULE_H
+#define _SCHEDULE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame.h"
+
+// Time-triggered command batches
+// Each entry holds a batch of frames that were checked when it was added,
+// and a trigger time on the monotonic clock. Recurring entries are triggered
+// again after their period. Entries are kept in a heap ordered by trigger time,
+// entries with the same time are triggered in the order they were added.
+
+// Maximum number of frames in a batch
+#define DALISCHEDULE_MAX_FRAMES 16
+
+struct DaliSchedule;
+typedef struct DaliSchedule *DaliSchedulePtr;
+
+// Creates an empty schedule
+DaliSchedulePtr dalischedule_new();
+// Destroys the schedule and all entries
+void dalischedule_free(DaliSchedulePtr schedule);
+// Adds a batch of count frames, given as address and command byte pairs
+// due is the first trigger time in msec, period the time between triggers
+// in msec, or 0 if the batch is only sent once.
+// An existing entry with the same id is replaced.
+// Returns 0 if the batch is invalid: empty, too long, or containing frames that
+// are answered by the devices, as there is nobody to read the answers.
+int dalischedule_add(DaliSchedulePtr schedule, unsigned int id, const uint8_t *frames, size_t count, unsigned long due, unsigned long period);
+// Removes the entry with this id
+// Returns 0 if there is none
+int dalischedule_remove(DaliSchedulePtr schedule, unsigned int id);
+// Returns the number of entries
+size_t dalischedule_length(DaliSchedulePtr schedule);
+// Returns the time in msec until the next entry is due, 0 if one is due now,
+// or -1 if the schedule is empty
+long dalischedule_wait(DaliSchedulePtr schedule, unsigned long now);
+// Triggers the next entry that is due at time now
+// Copies of its frames are stored in frames, which must have room for
+// DALISCHEDULE_MAX_FRAMES, and belong to the caller. id and due are set to
+// its id and the time it was due. Recurring entries are moved to their next
+// trigger time, skipping those that are already more than a period late.
+// Entries that are only sent once are removed.
+// Returns the number of frames, 0 if no entry is due.
+size_t dalischedule_next(DaliSchedulePtr schedule, unsigned long now, DaliFramePtr *frames, unsigned int *id, unsigned long *due);
+// Returns the number of triggers of recurring entries that were skipped
+// because they were more than one period late
+unsigned long dalischedule_missed(DaliSchedulePtr schedule);
+
+#endif /*_SCHEDULE_H*/
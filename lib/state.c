@@ -0,0 +1,459 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// Fade times in msec: 0.5 * sqrt(2^X) seconds, 0 = no fade
+static const unsigned int DALISTATE_FADE_TIMES[16] = {
+	0, 707, 1000, 1414, 2000, 2828, 4000, 5657, 8000, 11314, 16000, 22627, 32000, 45255, 64000, 90510
+};
+// Fade rates in steps per second: 506 / sqrt(2^Y), 0 is not allowed
+static const unsigned int DALISTATE_FADE_RATES[16] = {
+	0, 358, 253, 179, 126, 89, 63, 45, 32, 22, 16, 11, 8, 6, 4, 3
+};
+// Up and down run for this long
+static const unsigned int DALISTATE_STEP_TIME = 200; //msec
+
+struct DaliState {
+	DaliDeviceState devices[DALISTATE_DEVICES];
+	// Reverse index of DaliDeviceState.groups
+	uint64_t members[DALISTATE_GROUPS];
+	// The data transfer register is shared by all devices, as it's set with a broadcast
+	uint8_t dtr;
+	int dtr_known;
+};
+
+static uint64_t dalistate_targets(DaliStatePtr state, uint8_t address, uint64_t *unknown);
+static void dalistate_set_groups(DaliStatePtr state, unsigned int device, uint16_t groups);
+static void dalistate_apply(DaliStatePtr state, unsigned int device, uint8_t command, int arc, unsigned long now);
+static void dalistate_fade(DaliDeviceState *dev, uint8_t level, unsigned int duration, unsigned long now);
+static int dalistate_estimate_device(const DaliDeviceState *dev, unsigned long now, int *fading);
+static int dalistate_touch(DaliDeviceState *device, const DaliDeviceState *old, unsigned long now);
+
+DaliStatePtr dalistate_new() {
+	DaliStatePtr state = malloc(sizeof(struct DaliState));
+	if (state) {
+		memset(state, 0, sizeof(struct DaliState));
+	}
+	return state;
+}
+
+void dalistate_free(DaliStatePtr state) {
+	free(state);
+}
+
+const DaliDeviceState *dalistate_device(DaliStatePtr state, unsigned int device) {
+	if (state && device < DALISTATE_DEVICES) {
+		return &state->devices[device];
+	}
+	return NULL;
+}
+
+uint64_t dalistate_members(DaliStatePtr state, unsigned int group) {
+	if (state && group < DALISTATE_GROUPS) {
+		return state->members[group];
+	}
+	return 0;
+}
+
+static uint64_t dalistate_targets(DaliStatePtr state, uint8_t address, uint64_t *unknown) {
+	*unknown = 0;
+	if ((address & 0x80) == 0) {
+		return (uint64_t) 1 << (address >> 1);
+	}
+	if ((address & 0xe0) == 0x80) {
+		// Devices with unknown membership may be addressed too
+		unsigned int device;
+		for (device = 0; device < DALISTATE_DEVICES; device++) {
+			if (!(state->devices[device].flags & DALISTATE_GROUPS_KNOWN)) {
+				*unknown |= (uint64_t) 1 << device;
+			}
+		}
+		return state->members[(address >> 1) & 0x0f] & ~*unknown;
+	}
+	return ~(uint64_t) 0;
+}
+
+static void dalistate_set_groups(DaliStatePtr state, unsigned int device, uint16_t groups) {
+	unsigned int group;
+	state->devices[device].groups = groups;
+	for (group = 0; group < DALISTATE_GROUPS; group++) {
+		if (groups & (1 << group)) {
+			state->members[group] |= (uint64_t) 1 << device;
+		} else {
+			state->members[group] &= ~((uint64_t) 1 << device);
+		}
+	}
+}
+
+static void dalistate_fade(DaliDeviceState *dev, uint8_t level, unsigned int duration, unsigned long now) {
+	int current = -1;
+	if (duration > 0) {
+		current = dalistate_estimate_device(dev, now, NULL);
+		// Lamps that are switched on start at the minimum level
+		if (current == 0 && (dev->flags & DALISTATE_MIN)) {
+			current = dev->min_level;
+		}
+	}
+	// If the level before the fade isn't known, we can only report the target
+	dev->start_level = current < 0 ? level : (uint8_t) current;
+	dev->level = level;
+	dev->fade_start = now;
+	dev->fade_duration = duration;
+	dev->flags |= DALISTATE_LEVEL;
+}
+
+static void dalistate_apply(DaliStatePtr state, unsigned int device, uint8_t command, int arc, unsigned long now) {
+	DaliDeviceState *dev = &state->devices[device];
+	if (arc) {
+		// Mask, the level stays unchanged
+		if (command == 0xff) {
+			return;
+		}
+		uint8_t level = command;
+		if (level > 0) {
+			if ((dev->flags & DALISTATE_MIN) && level < dev->min_level) {
+				level = dev->min_level;
+			}
+			if ((dev->flags & DALISTATE_MAX) && level > dev->max_level) {
+				level = dev->max_level;
+			}
+		}
+		// Direct arc power uses the fade time, an unknown fade time is treated like no fade
+		dalistate_fade(dev, level, (dev->flags & DALISTATE_FADE) ? DALISTATE_FADE_TIMES[dev->fade >> 4] : 0, now);
+	} else if (command == 0x00) {
+		// Off
+		dalistate_fade(dev, 0, 0, now);
+	} else if ((command == 0x01 || command == 0x02) && (dev->flags & DALISTATE_FADE) && (dev->flags & (DALISTATE_MIN | DALISTATE_MAX)) == (DALISTATE_MIN | DALISTATE_MAX) && dalistate_estimate_device(dev, now, NULL) > 0) {
+		// Up and down for 200 msec at the fade rate, they never switch the lamp on or off
+		int level = dalistate_estimate_device(dev, now, NULL);
+		int steps = DALISTATE_FADE_RATES[dev->fade & 0x0f] * DALISTATE_STEP_TIME / 1000;
+		level += command == 0x01 ? steps : -steps;
+		if (level > dev->max_level) {
+			level = dev->max_level;
+		}
+		if (level < dev->min_level) {
+			level = dev->min_level;
+		}
+		dalistate_fade(dev, (uint8_t) level, DALISTATE_STEP_TIME, now);
+	} else if (command == 0x05 && (dev->flags & DALISTATE_MAX)) {
+		// Recall max level
+		dalistate_fade(dev, dev->max_level, 0, now);
+	} else if (command == 0x06 && (dev->flags & DALISTATE_MIN)) {
+		// Recall min level
+		dalistate_fade(dev, dev->min_level, 0, now);
+	} else if (command <= 0x08 || (command >= 0x10 && command <= 0x1f)) {
+		// Dimming steps and scenes, the result depends on values we don't know
+		dev->flags &= ~DALISTATE_LEVEL;
+	} else if (command == 0x20) {
+		// Reset, the device goes to its default settings
+		dalistate_fade(dev, 0xfe, 0, now);
+		dev->fade = 0x07;
+		dev->flags = (dev->flags | DALISTATE_FADE) & ~(DALISTATE_MIN | DALISTATE_MAX | DALISTATE_STATUS);
+		dalistate_set_groups(state, device, 0);
+		dev->flags |= DALISTATE_GROUPS_KNOWN;
+	} else if (command == 0x21) {
+		// Store actual level in DTR, every device has its own value now
+		state->dtr_known = 0;
+	} else if (command == 0x2a || command == 0x2b) {
+		// Store DTR as max or min level, the device clamps the level to the new limit
+		if (state->dtr_known) {
+			if (command == 0x2a) {
+				dev->max_level = state->dtr;
+				dev->flags |= DALISTATE_MAX;
+			} else {
+				dev->min_level = state->dtr;
+				dev->flags |= DALISTATE_MIN;
+			}
+		} else {
+			dev->flags &= ~(command == 0x2a ? DALISTATE_MAX : DALISTATE_MIN);
+		}
+		dev->flags &= ~DALISTATE_LEVEL;
+	} else if (command == 0x2e) {
+		// Store DTR as fade time
+		if (state->dtr_known && (dev->flags & DALISTATE_FADE)) {
+			dev->fade = (uint8_t) ((state->dtr > 15 ? 15 : state->dtr) << 4) | (dev->fade & 0x0f);
+		} else {
+			dev->flags &= ~DALISTATE_FADE;
+		}
+	} else if (command == 0x2f) {
+		// Store DTR as fade rate
+		if (state->dtr_known && (dev->flags & DALISTATE_FADE)) {
+			uint8_t rate = state->dtr > 15 ? 15 : (state->dtr == 0 ? 1 : state->dtr);
+			dev->fade = (dev->fade & 0xf0) | rate;
+		} else {
+			dev->flags &= ~DALISTATE_FADE;
+		}
+	} else if (command >= 0x60 && command <= 0x6f) {
+		dalistate_set_groups(state, device, dev->groups | (1 << (command & 0x0f)));
+	} else if (command >= 0x70 && command <= 0x7f) {
+		dalistate_set_groups(state, device, dev->groups & ~(1 << (command & 0x0f)));
+	} else if (command == 0x80) {
+		// Store DTR as short address, whatever we knew belongs to another address now
+		dalistate_set_groups(state, device, 0);
+		memset(dev, 0, sizeof(DaliDeviceState));
+	}
+	if ((dev->flags & DALISTATE_LEVEL) && (dev->flags & DALISTATE_STATUS)) {
+		if (dev->level > 0) {
+			dev->status |= DALISTATE_STATUS_LAMP_ON;
+		} else {
+			dev->status &= ~DALISTATE_STATUS_LAMP_ON;
+		}
+	}
+}
+
+static int dalistate_touch(DaliDeviceState *device, const DaliDeviceState *old, unsigned long now) {
+	if (device->flags != old->flags || device->level != old->level || device->status != old->status || device->min_level != old->min_level || device->max_level != old->max_level || device->groups != old->groups || device->fade != old->fade) {
+		device->changed = now;
+		return 1;
+	}
+	return 0;
+}
+
+unsigned int dalistate_command(DaliStatePtr state, DaliFramePtr frame, unsigned long now) {
+	unsigned int changed = 0;
+	if (state && frame && frame->ecommand == 0) {
+		DaliFrameClass cls = daliframe_classify(frame);
+		if (cls == DALIFRAME_CLASS_SPECIAL && frame->address == 0xa3) {
+			state->dtr = frame->command;
+			state->dtr_known = 1;
+		}
+		if (cls == DALIFRAME_CLASS_SPECIAL && frame->address == 0xb7 && (frame->command & 0x81) == 0x01) {
+			// Program short address, a selected device has taken over this address
+			DaliDeviceState *dev = &state->devices[frame->command >> 1];
+			DaliDeviceState old = *dev;
+			dalistate_set_groups(state, frame->command >> 1, 0);
+			memset(dev, 0, sizeof(DaliDeviceState));
+			changed += dalistate_touch(dev, &old, now);
+		}
+		if (cls == DALIFRAME_CLASS_ARC || cls == DALIFRAME_CLASS_COMMAND || cls == DALIFRAME_CLASS_CONFIG) {
+			uint64_t unknown;
+			uint64_t targets = dalistate_targets(state, frame->address, &unknown);
+			unsigned int device;
+			for (device = 0; device < DALISTATE_DEVICES; device++) {
+				DaliDeviceState old = state->devices[device];
+				if (targets & ((uint64_t) 1 << device)) {
+					dalistate_apply(state, device, frame->command, cls == DALIFRAME_CLASS_ARC, now);
+				} else if (unknown & ((uint64_t) 1 << device)) {
+					// It may or may not have been addressed
+					state->devices[device].flags &= ~DALISTATE_LEVEL;
+				}
+				changed += dalistate_touch(&state->devices[device], &old, now);
+			}
+		}
+	}
+	return changed;
+}
+
+int dalistate_response(DaliStatePtr state, DaliFramePtr frame, int response, unsigned long now) {
+	// Only answers from single devices can be attributed
+	if (!state || !frame || frame->ecommand != 0 || (frame->address & 0x81) != 0x01) {
+		return 0;
+	}
+	unsigned int device = frame->address >> 1;
+	DaliDeviceState *dev = &state->devices[device];
+	DaliDeviceState old = *dev;
+	if (response < 0) {
+		if (frame->command == 0x91) {
+			// Query control gear
+			dev->flags = (dev->flags | DALISTATE_ABSENT) & ~DALISTATE_PRESENT;
+			dev->checked = now;
+		}
+	} else {
+		dev->flags = (dev->flags | DALISTATE_PRESENT) & ~DALISTATE_ABSENT;
+		dev->checked = now;
+		switch (frame->command) {
+		case 0x90:
+			dev->status = (uint8_t) response;
+			dev->flags |= DALISTATE_STATUS;
+			if (!(dev->status & DALISTATE_STATUS_LAMP_ON)) {
+				dalistate_fade(dev, 0, 0, now);
+			}
+			break;
+		case 0xa0:
+			// Mask is returned while the level is undefined
+			if (response == 0xff) {
+				dev->flags &= ~DALISTATE_LEVEL;
+			} else {
+				// The lamp may still be fading, but we can't tell where to
+				dalistate_fade(dev, (uint8_t) response, 0, now);
+			}
+			break;
+		case 0xa5:
+			dev->fade = (uint8_t) response;
+			dev->flags |= DALISTATE_FADE;
+			break;
+		case 0xa1:
+			dev->max_level = (uint8_t) response;
+			dev->flags |= DALISTATE_MAX;
+			break;
+		case 0xa2:
+			dev->min_level = (uint8_t) response;
+			dev->flags |= DALISTATE_MIN;
+			break;
+		case 0xc0:
+			dalistate_set_groups(state, device, (dev->groups & 0xff00) | (uint8_t) response);
+			break;
+		case 0xc1:
+			dalistate_set_groups(state, device, (dev->groups & 0x00ff) | ((uint8_t) response << 8));
+			// Only complete once both halves were seen, the low half is usually queried first
+			dev->flags |= DALISTATE_GROUPS_KNOWN;
+			break;
+		}
+	}
+	return dalistate_touch(dev, &old, now);
+}
+
+static int dalistate_estimate_device(const DaliDeviceState *dev, unsigned long now, int *fading) {
+	if (fading) {
+		*fading = 0;
+	}
+	if (!(dev->flags & DALISTATE_LEVEL)) {
+		return -1;
+	}
+	if (now >= dev->fade_start + dev->fade_duration) {
+		return dev->level;
+	}
+	if (fading) {
+		*fading = 1;
+	}
+	// Fades are linear in arc power steps
+	long delta = (long) dev->level - (long) dev->start_level;
+	return dev->start_level + (int) (delta * (long) (now - dev->fade_start) / (long) dev->fade_duration);
+}
+
+int dalistate_estimate(DaliStatePtr state, unsigned int device, unsigned long now, int *fading) {
+	if (state && device < DALISTATE_DEVICES) {
+		return dalistate_estimate_device(&state->devices[device], now, fading);
+	}
+	if (fading) {
+		*fading = 0;
+	}
+	return -1;
+}
+
+unsigned int dalistate_fade_time(uint8_t fade_time) {
+	return DALISTATE_FADE_TIMES[fade_time & 0x0f];
+}
+
+unsigned int dalistate_fade_rate(uint8_t fade_rate) {
+	return DALISTATE_FADE_RATES[fade_rate & 0x0f];
+}
+
+int dalistate_absent(DaliStatePtr state, unsigned int device, unsigned long now, unsigned long ttl) {
+	if (state && device < DALISTATE_DEVICES) {
+		const DaliDeviceState *dev = &state->devices[device];
+		return (dev->flags & DALISTATE_ABSENT) && now < dev->checked + ttl;
+	}
+	return 0;
+}
+
+uint64_t dalistate_inventory(DaliStatePtr state, uint8_t flag) {
+	uint64_t devices = 0;
+	if (state) {
+		unsigned int device;
+		for (device = 0; device < DALISTATE_DEVICES; device++) {
+			if (state->devices[device].flags & flag) {
+				devices |= (uint64_t) 1 << device;
+			}
+		}
+	}
+	return devices;
+}
+
+int dalistate_save_inventory(DaliStatePtr state, const char *path) {
+	if (!state || !path) {
+		errno = EINVAL;
+		return 0;
+	}
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		return 0;
+	}
+	// One line per device that was seen or missed
+	unsigned int device;
+	for (device = 0; device < DALISTATE_DEVICES; device++) {
+		uint8_t flags = state->devices[device].flags;
+		if (flags & (DALISTATE_PRESENT | DALISTATE_ABSENT)) {
+			fprintf(file, "%u %s\n", device, (flags & DALISTATE_PRESENT) ? "present" : "absent");
+		}
+	}
+	int error = ferror(file);
+	if (fclose(file) != 0 || error) {
+		return 0;
+	}
+	return 1;
+}
+
+int dalistate_load_inventory(DaliStatePtr state, const char *path, unsigned long now) {
+	if (!state || !path) {
+		errno = EINVAL;
+		return 0;
+	}
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		return 0;
+	}
+	unsigned int device;
+	char presence[16];
+	while (fscanf(file, "%u %15s", &device, presence) == 2) {
+		if (device < DALISTATE_DEVICES) {
+			DaliDeviceState *dev = &state->devices[device];
+			if (strcmp(presence, "present") == 0) {
+				dev->flags = (dev->flags | DALISTATE_PRESENT) & ~DALISTATE_ABSENT;
+				dev->checked = now;
+			} else if (strcmp(presence, "absent") == 0) {
+				dev->flags = (dev->flags | DALISTATE_ABSENT) & ~DALISTATE_PRESENT;
+				dev->checked = now;
+			}
+		}
+	}
+	fclose(file);
+	return 1;
+}
+
+size_t dalistate_pack(DaliStatePtr state, char *buffer, size_t size) {
+	if (state && buffer && size >= DALISTATE_PACKED_SIZE) {
+		unsigned int i, j;
+		char *ptr = buffer;
+		for (i = 0; i < DALISTATE_DEVICES; i++) {
+			*ptr++ = state->devices[i].flags;
+			*ptr++ = state->devices[i].level;
+			*ptr++ = state->devices[i].status;
+			*ptr++ = (uint8_t) (state->devices[i].groups >> 8);
+			*ptr++ = (uint8_t) state->devices[i].groups;
+		}
+		for (i = 0; i < DALISTATE_GROUPS; i++) {
+			for (j = 0; j < 8; j++) {
+				*ptr++ = (uint8_t) (state->members[i] >> (56 - j * 8));
+			}
+		}
+	}
+	return DALISTATE_PACKED_SIZE;
+}
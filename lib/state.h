@@ -0,0 +1,126 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _STATE_H
+#define _STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame.h"
+
+// Number of short addresses and groups on a bus
+#define DALISTATE_DEVICES 64
+#define DALISTATE_GROUPS 16
+
+// The device answered a query
+#define DALISTATE_PRESENT 0x01
+// level is known
+#define DALISTATE_LEVEL 0x02
+// status is known
+#define DALISTATE_STATUS 0x04
+// groups is known
+#define DALISTATE_GROUPS_KNOWN 0x08
+// min_level and max_level are known
+#define DALISTATE_MIN 0x10
+#define DALISTATE_MAX 0x20
+// The device did not answer QUERY CONTROL GEAR
+#define DALISTATE_ABSENT 0x40
+// fade is known
+#define DALISTATE_FADE 0x80
+
+// Bits of the status byte
+#define DALISTATE_STATUS_GEAR_FAILURE 0x01
+#define DALISTATE_STATUS_LAMP_FAILURE 0x02
+#define DALISTATE_STATUS_LAMP_ON 0x04
+
+// Size of the table written by dalistate_pack
+// 5 bytes per device (flags, level, status, groups) and 8 bytes per group (member bitmap)
+#define DALISTATE_PACKED_SIZE (DALISTATE_DEVICES * 5 + DALISTATE_GROUPS * 8)
+
+typedef struct {
+	// DALISTATE_ flags
+	uint8_t flags;
+	// Arc power level, 0 = off
+	uint8_t level;
+	// Last reported status byte
+	uint8_t status;
+	uint8_t min_level;
+	uint8_t max_level;
+	// Fade time (high nibble) and fade rate (low nibble), as returned by QUERY FADE TIME/FADE RATE
+	uint8_t fade;
+	// Level at the start of the current fade, level is the target
+	uint8_t start_level;
+	// Group membership, bit n = group n
+	uint16_t groups;
+	// Time of the last change in msec
+	unsigned long changed;
+	// Start time and duration of the current fade in msec
+	unsigned long fade_start;
+	unsigned int fade_duration;
+	// Time when DALISTATE_PRESENT or DALISTATE_ABSENT was last confirmed in msec
+	unsigned long checked;
+} DaliDeviceState;
+
+struct DaliState;
+typedef struct DaliState *DaliStatePtr;
+
+// Creates a state table where nothing is known yet
+DaliStatePtr dalistate_new();
+// Destroys the table
+void dalistate_free(DaliStatePtr state);
+// Returns the state of the device with the given short address (0-63), NULL if it's out of range
+const DaliDeviceState *dalistate_device(DaliStatePtr state, unsigned int device);
+// Returns the devices that are known members of a group, bit n = short address n
+uint64_t dalistate_members(DaliStatePtr state, unsigned int group);
+// Updates the table with a command that was sent on the bus
+// Queries are ignored. Returns the number of devices whose state changed
+unsigned int dalistate_command(DaliStatePtr state, DaliFramePtr frame, unsigned long now);
+// Updates the table with the answer to a query, response is -1 if there was no answer
+// Returns 1 if the state changed, 0 otherwise
+int dalistate_response(DaliStatePtr state, DaliFramePtr frame, int response, unsigned long now);
+// Estimates the current level of a device, taking running fades into account
+// Returns the level, or -1 if it's not known. fading is set to 1 while a fade is running,
+// it may be NULL
+int dalistate_estimate(DaliStatePtr state, unsigned int device, unsigned long now, int *fading);
+// Returns the duration of a fade in msec for a fade time (0-15)
+unsigned int dalistate_fade_time(uint8_t fade_time);
+// Returns the fade rate in steps per second for a fade rate (1-15)
+unsigned int dalistate_fade_rate(uint8_t fade_rate);
+// Returns 1 if the device did not answer QUERY CONTROL GEAR within the last ttl msec
+int dalistate_absent(DaliStatePtr state, unsigned int device, unsigned long now, unsigned long ttl);
+// Returns the devices that are known to be present (DALISTATE_PRESENT) or absent (DALISTATE_ABSENT)
+// bit n = short address n
+uint64_t dalistate_inventory(DaliStatePtr state, uint8_t flag);
+// Saves the present and absent devices into a file
+// Returns 0 on failure and sets errno
+int dalistate_save_inventory(DaliStatePtr state, const char *path);
+// Restores the present and absent devices from a file, they count as confirmed at now
+// Returns 0 on failure and sets errno
+int dalistate_load_inventory(DaliStatePtr state, const char *path, unsigned long now);
+// Writes the whole table into buffer, in network byte order
+// Returns the number of bytes needed, nothing is written if that is larger than size
+size_t dalistate_pack(DaliStatePtr state, char *buffer, size_t size);
+
+#endif /*_STATE_H*/
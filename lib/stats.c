@@ -0,0 +1,127 @@
+/* Copyright (c) 2026, onitake <onitake@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "list.h"
+
+typedef struct {
+	char *name;
+	unsigned long value;
+} StatsCounter;
+
+static ListPtr counters = NULL;
+
+static StatsCounter *stats_find(const char *name, int create);
+static int stats_name_equal(void *data, void *arg);
+static void stats_counter_free(StatsCounter *counter);
+
+static int stats_name_equal(void *data, void *arg) {
+	return strcmp(((StatsCounter *) data)->name, (const char *) arg) == 0;
+}
+
+static void stats_counter_free(StatsCounter *counter) {
+	if (counter) {
+		free(counter->name);
+		free(counter);
+	}
+}
+
+static StatsCounter *stats_find(const char *name, int create) {
+	if (!name) {
+		return NULL;
+	}
+	if (!counters) {
+		if (!create) {
+			return NULL;
+		}
+		counters = list_new((ListDataFreeFunc) stats_counter_free);
+		if (!counters) {
+			return NULL;
+		}
+	}
+	StatsCounter *counter = list_data(list_find(counters, stats_name_equal, (void *) name));
+	if (!counter && create) {
+		counter = malloc(sizeof(StatsCounter));
+		if (counter) {
+			counter->name = strdup(name);
+			counter->value = 0;
+			if (!counter->name) {
+				free(counter);
+				return NULL;
+			}
+			list_enqueue(counters, counter);
+		}
+	}
+	return counter;
+}
+
+void stats_add(const char *name, unsigned long delta) {
+	StatsCounter *counter = stats_find(name, 1);
+	if (counter) {
+		counter->value += delta;
+	}
+}
+
+void stats_set(const char *name, unsigned long value) {
+	StatsCounter *counter = stats_find(name, 1);
+	if (counter) {
+		counter->value = value;
+	}
+}
+
+unsigned long stats_get(const char *name) {
+	StatsCounter *counter = stats_find(name, 0);
+	if (counter) {
+		return counter->value;
+	}
+	return 0;
+}
+
+size_t stats_dump(char *buffer, size_t size) {
+	size_t length = 0;
+	ListNodePtr node;
+	for (node = list_first(counters); node; node = list_next(node)) {
+		StatsCounter *counter = list_data(node);
+		char *out = NULL;
+		size_t left = 0;
+		if (buffer && length < size) {
+			out = buffer + length;
+			left = size - length;
+		}
+		int written = snprintf(out, left, "%s %lu\n", counter->name, counter->value);
+		if (written > 0) {
+			length += (size_t) written;
+		}
+	}
+	return length;
+}
+
+void stats_clear() {
+	list_free(counters);
+	counters = NULL;
+}
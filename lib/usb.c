@@ -28,18 +28,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include "usb.h"
-#include "list.h"
+#include "queue.h"
 #include "pack.h"
 #include "array.h"
 #include "log.h"
 #include "util.h"
-
-typedef struct {
-	unsigned int seq_num;
-	DaliFramePtr request;
-	void *arg;
-} UsbDaliTransaction;
+#include "stats.h"
+#include "latency.h"
 
 struct UsbDali {
 	libusb_context *context;
@@ -48,13 +45,33 @@ struct UsbDali {
 	libusb_device_handle *handle;
 	unsigned char endpoint_in;
 	unsigned char endpoint_out;
+	// Receive timeout while no transaction is active, and upper limit for transfers
 	unsigned int cmd_timeout;
 	unsigned int handle_timeout;
+	// Transfer times of ordinary and slow frames, they determine the transfer timeouts
+	DaliLatencyPtr latency;
+	DaliLatencyPtr slow_latency;
+	// Time when the active transaction was sent
+	unsigned long sent;
+	// Retries that may still be made, in 1/RETRY_BUDGET_RATIO, every successful transfer earns one
+	unsigned int retry_budget;
 	struct libusb_transfer *recv_transfer;
 	struct libusb_transfer *send_transfer;
-	UsbDaliTransaction *transaction;
+	DaliTransactionPtr transaction;
+	// Transaction whose callbacks are currently being called
+	DaliTransactionPtr completing;
 	unsigned int queue_size;
-	ListPtr queue;
+	DaliQueuePtr queue;
+	// Queue length hysteresis
+	unsigned int queue_low;
+	unsigned int queue_high;
+	int queue_full;
+	UsbDaliQueueCallback queue_callback;
+	void *queue_arg;
+	// Command classes that are dropped on cancel
+	unsigned int cancel_classes;
+	// How long commands to single devices wait for others to merge with, 0 = not at all
+	unsigned int group_window;
 	// Start value is 1 it seems
 	unsigned int seq_num;
 	UsbDaliInBandCallback req_callback;
@@ -147,11 +164,27 @@ const int CONFIGURATION_VALUE = 1;
 const size_t USBDALI_LENGTH = 64;
 const unsigned int DEFAULT_HANDLER_TIMEOUT = 100; //msec
 const unsigned int DEFAULT_COMMAND_TIMEOUT = 1000; //msec
+const unsigned int MIN_COMMAND_TIMEOUT = 100; //msec
+// Configuration commands and 24bit frames
+const unsigned int MIN_SLOW_TIMEOUT = 500; //msec
+const unsigned int MAX_SLOW_TIMEOUT = 2000; //msec
 const unsigned int DEFAULT_QUEUESIZE = 255; //max. queued commands
+const unsigned int DEFAULT_OWNERSIZE = 64; //max. queued commands per client
 const unsigned int MAX_LIBUSB_TIMEOUT = 1000; //sec
+// How often a frame is sent again after a timeout or transfer error, by frame class.
+// Only frames that do the same when they arrive twice (DALIFRAME_FLAG_REPEATABLE) are retried.
+const unsigned int RETRY_LIMITS[DALIFRAME_CLASSES] = {
+	[DALIFRAME_CLASS_ARC] = 2,
+	[DALIFRAME_CLASS_COMMAND] = 2,
+	[DALIFRAME_CLASS_CONFIG] = 0,
+	[DALIFRAME_CLASS_QUERY] = 2,
+	// DTR, search address, compare etc., not initialise and randomise
+	[DALIFRAME_CLASS_SPECIAL] = 2,
+};
+const unsigned int RETRY_BACKOFF = 50; //msec, doubled with every retry
+const unsigned int RETRY_BUDGET = 10; //max. retries in a row
+const unsigned int RETRY_BUDGET_RATIO = 10; //successful transfers per retry
 
-static UsbDaliTransaction *usbdali_transaction_new(DaliFramePtr request, void *arg);
-static void usbdali_transaction_free(UsbDaliTransaction *transaction);
 static void usbdali_print_in(uint8_t *buffer, size_t buflen);
 static void usbdali_print_out(uint8_t *buffer, size_t buflen);
 static void usbdali_dispatch_ready(void *arg);
@@ -159,10 +192,18 @@ static void usbdali_dispatch_error(void *arg, DispatchError err);
 static void usbdali_add_pollfd(int fd, short events, void *user_data);
 static void usbdali_remove_pollfd(int fd, void *user_data);
 static void usbdali_next(UsbDaliPtr dali);
+static void usbdali_check_queue(UsbDaliPtr dali);
+static void usbdali_expire(UsbDaliPtr dali);
+static void usbdali_complete(UsbDaliPtr dali, DaliTransactionPtr transaction, UsbDaliError err, DaliFramePtr frame, unsigned int response, unsigned int status);
+static DaliLatencyPtr usbdali_latency(UsbDaliPtr dali, DaliTransactionPtr transaction);
+static unsigned int usbdali_transfer_timeout(UsbDaliPtr dali, DaliTransactionPtr transaction);
+static void usbdali_record(UsbDaliPtr dali, int expired);
+static unsigned int usbdali_retry_limit(DaliFramePtr frame);
+static int usbdali_retry(UsbDaliPtr dali, enum libusb_transfer_status status);
 static void usbdali_receive_callback(struct libusb_transfer *transfer);
 static int usbdali_receive(UsbDaliPtr dali);
 static void usbdali_send_callback(struct libusb_transfer *transfer);
-static int usbdali_send(UsbDaliPtr dali, UsbDaliTransaction *transaction);
+static int usbdali_send(UsbDaliPtr dali, DaliTransactionPtr transaction);
 static libusb_device_handle *usbdali_find_device(libusb_context *context, int busnum, int devum);
 
 const char *libusb_error_string(int error) {
@@ -241,6 +282,8 @@ const char *usbdali_error_string(UsbDaliError error) {
 			return "No memory";
 		case USBDALI_SYSTEM_ERROR:
 			return "System error";
+		case USBDALI_EXPIRED:
+			return "Deadline expired";
 		default:
 			return "";
 	}
@@ -492,11 +535,23 @@ UsbDaliPtr usbdali_open(libusb_context *context, DispatchPtr dispatch, int busnu
 												dali->endpoint_out = endpoint_out;
 												dali->cmd_timeout = DEFAULT_COMMAND_TIMEOUT;
 												dali->handle_timeout = DEFAULT_HANDLER_TIMEOUT;
+												dali->latency = dalilatency_new(MIN_COMMAND_TIMEOUT, DEFAULT_COMMAND_TIMEOUT);
+												dali->slow_latency = dalilatency_new(MIN_SLOW_TIMEOUT, MAX_SLOW_TIMEOUT);
+												dali->sent = 0;
 												dali->recv_transfer = NULL;
 												dali->send_transfer = NULL;
 												dali->transaction = NULL;
+												dali->completing = NULL;
 												dali->queue_size = DEFAULT_QUEUESIZE;
-												dali->queue = list_new((ListDataFreeFunc) usbdali_transaction_free);
+												dali->queue = daliqueue_new();
+												dali->queue_low = 0;
+												dali->queue_high = 0;
+												dali->queue_full = 0;
+												dali->queue_callback = NULL;
+												dali->queue_arg = NULL;
+												dali->cancel_classes = 1 << DALIFRAME_CLASS_QUERY;
+												dali->retry_budget = RETRY_BUDGET * RETRY_BUDGET_RATIO;
+												dali->group_window = 0;
 												dali->seq_num = 1;
 												dali->bcast_callback = NULL;
 												dali->req_callback = NULL;
@@ -578,9 +633,11 @@ void usbdali_close(UsbDaliPtr dali) {
 	if (dali) {
 		dali->shutdown = 1;
 
-		list_free(dali->queue);
+		daliqueue_free(dali->queue);
+		dalilatency_free(dali->latency);
+		dalilatency_free(dali->slow_latency);
 		
-		usbdali_transaction_free(dali->transaction);
+		dalitransaction_free(dali->transaction);
 		if (dali->recv_transfer) {
 			libusb_cancel_transfer(dali->recv_transfer);
 		}
@@ -620,12 +677,25 @@ static void usbdali_next(UsbDaliPtr dali) {
 				usbdali_receive(dali);
 			}
 		} else {
-			if (list_length(dali->queue) > 0) {
+			unsigned long cost = 0;
+			size_t saved = daliqueue_unhold(dali->queue, monotonic_msec(), &cost);
+			if (saved > 0) {
+				log_info("Merged %lu held transfers into group transfers", saved);
+				stats_add("usb.grouped", saved);
+				stats_add("usb.saved", cost);
+			}
+			if (daliqueue_length(dali->queue) > daliqueue_length_held(dali->queue)) {
 				if (dali->recv_transfer) {
 					log_debug("Not sending, no transaction active, queue not empty, receiving, canceling receive");
 					libusb_cancel_transfer(dali->recv_transfer);
 				} else {
-					UsbDaliTransaction *transaction = list_dequeue(dali->queue);
+					usbdali_expire(dali);
+					if (dali->send_transfer || dali->transaction || dali->recv_transfer) {
+						// The callback of an expired transaction has queued a frame and started the next transfer
+						return;
+					}
+					DaliTransactionPtr transaction = daliqueue_pop(dali->queue);
+					usbdali_check_queue(dali);
 					if (transaction) {
 						log_debug("Not sending, no transaction active, queue not empty, not receiving, starting send");
 						usbdali_send(dali, transaction);
@@ -690,19 +760,13 @@ static void usbdali_receive_callback(struct libusb_transfer *transfer) {
 								switch (in.type) {
 								case USBDALI_TYPE_NO_RESPONSE: {
 									log_debug("Transfer completed without response");
-									DaliFramePtr frame = daliframe_new(in.address, in.command);
-									dali->req_callback(USBDALI_SUCCESS, frame, 0xff, in.status, dali->transaction->arg);
-									daliframe_free(frame);
-									usbdali_transaction_free(dali->transaction);
-									dali->transaction = NULL;
+									usbdali_record(dali, 0);
+									usbdali_complete(dali, dali->transaction, USBDALI_SUCCESS, dali->transaction->request, 0xff, in.status);
 								} break;
 								case USBDALI_TYPE_RESPONSE: {
 									log_debug("Transfer completed with status 0x%02x", in.command);
-									DaliFramePtr frame = daliframe_new(in.address, in.command);
-									dali->req_callback(USBDALI_RESPONSE, frame, in.command, in.status, dali->transaction->arg);
-									daliframe_free(frame);
-									usbdali_transaction_free(dali->transaction);
-									dali->transaction = NULL;
+									usbdali_record(dali, 0);
+									usbdali_complete(dali, dali->transaction, USBDALI_RESPONSE, dali->transaction->request, in.command, in.status);
 								} break;
 								case USBDALI_TYPE_COMPLETE:
 									// Should check if send was successful here and send error to callback
@@ -725,9 +789,11 @@ static void usbdali_receive_callback(struct libusb_transfer *transfer) {
 		case LIBUSB_TRANSFER_TIMED_OUT:
 			if (dali) {
 				if (dali->transaction) {
-					dali->req_callback(USBDALI_RECEIVE_TIMEOUT, dali->transaction->request, 0xff, 0xffff, dali->transaction->arg);
-					usbdali_transaction_free(dali->transaction);
-					dali->transaction = NULL;
+					log_warn("No response from device within %u msec", usbdali_transfer_timeout(dali, dali->transaction));
+					usbdali_record(dali, 1);
+					if (!usbdali_retry(dali, transfer->status)) {
+						usbdali_complete(dali, dali->transaction, USBDALI_RECEIVE_TIMEOUT, dali->transaction->request, 0xff, 0xffff);
+					}
 				}
 				// Do nothing for out of band receives - a new one will be sent from the next handle call
 			}
@@ -742,9 +808,9 @@ static void usbdali_receive_callback(struct libusb_transfer *transfer) {
 			log_warn("Error receiving data from device (status=0x%x - %s):", transfer->status, libusb_status_string(transfer->status));
 			if (dali) {
 				if (dali->transaction) {
-					dali->req_callback(USBDALI_RECEIVE_ERROR, dali->transaction->request, 0xff, 0xffff, dali->transaction->arg);
-					usbdali_transaction_free(dali->transaction);
-					dali->transaction = NULL;
+					if (!usbdali_retry(dali, transfer->status)) {
+						usbdali_complete(dali, dali->transaction, USBDALI_RECEIVE_ERROR, dali->transaction->request, 0xff, 0xffff);
+					}
 				} else {
 					dali->bcast_callback(USBDALI_RECEIVE_ERROR, NULL, 0xffff, dali->bcast_arg);
 				}
@@ -774,7 +840,9 @@ static int usbdali_receive(UsbDaliPtr dali) {
 		
 		log_debug("Receiving data from device");
 		dali->recv_transfer = libusb_alloc_transfer(0);
-		libusb_fill_interrupt_transfer(dali->recv_transfer, dali->handle, dali->endpoint_in, buffer, USBDALI_LENGTH, usbdali_receive_callback, dali, dali->cmd_timeout);
+		// Only the response to a transaction is expected within a short time
+		unsigned int timeout = dali->transaction ? usbdali_transfer_timeout(dali, dali->transaction) : dali->cmd_timeout;
+		libusb_fill_interrupt_transfer(dali->recv_transfer, dali->handle, dali->endpoint_in, buffer, USBDALI_LENGTH, usbdali_receive_callback, dali, timeout);
 		return libusb_submit_transfer(dali->recv_transfer);
 	}
 	return -1;
@@ -792,9 +860,10 @@ static void usbdali_send_callback(struct libusb_transfer *transfer) {
 		case LIBUSB_TRANSFER_TIMED_OUT:
 			log_warn("Sending data to device timed out");
 			if (dali) {
-				dali->req_callback(USBDALI_SEND_TIMEOUT, dali->transaction->request, 0xff, 0xffff, dali->transaction->arg);
-				usbdali_transaction_free(dali->transaction);
-				dali->transaction = NULL;
+				usbdali_record(dali, 1);
+				if (!usbdali_retry(dali, transfer->status)) {
+					usbdali_complete(dali, dali->transaction, USBDALI_SEND_TIMEOUT, dali->transaction->request, 0xff, 0xffff);
+				}
 			}
 			break;
 		case LIBUSB_TRANSFER_CANCELLED:
@@ -805,10 +874,8 @@ static void usbdali_send_callback(struct libusb_transfer *transfer) {
 		case LIBUSB_TRANSFER_NO_DEVICE:
 		case LIBUSB_TRANSFER_OVERFLOW:
 			log_warn("Error sending data to device (status=0x%x - %s):", transfer->status, libusb_status_string(transfer->status));
-			if (dali) {
-				dali->req_callback(USBDALI_SEND_ERROR, dali->transaction->request, 0xff, 0xffff, dali->transaction->arg);
-				usbdali_transaction_free(dali->transaction);
-				dali->transaction = NULL;
+			if (dali && !usbdali_retry(dali, transfer->status)) {
+				usbdali_complete(dali, dali->transaction, USBDALI_SEND_ERROR, dali->transaction->request, 0xff, 0xffff);
 			}
 			break;
 	}
@@ -828,7 +895,7 @@ static void usbdali_send_callback(struct libusb_transfer *transfer) {
 	}
 }
 
-static int usbdali_send(UsbDaliPtr dali, UsbDaliTransaction *transaction) {
+static int usbdali_send(UsbDaliPtr dali, DaliTransactionPtr transaction) {
 	if (dali && transaction && !dali->send_transfer && !dali->transaction) {
 		unsigned char *buffer = malloc(USBDALI_LENGTH);
 		memset(buffer, 0, USBDALI_LENGTH);
@@ -853,6 +920,7 @@ static int usbdali_send(UsbDaliPtr dali, UsbDaliTransaction *transaction) {
 		}
 		dali->transaction = transaction;
 		dali->transaction->seq_num = dali->seq_num;
+		dali->sent = monotonic_msec();
 		if (dali->seq_num == 0xff) {
 			// TODO: See if this actually works or if 0 is reserved
 			dali->seq_num = 0;
@@ -860,67 +928,301 @@ static int usbdali_send(UsbDaliPtr dali, UsbDaliTransaction *transaction) {
 			dali->seq_num++;
 		}
 		dali->send_transfer = libusb_alloc_transfer(0);
-		libusb_fill_interrupt_transfer(dali->send_transfer, dali->handle, dali->endpoint_out, buffer, USBDALI_LENGTH, usbdali_send_callback, dali, dali->cmd_timeout);
+		libusb_fill_interrupt_transfer(dali->send_transfer, dali->handle, dali->endpoint_out, buffer, USBDALI_LENGTH, usbdali_send_callback, dali, usbdali_transfer_timeout(dali, transaction));
 		return libusb_submit_transfer(dali->send_transfer);
 	}
 	return -1;
 }
 
-UsbDaliError usbdali_queue(UsbDaliPtr dali, DaliFramePtr frame, void *cbarg) {
+static void usbdali_expire(UsbDaliPtr dali) {
+	DaliTransactionPtr transaction;
+	while ((transaction = daliqueue_expire(dali->queue, monotonic_msec()))) {
+		log_info("Transfer (%p,%p) expired before it could be sent", transaction->request, transaction->arg);
+		usbdali_complete(dali, transaction, USBDALI_EXPIRED, transaction->request, 0xff, 0xffff);
+	}
+}
+
+static void usbdali_complete(UsbDaliPtr dali, DaliTransactionPtr transaction, UsbDaliError err, DaliFramePtr frame, unsigned int response, unsigned int status) {
+	// Callbacks may cancel other waiters of the same transaction, so it stays reachable for usbdali_cancel
+	dali->completing = transaction;
+	if (dali->req_callback) {
+		dali->req_callback(err, frame, response, status, transaction->arg);
+		void *waiter;
+		while ((waiter = dalitransaction_next_waiter(transaction))) {
+			dali->req_callback(err, frame, response, status, waiter);
+		}
+	}
+	dali->completing = NULL;
+	if (dali->transaction == transaction) {
+		dali->transaction = NULL;
+		// The rest of a sequence can't be sent after a failed frame
+		daliqueue_finish(dali->queue, monotonic_msec(), err != USBDALI_SUCCESS && err != USBDALI_RESPONSE);
+	}
+	dalitransaction_free(transaction);
+}
+
+static DaliLatencyPtr usbdali_latency(UsbDaliPtr dali, DaliTransactionPtr transaction) {
+	DaliFramePtr frame = transaction->request;
+	// Some adapters take longer to confirm what is stored in non-volatile memory
+	if (frame->ecommand != 0 || (daliframe_flags(frame) & DALIFRAME_FLAG_STORED)) {
+		return dali->slow_latency;
+	}
+	return dali->latency;
+}
+
+static unsigned int usbdali_transfer_timeout(UsbDaliPtr dali, DaliTransactionPtr transaction) {
+	unsigned int timeout = dalilatency_timeout(usbdali_latency(dali, transaction));
+	if (timeout == 0) {
+		// No latency tracking, out of memory
+		return dali->cmd_timeout;
+	}
+	return timeout;
+}
+
+static void usbdali_record(UsbDaliPtr dali, int expired) {
+	if (dali->transaction) {
+		DaliLatencyPtr latency = usbdali_latency(dali, dali->transaction);
+		if (expired) {
+			dalilatency_expired(latency);
+			stats_add("usb.timeouts", 1);
+		} else {
+			dalilatency_add(latency, monotonic_msec() - dali->sent);
+			if (dali->retry_budget < RETRY_BUDGET * RETRY_BUDGET_RATIO) {
+				dali->retry_budget++;
+			}
+			if (dali->transaction->retries > 0) {
+				stats_add("usb.recovered", 1);
+			}
+		}
+		stats_set("usb.latency", dalilatency_percentile(dali->latency, 99));
+		stats_set("usb.timeout", dalilatency_timeout(dali->latency));
+	}
+}
+
+static unsigned int usbdali_retry_limit(DaliFramePtr frame) {
+	// Relative commands, configuration, extended frames etc. must arrive exactly once
+	if (!(daliframe_flags(frame) & DALIFRAME_FLAG_REPEATABLE)) {
+		return 0;
+	}
+	return RETRY_LIMITS[daliframe_classify(frame)];
+}
+
+static int usbdali_retry(UsbDaliPtr dali, enum libusb_transfer_status status) {
+	DaliTransactionPtr transaction = dali->transaction;
+	// Stalls, overflows and a missing device won't go away by trying again
+	if (!transaction || (status != LIBUSB_TRANSFER_TIMED_OUT && status != LIBUSB_TRANSFER_ERROR)) {
+		return 0;
+	}
+	// The rest of a sequence depends on the frames arriving exactly once and in order
+	if (transaction->in_sequence || transaction->retries >= usbdali_retry_limit(transaction->request)) {
+		return 0;
+	}
+	if (dali->retry_budget < RETRY_BUDGET_RATIO) {
+		log_warn("Too many failed transfers, not retrying (%p,%p)", transaction->request, transaction->arg);
+		stats_add("usb.retries.denied", 1);
+		return 0;
+	}
+	// Jitter keeps retries from lining up with periodic requests
+	unsigned long backoff = (unsigned long) RETRY_BACKOFF << transaction->retries;
+	backoff += (unsigned long) rand() % (backoff / 2 + 1);
+	if (!daliqueue_requeue(dali->queue, transaction, monotonic_msec() + backoff)) {
+		return 0;
+	}
+	log_info("Retrying transfer (%p,%p) in %lu msec", transaction->request, transaction->arg, backoff);
+	dali->retry_budget -= RETRY_BUDGET_RATIO;
+	dali->transaction = NULL;
+	stats_add("usb.retries", 1);
+	usbdali_check_queue(dali);
+	return 1;
+}
+
+UsbDaliError usbdali_queue(UsbDaliPtr dali, DaliFramePtr frame, DaliQueuePriority priority, unsigned int ttl, void *cbarg) {
+	return usbdali_queue_owner(dali, frame, priority, ttl, cbarg, cbarg);
+}
+
+UsbDaliError usbdali_queue_owner(UsbDaliPtr dali, DaliFramePtr frame, DaliQueuePriority priority, unsigned int ttl, void *owner, void *cbarg) {
 	if (dali) {
-		log_debug("dali=%p frame=%p arg=%p", dali, frame, cbarg);
-		if (list_length(dali->queue) < dali->queue_size) {
-			UsbDaliTransaction *transaction = usbdali_transaction_new(frame, cbarg);
-			if (transaction) {
-				list_enqueue(dali->queue, transaction);
-				log_info("Enqueued transfer (%p,%p)", transaction->request, transaction->arg);
+		log_debug("dali=%p frame=%p priority=%d owner=%p arg=%p", dali, frame, priority, owner, cbarg);
+		DaliTransactionPtr transaction = dalitransaction_new(frame, priority, cbarg);
+		if (!transaction) {
+			return USBDALI_NO_MEMORY;
+		}
+		transaction->owner = owner;
+		if (ttl > 0) {
+			transaction->deadline = monotonic_msec() + ttl;
+		}
+		if (dali->group_window > 0) {
+			transaction->hold = monotonic_msec() + dali->group_window;
+		}
+		DaliTransactionPtr merged = NULL;
+		if (dalitransaction_same_query(dali->transaction, frame)) {
+			// The same query is on the bus right now, share its response
+			if (dalitransaction_add_waiter(dali->transaction, cbarg)) {
+				merged = dali->transaction;
+			}
+		} else {
+			merged = daliqueue_coalesce(dali->queue, transaction);
+		}
+		if (merged) {
+			log_info("Merged transfer (%p,%p) into (%p,%p)", frame, cbarg, merged->request, merged->arg);
+			if (daliframe_classify(frame) == DALIFRAME_CLASS_QUERY) {
+				stats_add("usb.shared", 1);
+			} else {
+				stats_add("usb.coalesced", 1);
+			}
+			transaction->request = NULL;
+			daliframe_free(frame);
+			dalitransaction_free(transaction);
+			return USBDALI_SUCCESS;
+		}
+		if (daliqueue_length(dali->queue) < dali->queue_size && daliqueue_length_owner(dali->queue, owner) < DEFAULT_OWNERSIZE) {
+			if (daliqueue_push(dali->queue, transaction)) {
+				log_info("Enqueued transfer (%p,%p) with priority %d", transaction->request, transaction->arg, transaction->priority);
+				unsigned long cost = 0;
+				size_t saved = daliqueue_group(dali->queue, transaction, &cost);
+				if (saved > 0) {
+					log_info("Merged %lu transfers into group transfer (0x%02x 0x%02x)", saved + 1, transaction->request->address, transaction->request->command);
+					stats_add("usb.grouped", saved);
+					stats_add("usb.saved", cost);
+				}
+				usbdali_check_queue(dali);
 				usbdali_next(dali);
 				return USBDALI_SUCCESS;
 			}
+			// The frame belongs to the caller again
+			transaction->request = NULL;
+			dalitransaction_free(transaction);
+			return USBDALI_NO_MEMORY;
 		}
+		transaction->request = NULL;
+		dalitransaction_free(transaction);
 		return USBDALI_QUEUE_FULL;
 	}
 	return USBDALI_INVALID_ARG;
 }
 
-void usbdali_set_outband_callback(UsbDaliPtr dali, UsbDaliOutBandCallback callback, void *arg) {
+UsbDaliError usbdali_queue_sequence(UsbDaliPtr dali, DaliFramePtr *frames, size_t count, unsigned int gap, DaliQueuePriority priority, unsigned int ttl, void *cbarg) {
+	return usbdali_queue_sequence_owner(dali, frames, count, gap, priority, ttl, cbarg, cbarg);
+}
+
+UsbDaliError usbdali_queue_sequence_owner(UsbDaliPtr dali, DaliFramePtr *frames, size_t count, unsigned int gap, DaliQueuePriority priority, unsigned int ttl, void *owner, void *cbarg) {
+	if (dali && frames && count > 0) {
+		log_debug("dali=%p frames=%p count=%lu gap=%u priority=%d owner=%p arg=%p", dali, frames, count, gap, priority, owner, cbarg);
+		if (daliqueue_length(dali->queue) + count > dali->queue_size || daliqueue_length_owner(dali->queue, owner) >= DEFAULT_OWNERSIZE) {
+			return USBDALI_QUEUE_FULL;
+		}
+		DaliTransactionPtr transaction = NULL;
+		size_t i;
+		for (i = 0; i < count; i++) {
+			DaliTransactionPtr next = dalitransaction_new(frames[i], priority, cbarg);
+			if (!next) {
+				// The frames belong to the caller again
+				DaliTransactionPtr frame;
+				for (frame = transaction; frame; frame = frame->next) {
+					frame->request = NULL;
+				}
+				dalitransaction_free(transaction);
+				return USBDALI_NO_MEMORY;
+			}
+			if (transaction) {
+				dalitransaction_append(transaction, next, gap);
+			} else {
+				transaction = next;
+			}
+		}
+		// The whole sequence belongs to the owner of the first frame
+		transaction->owner = owner;
+		if (ttl > 0) {
+			transaction->deadline = monotonic_msec() + ttl;
+		}
+		if (daliqueue_push(dali->queue, transaction)) {
+			log_info("Enqueued sequence of %lu transfers (%p,%p) with priority %d", count, transaction->request, transaction->arg, transaction->priority);
+			usbdali_check_queue(dali);
+			usbdali_next(dali);
+			return USBDALI_SUCCESS;
+		}
+		DaliTransactionPtr frame;
+		for (frame = transaction; frame; frame = frame->next) {
+			frame->request = NULL;
+		}
+		dalitransaction_free(transaction);
+		return USBDALI_NO_MEMORY;
+	}
+	return USBDALI_INVALID_ARG;
+}
+
+size_t usbdali_get_queue_length(UsbDaliPtr dali) {
 	if (dali) {
-		dali->bcast_callback = callback;
-		dali->bcast_arg = arg;
+		return daliqueue_length(dali->queue);
 	}
+	return 0;
 }
 
-void usbdali_set_inband_callback(UsbDaliPtr dali, UsbDaliInBandCallback callback) {
+unsigned long usbdali_get_queue_wait(UsbDaliPtr dali) {
 	if (dali) {
-		dali->req_callback = callback;
+		unsigned long wait = daliqueue_cost(dali->queue);
+		if (dali->transaction) {
+			wait += dali->transaction->cost;
+		}
+		return wait;
 	}
+	return 0;
 }
 
-static UsbDaliTransaction *usbdali_transaction_new(DaliFramePtr request, void *arg) {
-	UsbDaliTransaction *transaction = malloc(sizeof(UsbDaliTransaction));
-	if (transaction) {
-		memset(transaction, 0, sizeof(UsbDaliTransaction));
-		transaction->request = request;
-		transaction->arg = arg;
+void usbdali_set_queue_callback(UsbDaliPtr dali, unsigned int low, unsigned int high, UsbDaliQueueCallback callback, void *arg) {
+	if (dali) {
+		dali->queue_low = low;
+		dali->queue_high = high;
+		dali->queue_callback = callback;
+		dali->queue_arg = arg;
+		usbdali_check_queue(dali);
 	}
-	return transaction;
 }
 
-static void usbdali_transaction_free(UsbDaliTransaction *transaction) {
-	if (transaction) {
-		daliframe_free(transaction->request);
-		free(transaction);
+static void usbdali_check_queue(UsbDaliPtr dali) {
+	if (dali->queue_callback && dali->queue_high > 0) {
+		size_t length = daliqueue_length(dali->queue);
+		if (!dali->queue_full && length >= dali->queue_high) {
+			log_info("Queue length %lu reached high water mark", length);
+			dali->queue_full = 1;
+			dali->queue_callback(1, dali->queue_arg);
+		} else if (dali->queue_full && length <= dali->queue_low) {
+			log_info("Queue length %lu dropped to low water mark", length);
+			dali->queue_full = 0;
+			dali->queue_callback(0, dali->queue_arg);
+		}
+	}
+}
+
+void usbdali_set_outband_callback(UsbDaliPtr dali, UsbDaliOutBandCallback callback, void *arg) {
+	if (dali) {
+		dali->bcast_callback = callback;
+		dali->bcast_arg = arg;
+	}
+}
+
+void usbdali_set_inband_callback(UsbDaliPtr dali, UsbDaliInBandCallback callback) {
+	if (dali) {
+		dali->req_callback = callback;
 	}
 }
 
 int usbdali_get_timeout(UsbDaliPtr dali) {
 	if (dali) {
 		struct timeval tv = { 0, 0 };
+		long hold = daliqueue_hold_wait(dali->queue, monotonic_msec());
 		if (libusb_get_next_timeout(dali->context, &tv) == 1) {
 			int tvms = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+			if (hold >= 0 && hold < tvms) {
+				tvms = (int) hold;
+			}
 			log_debug("Returning timeout %d", tvms);
 			return tvms;
 		}
+		if (hold >= 0) {
+			log_debug("Returning hold timeout %ld", hold);
+			return hold > INT_MAX ? INT_MAX : (int) hold;
+		}
 	}
 	log_debug("Returning timeout -1");
 	return -1;
@@ -928,15 +1230,37 @@ int usbdali_get_timeout(UsbDaliPtr dali) {
 
 void usbdali_cancel(UsbDaliPtr dali, void *arg) {
 	if (dali && arg) {
-		if (dali->transaction && dali->transaction->arg == arg) {
-			dali->transaction->arg = NULL;
-		}
-		ListNodePtr node;
-		for (node = list_first(dali->queue); node; node = list_next(node)) {
-			UsbDaliTransaction *transaction = (UsbDaliTransaction *) list_data(node);
-			if (transaction && transaction->arg == arg) {
-				transaction->arg = NULL;
-			}
+		dalitransaction_cancel(dali->transaction, arg);
+		dalitransaction_cancel(dali->completing, arg);
+		size_t removed = daliqueue_remove(dali->queue, arg, dali->cancel_classes);
+		if (removed > 0) {
+			log_info("Removed %lu cancelled transactions from the queue", removed);
+			usbdali_check_queue(dali);
 		}
+		daliqueue_cancel(dali->queue, arg);
+	}
+}
+
+void usbdali_set_cancel_classes(UsbDaliPtr dali, unsigned int classes) {
+	if (dali) {
+		dali->cancel_classes = classes;
+	}
+}
+
+void usbdali_set_grouping(UsbDaliPtr dali, unsigned int window) {
+	if (dali) {
+		dali->group_window = window;
+	}
+}
+
+void usbdali_set_groups(UsbDaliPtr dali, const uint64_t *groups, uint64_t devices) {
+	if (dali) {
+		daliqueue_set_groups(dali->queue, groups, devices);
+	}
+}
+
+void usbdali_release(UsbDaliPtr dali) {
+	if (dali && daliqueue_length_held(dali->queue) > 0 && daliqueue_hold_wait(dali->queue, monotonic_msec()) == 0) {
+		usbdali_next(dali);
 	}
 }
@@ -30,6 +30,7 @@
 #include <poll.h>
 #include <sys/types.h>
 #include "frame.h"
+#include "queue.h"
 #include "dispatch.h"
 
 struct UsbDali;
@@ -46,11 +47,13 @@ typedef enum {
 	USBDALI_INVALID_ARG = -6,
 	USBDALI_NO_MEMORY = -7,
 	USBDALI_SYSTEM_ERROR = -8,
+	USBDALI_EXPIRED = -9,
 } UsbDaliError;
 
 typedef void (*UsbDaliOutBandCallback)(UsbDaliError err, DaliFramePtr frame, unsigned int status, void *arg);
 typedef void (*UsbDaliInBandCallback)(UsbDaliError err, DaliFramePtr frame, unsigned int response, unsigned int status, void *arg);
 typedef void (*UsbDaliEventCallback)(int closed, void *arg);
+typedef void (*UsbDaliQueueCallback)(int full, void *arg);
 
 // Return a human-readable error description of the libusb error
 const char *libusb_error_string(int error);
@@ -66,23 +69,65 @@ UsbDaliPtr usbdali_open(libusb_context *context, DispatchPtr dispatch, int busnu
 // if it was created by usbdali_open.
 void usbdali_close(UsbDaliPtr dali);
 // Enqueue a Dali command
-// cbarg is the arg argument that will be passed to the inband callback
-UsbDaliError usbdali_queue(UsbDaliPtr dali, DaliFramePtr frame, void *cbarg);
+// The frame is put into the queue of the given priority class, higher classes are always sent first
+// cbarg is the arg argument that will be passed to the inband callback. It also identifies
+// the submitter: submitters share the bus fairly and each may only fill part of the queue.
+// Ownership of the frame is only taken over if USBDALI_SUCCESS is returned.
+// If ttl is not 0, the command is dropped if it could not be sent within ttl msec,
+// and the inband callback is called with USBDALI_EXPIRED.
+// Frames that may safely arrive twice are sent again after a timeout or transfer error,
+// the inband callback is only called with the final result.
+UsbDaliError usbdali_queue(UsbDaliPtr dali, DaliFramePtr frame, DaliQueuePriority priority, unsigned int ttl, void *cbarg);
+// Like usbdali_queue, but the frame counts against the share and queue limit of owner instead of cbarg
+// Use this when the callback argument is a helper acting for a submitter.
+UsbDaliError usbdali_queue_owner(UsbDaliPtr dali, DaliFramePtr frame, DaliQueuePriority priority, unsigned int ttl, void *owner, void *cbarg);
+// Enqueue an atomic sequence of count Dali commands, such as a DTR write and the
+// command that uses it, or a configuration command that must be sent twice.
+// The frames are sent back to back in the given order, no other frame is sent in between.
+// If gap is not 0, each frame must be sent within gap msec after the previous one has completed.
+// When a frame fails or misses its gap, the rest of the sequence is not sent,
+// the inband callback is called with USBDALI_EXPIRED for each remaining frame.
+// The inband callback is called once for every frame, ttl applies to the first frame.
+// Ownership of the frames is only taken over if USBDALI_SUCCESS is returned.
+UsbDaliError usbdali_queue_sequence(UsbDaliPtr dali, DaliFramePtr *frames, size_t count, unsigned int gap, DaliQueuePriority priority, unsigned int ttl, void *cbarg);
+// Like usbdali_queue_sequence, with a separate owner, see usbdali_queue_owner
+UsbDaliError usbdali_queue_sequence_owner(UsbDaliPtr dali, DaliFramePtr *frames, size_t count, unsigned int gap, DaliQueuePriority priority, unsigned int ttl, void *owner, void *cbarg);
 // Set the handler timeout (in msec, default 100)
 // 0 is supposed to mean 'forever', but this isn't implemented yet.
 void usbdali_set_handler_timeout(UsbDaliPtr dali, unsigned int timeout);
 // Set the maximum queue size (default and maximum 255)
 void usbdali_set_queue_size(UsbDaliPtr dali, unsigned int size);
+// Returns the number of queued commands
+size_t usbdali_get_queue_length(UsbDaliPtr dali);
+// Returns the estimated time in msec until all queued commands have been sent
+unsigned long usbdali_get_queue_wait(UsbDaliPtr dali);
+// Sets a callback that is called with full=1 when the queue length reaches high,
+// and with full=0 when it has dropped to low again
+void usbdali_set_queue_callback(UsbDaliPtr dali, unsigned int low, unsigned int high, UsbDaliQueueCallback callback, void *arg);
 // Sets the out of band message callback
 void usbdali_set_outband_callback(UsbDaliPtr dali, UsbDaliOutBandCallback callback, void *arg);
 // Sets the in band message callback
+// The callback receives the frame that was sent, the response is passed separately
 void usbdali_set_inband_callback(UsbDaliPtr dali, UsbDaliInBandCallback callback);
 // Returns the next timeout to use for polling in msecs, -1 if no timeout is active
+// This includes the end of the hold time of commands that wait for grouping.
 int usbdali_get_timeout(UsbDaliPtr dali);
+// Sends commands whose hold time has ended, call this after the timeout has passed
+void usbdali_release(UsbDaliPtr dali);
 // Sets the callback arguments of all active and queued transactions to NULL
 // if they are equal to arg.
-// Callbacks will still be called later, they should handle this gracefully.
+// Queued transactions of a cancellable class are removed instead.
+// Callbacks will still be called later for the others, they should handle this gracefully.
 void usbdali_cancel(UsbDaliPtr dali, void *arg);
+// Sets the classes of queued commands that are dropped by usbdali_cancel
+// classes is a bit mask of (1 << DaliFrameClass), the default is only queries
+void usbdali_set_cancel_classes(UsbDaliPtr dali, unsigned int classes);
+// Enables merging of identical commands to single devices into group or broadcast commands
+// Commands wait for up to window msec for the rest of the group, 0 disables grouping (default).
+// Those that are merged are answered when the group command has been sent.
+void usbdali_set_grouping(UsbDaliPtr dali, unsigned int window);
+// Sets the known group members and the devices reached by a broadcast, see daliqueue_set_groups
+void usbdali_set_groups(UsbDaliPtr dali, const uint64_t *groups, uint64_t devices);
 
 #endif /*_USB_H*/
 
@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <time.h>
 
 void hexdump(const uint8_t *data, size_t length) {
 	size_t line;
@@ -168,3 +169,10 @@ void daemonize(const char *pidfile) {
 	// Done
 }
 
+unsigned long monotonic_msec() {
+	struct timespec now;
+	if (clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+		return (unsigned long) now.tv_sec * 1000 + (unsigned long) now.tv_nsec / 1000000;
+	}
+	return 0;
+}
@@ -35,6 +35,9 @@ void hexdump(const uint8_t *data, size_t length);
 // stdin, stdout and stderr are rerouted to /dev/null, but all other descriptors
 // will be kept open. If pidfile is not NULL, write the daemon's PID into it.
 void daemonize(const char *pidfile);
+// Returns the value of a monotonic clock in msec
+// Only useful for measuring time differences
+unsigned long monotonic_msec();
 
 #endif /*_UTIL_H*/
 
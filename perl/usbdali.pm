@@ -95,6 +95,279 @@ sub send {
 	}
 }
 
+sub set_option {
+	my ($self, $option, $value) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't set option. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 1, $option, $value);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		return $self->receive();
+	}
+}
+
+sub set_priority {
+	my ($self, $class) = @_;
+	my %classes = ( interactive => 0, normal => 1, background => 2 );
+	return $self->set_option(0, $classes{$class} // $class);
+}
+
+sub get_stats {
+	my ($self) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't get statistics. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 2, 0, 0);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		if ($ret && $ret->{status} eq 'data') {
+			my %stats = map { split(' ', $_, 2) } split("\n", $ret->{data});
+			return \%stats;
+		}
+		return undef;
+	}
+}
+
+sub get_state {
+	my ($self) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't get device state. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 3, 0, 0);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		if ($ret && $ret->{status} eq 'data') {
+			my @values = unpack('(CCCn)64 (NN)16', $ret->{data});
+			my @devices = map { { flags => $values[$_ * 4], level => $values[$_ * 4 + 1], status => $values[$_ * 4 + 2], groups => $values[$_ * 4 + 3] } } 0..63;
+			my @groups = map { ($values[256 + $_ * 2] << 32) | $values[256 + $_ * 2 + 1] } 0..15;
+			return { devices => \@devices, groups => \@groups };
+		}
+		return undef;
+	}
+}
+
+sub get_level {
+	my ($self, $address, $query) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't get level. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 4, $address << 1 | 1, $query ? 1 : 0);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		return $self->receive();
+	}
+}
+
+sub classify {
+	my ($self, $address, $command) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't classify command. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 13, $address, $command);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		if ($ret && $ret->{status} eq 'response') {
+			my @classes = ('arc', 'command', 'config', 'query', 'special');
+			my $flags = $ret->{flags};
+			return {
+				class => $classes[$ret->{response}],
+				answered => $flags & 1,
+				repeatable => ($flags >> 1) & 1,
+				absolute => ($flags >> 2) & 1,
+				twice => ($flags >> 3) & 1,
+				stored => ($flags >> 4) & 1,
+			};
+		}
+		return undef;
+	}
+}
+
+sub get_inventory {
+	my ($self, $scan) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't get inventory. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 5, 0, $scan ? 1 : 0);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		if ($ret && $ret->{status} eq 'data') {
+			my @present = reverse(split('', unpack('B64', substr($ret->{data}, 0, 8))));
+			my @absent = reverse(split('', unpack('B64', substr($ret->{data}, 8, 8))));
+			return { present => [ grep { $present[$_] } 0..63 ], absent => [ grep { $absent[$_] } 0..63 ] };
+		}
+		return undef;
+	}
+}
+
+sub bulk_query {
+	my ($self, $address, $query) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't send bulk query. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 6, $address, $query);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		if ($ret && $ret->{status} eq 'data') {
+			my @values = unpack('(CC)64', $ret->{data});
+			return [ map { { status => $values[$_ * 2], response => $values[$_ * 2 + 1] } } 0..63 ];
+		}
+		return undef;
+	}
+}
+
+sub send_sequence {
+	my ($self, $gap, @frames) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't send sequence. Socket not connected.\n");
+	} else {
+		# gap is the maximum time between two frames in msec, 0 = unlimited
+		my $packet = pack('CCCC', $self->{protocol}, 7, scalar(@frames), int(($gap + 9) / 10));
+		for my $frame (@frames) {
+			$packet .= pack('CCCC', $self->{protocol}, 0, $frame->[0], $frame->[1]);
+		}
+		my $socket = $self->{socket};
+		print($socket $packet);
+		return [ map { $self->receive() } @frames ];
+	}
+}
+
+sub upload_program {
+	my ($self, $id, $code) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't upload program. Socket not connected.\n");
+	} else {
+		# The code is sent in whole frames, padded with zeros
+		my $packet = pack('CCCC', $self->{protocol}, 8, $id, length($code));
+		$packet .= $code . ("\0" x ((4 - length($code) % 4) % 4));
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		return $ret && $ret->{status} eq 'success';
+	}
+}
+
+sub schedule {
+	my ($self, $id, $time, $period, $relative, @frames) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't schedule commands. Socket not connected.\n");
+	} else {
+		my $batch = pack('CNN', $relative ? 1 : 0, $time, $period || 0);
+		$batch .= pack('CC', @{$_}) foreach (@frames);
+		my $packet = pack('CCCC', $self->{protocol}, 11, $id, length($batch));
+		$packet .= $batch . ("\0" x ((4 - length($batch) % 4) % 4));
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		return $ret && $ret->{status} eq 'success';
+	}
+}
+
+sub unschedule {
+	my ($self, $id) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't delete scheduled commands. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 11, $id, 0);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		return $ret && $ret->{status} eq 'success';
+	}
+}
+
+sub add_rule {
+	my ($self, $id, $pattern, @frames) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't add rule. Socket not connected.\n");
+	} else {
+		# pattern is [ecommand, mask, address, mask, command, mask]
+		my $rule = pack('CCCCCC', @{$pattern});
+		$rule .= pack('CC', @{$_}) foreach (@frames);
+		my $packet = pack('CCCC', $self->{protocol}, 12, $id, length($rule));
+		$packet .= $rule . ("\0" x ((4 - length($rule) % 4) % 4));
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		return $ret && $ret->{status} eq 'success';
+	}
+}
+
+sub delete_rule {
+	my ($self, $id) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't delete rule. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 12, $id, 0);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		return $ret && $ret->{status} eq 'success';
+	}
+}
+
+sub run_program {
+	my ($self, $id, $x) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't run program. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 9, $id, $x || 0);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret = $self->receive();
+		if ($ret && $ret->{status} eq 'data') {
+			my @values = unpack('C*', $ret->{data});
+			return [ map { { address => $values[$_ * 3], flags => $values[$_ * 3 + 1], response => $values[$_ * 3 + 2] } } 0..(@values / 3 - 1) ];
+		}
+		return undef;
+	}
+}
+
+sub commission {
+	my ($self, $flags, $progress) = @_;
+	if (!$self->{socket} && $self->{socket}->connected()) {
+		warn("Can't assign addresses. Socket not connected.\n");
+	} else {
+		my $packet = pack('CCCC', $self->{protocol}, 10, $flags || 0, 0);
+		my $socket = $self->{socket};
+		print($socket $packet);
+		my $ret;
+		while (($ret = $self->receive()) && $ret->{status} eq 'progress') {
+			$progress->($ret->{address}, $ret->{count}) if ($progress);
+		}
+		if ($ret && $ret->{status} eq 'data') {
+			my @values = unpack('C*', $ret->{data});
+			return [ map { { address => $values[$_ * 5], verified => $values[$_ * 5 + 1] & 1, random => ($values[$_ * 5 + 2] << 16) | ($values[$_ * 5 + 3] << 8) | $values[$_ * 5 + 4] } } 0..(@values / 5 - 1) ];
+		}
+		return undef;
+	}
+}
+
+sub set_ttl {
+	my ($self, $msec) = @_;
+	return $self->set_option(1, int(($msec + 99) / 100));
+}
+
+sub set_cache {
+	my ($self, $enable) = @_;
+	return $self->set_option(2, $enable ? 1 : 0);
+}
+
+sub set_tracking {
+	my ($self, $enable) = @_;
+	return $self->set_option(3, $enable ? 1 : 0);
+}
+
+sub set_events {
+	my ($self, $enable) = @_;
+	return $self->set_option(4, $enable ? 1 : 0);
+}
+
 sub receive {
 	my ($self) = @_;
 	if (!$self->{socket} && $self->{socket}->connected()) {
@@ -114,12 +387,49 @@ sub receive {
 				when (1) {
 					$ret->{status} = 'response';
 					$ret->{response} = $response;
+					$ret->{flags} = $pad;
+					$ret->{estimated} = $pad & 1;
+					$ret->{fading} = ($pad >> 1) & 1;
 				}
 				when (2) {
 					$ret->{status} = 'broadcast';
 					$ret->{address} = $response;
 					$ret->{command} = $pad;
 				}
+				when (3) {
+					$ret->{status} = 'limited';
+					$ret->{retry} = ($response << 8) | $pad;
+				}
+				when (4) {
+					$ret->{status} = 'data';
+					$self->{socket}->read($ret->{data}, ($response << 8) | $pad);
+				}
+				when (5) {
+					$ret->{status} = 'busy';
+					$ret->{queue} = $response;
+					$ret->{retry} = $pad * 100;
+				}
+				when (6) {
+					$ret->{status} = 'expired';
+				}
+				when (7) {
+					$ret->{status} = 'invalidated';
+					$ret->{address} = $response;
+					$ret->{command} = $pad;
+				}
+				when (8) {
+					$ret->{status} = 'absent';
+				}
+				when (9) {
+					$ret->{status} = 'progress';
+					$ret->{address} = $response;
+					$ret->{count} = $pad;
+				}
+				when (10) {
+					$ret->{status} = 'changed';
+					$ret->{address} = $response;
+					$ret->{command} = $pad;
+				}
 				when (255) {
 					$ret->{status} = 'error';
 				}
@@ -29,6 +29,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
+#include <time.h>
 #include "list.h"
 #include "util.h"
 #include "usb.h"
@@ -37,24 +39,33 @@
 #include "net.h"
 #include "log.h"
 #include "frame.h"
+#include "ratelimit.h"
+#include "stats.h"
+#include "cache.h"
+#include "state.h"
+#include "board.h"
+#include "program.h"
+#include "commission.h"
+#include "poller.h"
+#include "schedule.h"
+#include "rules.h"
 
-// Network protocol:
-// struct BusMessage {
-//     address:uint8_t
-//     command:uint8_t
-// }
+// Network protocol (version 2), all frames are 4 bytes:
 // struct Request {
+//     version:uint8_t
+//     type:NetCommand
 //     address:uint8_t
 //     command:uint8_t
 // }
 // struct Response {
+//     version:uint8_t
+//     status:NetStatus
 //     response:uint8_t
-//     status:Status
-// }
-// enum Status:uint8_t {
-//     0:ok
-//     1:error
+//     padding:uint8_t
 // }
+// Out of band messages are responses with the address and command in place of response and padding.
+// Status 4 is followed by the number of data bytes given by response and padding (big endian).
+// The request types, options and status codes are described in section 4 of the README.
 
 // Listen on this port
 const unsigned short DEFAULT_NET_PORT = 55825;
@@ -68,18 +79,175 @@ const size_t DEFAULT_NET_PROTOCOL = 2;
 const unsigned int DEFAULT_LOG_LEVEL = LOG_LEVEL_INFO;
 // PID file
 const char *DEFAULT_PID_FILE = "/var/run/daliserver.pid";
+// Stop reading requests when this many commands are queued
+const unsigned int DEFAULT_QUEUE_HIGH_WATER = 192;
+// Resume reading requests when the queue has drained to this length
+const unsigned int DEFAULT_QUEUE_LOW_WATER = 128;
+// Queries to devices that didn't answer QUERY CONTROL GEAR are rejected for this long
+const unsigned long DEFAULT_ABSENT_TTL = 600; //sec
+// Minimum time between the starts of two status polling cycles
+const unsigned long DEFAULT_POLL_CYCLE = 60; //sec
+// Status polling fills the bus up to this utilization
+const unsigned int DEFAULT_POLL_TARGET = 50; //percent
+// Maximum number of frames in an atomic sequence
+#define MAX_SEQUENCE_LENGTH 16
 
 typedef enum {
 	NET_STATUS_SUCCESS = 0,
 	NET_STATUS_RESPONSE = 1,
 	NET_STATUS_BROADCAST = 2,
+	NET_STATUS_RATE_LIMITED = 3,
+	NET_STATUS_DATA = 4,
+	NET_STATUS_BUSY = 5,
+	NET_STATUS_EXPIRED = 6,
+	NET_STATUS_INVALIDATED = 7,
+	NET_STATUS_ABSENT = 8,
+	NET_STATUS_PROGRESS = 9,
+	NET_STATUS_CHANGED = 10,
 	NET_STATUS_ERROR = 255,
 } NetStatus;
 
 typedef enum {
-	NET_TYPE_SEND,
+	NET_TYPE_SEND = 0,
+	NET_TYPE_OPTION = 1,
+	NET_TYPE_STATS = 2,
+	NET_TYPE_STATE = 3,
+	NET_TYPE_LEVEL = 4,
+	NET_TYPE_INVENTORY = 5,
+	NET_TYPE_BULK = 6,
+	NET_TYPE_SEQUENCE = 7,
+	NET_TYPE_UPLOAD = 8,
+	NET_TYPE_RUN = 9,
+	NET_TYPE_COMMISSION = 10,
+	NET_TYPE_SCHEDULE = 11,
+	NET_TYPE_RULE = 12,
+	NET_TYPE_CLASSIFY = 13,
 } NetCommand;
 
+typedef enum {
+	NET_OPTION_PRIORITY = 0,
+	NET_OPTION_TTL = 1,
+	NET_OPTION_CACHE = 2,
+	NET_OPTION_TRACKING = 3,
+	NET_OPTION_EVENTS = 4,
+} NetOption;
+
+// Flags of level requests and replies
+typedef enum {
+	// Request: ask the device, don't estimate
+	NET_LEVEL_QUERY = 0x01,
+	// Reply: the level was estimated
+	NET_LEVEL_ESTIMATED = 0x01,
+	// Reply: a fade is running
+	NET_LEVEL_FADING = 0x02,
+} NetLevelFlag;
+
+// Flags of scheduled batches
+typedef enum {
+	// The trigger time is relative to now instead of seconds since the epoch
+	NET_SCHEDULE_RELATIVE = 0x01,
+} NetScheduleFlag;
+
+// Size of the header of a scheduled batch: flags, trigger time and period
+#define NET_SCHEDULE_HEADER 9
+// Size of the header of a rule: value and mask of ecommand, address and command
+#define NET_RULE_HEADER 6
+
+// Flags of inventory requests
+typedef enum {
+	// Scan the bus again
+	NET_INVENTORY_SCAN = 0x01,
+} NetInventoryFlag;
+
+// Per-device status bits of bulk query replies
+typedef enum {
+	// The query was sent
+	NET_BULK_SENT = 0x01,
+	// The device answered, the response is valid
+	NET_BULK_ANSWERED = 0x02,
+	// The answer came from the response cache
+	NET_BULK_CACHED = 0x04,
+	// The device is absent, the query was not sent
+	NET_BULK_ABSENT = 0x08,
+	// The query could not be sent
+	NET_BULK_ERROR = 0x10,
+} NetBulkStatus;
+
+struct Client;
+typedef void (*ClientHandler)(struct Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response);
+
+// Per-connection state, also used by tasks of the server that send frames
+// A pointer to it is passed to the USB layer with every frame.
+typedef struct Client {
+	// NULL for internal tasks
+	ConnectionPtr conn;
+	// Internal tasks get their results here instead of a reply
+	ClientHandler handler;
+	DaliQueuePriority priority;
+	// Time to live of queued commands in msec, 0 = forever
+	unsigned int ttl;
+	// Answer queries from the response cache
+	int cached;
+	// Response cache subscriber slot, -1 if not tracking
+	int slot;
+	// Receives status polling events
+	int events;
+	TokenBucket limit;
+	// Frames of an atomic sequence that is being received
+	struct DaliFrame sequence[MAX_SEQUENCE_LENGTH];
+	unsigned int sequence_length;
+	// Number of frames announced, 0 if no sequence is being received
+	unsigned int sequence_expected;
+	// Maximum time between the frames of the sequence in msec
+	unsigned int sequence_gap;
+	// Program, scheduled batch or rule that is being uploaded, NULL if there is none
+	uint8_t *upload;
+	NetCommand upload_type;
+	uint8_t upload_id;
+	size_t upload_length;
+	size_t upload_received;
+} Client;
+
+// A query that is sent to several devices
+typedef struct {
+	// Passed to the USB layer, must come first
+	Client client;
+	// The client that will get the reply, it also owns the queued frames
+	Client *requester;
+	unsigned int pending;
+	// NetBulkStatus and response for each short address
+	uint8_t status[DALISTATE_DEVICES];
+	uint8_t response[DALISTATE_DEVICES];
+} Bulk;
+
+// A program that is being executed for a client
+typedef struct {
+	// Passed to the USB layer, must come first
+	Client client;
+	// The client that will get the results, it also owns the queued frames
+	Client *requester;
+	UsbDaliPtr dali;
+	DaliRunPtr run;
+	// Frames of the current sequence that haven't completed yet
+	unsigned int pending;
+	// A frame of the current sequence could not be sent
+	int failed;
+} Task;
+
+// Address assignment that is running on the bus
+typedef struct {
+	// Passed to the USB layer, must come first
+	Client client;
+	// The client that gets the progress and the results
+	Client *requester;
+	UsbDaliPtr dali;
+	DaliCommissionPtr engine;
+	// Frames that haven't completed yet
+	unsigned int pending;
+	// Devices that were reported to the requester
+	size_t reported;
+} Commission;
+
 typedef struct {
 	unsigned short port;
 	char *address;
@@ -89,21 +257,127 @@ typedef struct {
 	char *logfile;
 	int background;
 	char *pidfile;
+	char *board;
+	char *inventory;
+	unsigned long absentttl;
 	int usbbus;
 	int usbdev;
+	unsigned int connrate;
+	unsigned int connburst;
+	unsigned int addrrate;
+	unsigned int addrburst;
+	unsigned int cancelclasses;
+	// Status polling query sets
+	uint8_t pollqueries[DALIPOLLER_MAX_SETS][DALIPOLLER_MAX_QUERIES];
+	size_t pollcount[DALIPOLLER_MAX_SETS];
+	uint64_t polldevices[DALIPOLLER_MAX_SETS];
+	size_t pollsets;
+	unsigned long pollcycle;
+	unsigned int polltarget;
+	// Time in msec that commands wait for the rest of their group, 0 = no grouping
+	unsigned int groupwindow;
 } Options;
 
 static IpcPtr killsocket;
 static int running;
+// Rate limits per connection and per remote address
+static unsigned int connection_rate;
+static unsigned int connection_burst;
+static RateLimitTablePtr address_limits;
+// Responses to recent queries
+static DaliCachePtr cache;
+// What we know about the devices on the bus
+static DaliStatePtr state;
+// Connections by response cache subscriber slot
+static ConnectionPtr trackers[DALICACHE_SLOTS];
+// Shared memory copy of the state table for local readers
+static DaliBoardPtr board;
+// Presence scan
+static Client inventory;
+static unsigned int inventory_pending;
+static char *inventory_file;
+static unsigned long absent_ttl;
+// Running bulk queries
+static ListPtr bulks;
+
+// Uploaded programs by ID
+static DaliProgramPtr programs[256];
+static ListPtr tasks;
+
+// Only one address assignment can run at a time
+static Commission *commission;
+
+// Background status polling
+static DaliPollerPtr poller;
+static Client polling;
+// Connections that receive polling events
+static ListPtr listeners;
+
+// Time-triggered batches by ID
+static DaliSchedulePtr schedule;
+static Client scheduler;
+
+// Local reactions to frames of other bus masters, by ID
+static DaliRulesPtr rules;
+static Client reactor;
+// The adapter, for handlers that aren't passed it
+static UsbDaliPtr bus;
 
 static void signal_handler(int sig);
 static void dali_outband_handler(UsbDaliError err, DaliFramePtr frame, unsigned int status, void *arg);
 static void dali_inband_handler(UsbDaliError err, DaliFramePtr frame, unsigned int response, unsigned int status, void *arg);
+static void dali_queue_handler(int full, void *arg);
+static void dali_invalidate_handler(unsigned int slot, uint8_t address, uint8_t opcode, void *arg);
+static void dali_inventory_start(UsbDaliPtr dali);
+static void dali_inventory_handler(Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response);
+static void dali_bulk_handler(Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response);
+static void dali_task_handler(Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response);
+static void dali_commission_handler(Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response);
+static void dali_schedule(UsbDaliPtr dali);
+static void dali_rule_action(unsigned int id, DaliFramePtr const *frames, size_t count, void *arg);
+static void dali_poll(UsbDaliPtr dali);
+static void dali_poll_handler(Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response);
+static int dali_get_timeout(UsbDaliPtr dali);
+static void dali_update_groups(UsbDaliPtr dali);
 static void net_frame_handler(void *arg, const char *buffer, size_t bufsize, ConnectionPtr conn);
+static void net_reply(ConnectionPtr conn, uint8_t status, uint8_t data0, uint8_t data1);
+static void net_send_frame(UsbDaliPtr dali, Client *client, ConnectionPtr conn, DaliFramePtr request, int cached);
+static void net_send_level(UsbDaliPtr dali, Client *client, ConnectionPtr conn, uint8_t address, uint8_t flags);
+static void net_start_sequence(Client *client, ConnectionPtr conn, uint8_t length, uint8_t gap);
+static void net_add_sequence(UsbDaliPtr dali, Client *client, ConnectionPtr conn, DaliFramePtr request);
+static void net_send_sequence(UsbDaliPtr dali, Client *client, ConnectionPtr conn);
+static void net_abort_sequence(Client *client, ConnectionPtr conn, uint8_t status, uint8_t data0, uint8_t data1);
+static void net_init_client(Client *client, ConnectionPtr conn);
+static Client *net_get_client(ConnectionPtr conn);
+static void net_send_inventory(UsbDaliPtr dali, ConnectionPtr conn, uint8_t flags);
+static void net_send_bulk(UsbDaliPtr dali, Client *client, uint8_t address, uint8_t opcode);
+static void net_reply_bulk(Bulk *bulk);
+static void net_start_upload(Client *client, ConnectionPtr conn, NetCommand type, uint8_t id, uint8_t length);
+static void net_add_upload(Client *client, ConnectionPtr conn, const char *buffer);
+static int net_add_program(uint8_t id, const uint8_t *data, size_t length);
+static int net_add_schedule(uint8_t id, const uint8_t *data, size_t length);
+static int net_add_rule(uint8_t id, const uint8_t *data, size_t length);
+static void net_run_program(UsbDaliPtr dali, Client *client, uint8_t id, uint8_t x);
+static void net_step_task(Task *task);
+static void net_free_task(Task *task);
+static void net_start_commission(UsbDaliPtr dali, Client *client, uint8_t flags);
+static void net_step_commission(Commission *run);
+static void net_stop_commission(Commission *run);
+static int net_set_option(Client *client, ConnectionPtr conn, uint8_t option, uint8_t value);
+static unsigned int net_admit(Client *client, ConnectionPtr conn);
+static void net_reply_data(ConnectionPtr conn, const char *data, size_t length);
+static void net_send_stats(ConnectionPtr conn);
+static void net_send_state(ConnectionPtr conn);
+static int net_reply_cached(Client *client, ConnectionPtr conn, DaliFramePtr frame);
+static void net_reply_busy(ConnectionPtr conn, UsbDaliPtr dali);
 static void net_dequeue_connection(void *arg, ConnectionPtr conn);
 static Options *parse_opt(int argc, char *const argv[]);
 static void free_opt(Options *opts);
 static int split_usbdev(const char *arg, int *usbbus, int *usbdev);
+static int split_rate(const char *arg, unsigned int *rate, unsigned int *burst);
+static int split_classes(const char *arg, unsigned int *classes);
+static int split_poll(const char *arg, Options *opts);
+static int split_devices(const char *arg, uint64_t *devices);
 static void show_help();
 static void show_banner();
 
@@ -135,6 +409,68 @@ int main(int argc, char *const argv[]) {
 
 	log_info("Starting daliserver");
 
+	connection_rate = opts->connrate;
+	connection_burst = opts->connburst;
+	if (opts->addrrate > 0) {
+		address_limits = ratelimit_table_new(opts->addrrate, opts->addrburst);
+	}
+	cache = dalicache_new();
+	if (!cache) {
+		log_warn("Can't allocate response cache, all queries will be sent");
+	}
+	dalicache_set_invalidate_callback(cache, dali_invalidate_handler, NULL);
+	state = dalistate_new();
+	if (!state) {
+		log_warn("Can't allocate device state table");
+	}
+	absent_ttl = opts->absentttl * 1000;
+	inventory_file = opts->inventory;
+	if (inventory_file) {
+		if (dalistate_load_inventory(state, inventory_file, monotonic_msec())) {
+			log_info("Loaded %s", inventory_file);
+		} else if (errno != ENOENT) {
+			log_warn("Can't load %s: %s", inventory_file, strerror(errno));
+		}
+	}
+	bulks = list_new(NULL);
+	tasks = list_new(NULL);
+	listeners = list_new(NULL);
+	if (opts->pollsets > 0) {
+		poller = dalipoller_new(opts->pollcycle * 1000, opts->polltarget);
+		size_t set;
+		for (set = 0; poller && set < opts->pollsets; set++) {
+			dalipoller_add(poller, opts->pollqueries[set], opts->pollcount[set], opts->polldevices[set]);
+		}
+		if (!poller) {
+			log_warn("Can't allocate status poller, polling is disabled");
+		}
+	}
+	schedule = dalischedule_new();
+	if (!schedule) {
+		log_warn("Can't allocate command schedule");
+	}
+	net_init_client(&scheduler, NULL);
+	scheduler.priority = DALIQUEUE_PRIORITY_SCHEDULED;
+	rules = dalirules_new();
+	if (!rules) {
+		log_warn("Can't allocate rule table");
+	}
+	net_init_client(&reactor, NULL);
+	reactor.priority = DALIQUEUE_PRIORITY_INTERACTIVE;
+	net_init_client(&polling, NULL);
+	polling.priority = DALIQUEUE_PRIORITY_BACKGROUND;
+	polling.handler = dali_poll_handler;
+	net_init_client(&inventory, NULL);
+	inventory.priority = DALIQUEUE_PRIORITY_BACKGROUND;
+	inventory.handler = dali_inventory_handler;
+	if (opts->board) {
+		board = daliboard_new(opts->board);
+		if (!board) {
+			log_warn("Can't publish the device state in shared memory");
+		}
+		daliboard_update(board, state);
+	}
+
 	log_debug("Initializing dispatch queue");
 	DispatchPtr dispatch = dispatch_new();
 	if (!dispatch) {
@@ -163,6 +499,12 @@ int main(int argc, char *const argv[]) {
 				if (usb) {
 					usbdali_set_outband_callback(usb, dali_outband_handler, server);
 					usbdali_set_inband_callback(usb, dali_inband_handler);
+					usbdali_set_queue_callback(usb, DEFAULT_QUEUE_LOW_WATER, DEFAULT_QUEUE_HIGH_WATER, dali_queue_handler, server);
+					usbdali_set_cancel_classes(usb, opts->cancelclasses);
+					usbdali_set_grouping(usb, opts->groupwindow);
+					dali_update_groups(usb);
+					bus = usb;
+					dali_inventory_start(usb);
 				}
 
 				log_debug("Creating shutdown notifier");
@@ -178,7 +520,11 @@ int main(int argc, char *const argv[]) {
 					signal(SIGTERM, signal_handler);
 					signal(SIGINT, signal_handler);
 					signal(SIGHUP, signal_handler);
-					while (running && dispatch_run(dispatch, usbdali_get_timeout(usb)));
+					while (running && dispatch_run(dispatch, dali_get_timeout(usb))) {
+						usbdali_release(usb);
+						dali_schedule(usb);
+						dali_poll(usb);
+					}
 
 					log_info("Shutting daliserver down");
 					ipc_free(killsocket);
@@ -195,6 +541,24 @@ int main(int argc, char *const argv[]) {
 		dispatch_free(dispatch);
 	}
 
+	list_free(bulks);
+	list_free(tasks);
+	list_free(listeners);
+	dalipoller_free(poller);
+	dalischedule_free(schedule);
+	dalirules_free(rules);
+	unsigned int id;
+	for (id = 0; id < sizeof(programs) / sizeof(programs[0]); id++) {
+		daliprogram_free(programs[id]);
+	}
+	ratelimit_table_free(address_limits);
+	dalicache_free(cache);
+	daliboard_free(board);
+	if (inventory_file && !dalistate_save_inventory(state, inventory_file)) {
+		log_error("Can't save %s: %s", inventory_file, strerror(errno));
+	}
+	dalistate_free(state);
+	stats_clear();
 	free_opt(opts);
 	
 	log_info("Exiting");
@@ -222,6 +586,19 @@ static void dali_outband_handler(UsbDaliError err, DaliFramePtr frame, unsigned
 	log_debug("Outband message received");
 	if (err == USBDALI_SUCCESS) {
 		log_info("Broadcast (0x%02x 0x%02x) [0x%04x]", frame->address, frame->command, status);
+		// React before anything else, so the reaction is queued as early as possible
+		size_t matched = dalirules_match(rules, frame, dali_rule_action, bus);
+		if (matched > 0) {
+			stats_add("rules.matched", matched);
+		}
+		dalipoller_busy(poller, monotonic_msec());
+		// Another bus master may have changed the state of some devices
+		if (dalicache_invalidate(cache, frame, monotonic_msec()) > 0) {
+			stats_add("cache.invalidated", 1);
+		}
+		if (dalistate_command(state, frame, monotonic_msec()) > 0) {
+			daliboard_update(board, state);
+		}
 		ServerPtr server = (ServerPtr) arg;
 		if (server) {
 			char rbuffer[DEFAULT_NET_FRAMESIZE];
@@ -238,7 +615,36 @@ static void dali_inband_handler(UsbDaliError err, DaliFramePtr frame, unsigned i
 	log_debug("Inband message received");
 	if (err == USBDALI_SUCCESS || err == USBDALI_RESPONSE) {
 		log_info("Response to (0x%02x 0x%02x): 0x%02x [0x%04x]", frame->address, frame->command, response, status);
-		ConnectionPtr conn = (ConnectionPtr) arg;
+		if (arg != &polling) {
+			dalipoller_busy(poller, monotonic_msec());
+		}
+		unsigned int changed;
+		if (daliframe_classify(frame) == DALIFRAME_CLASS_QUERY) {
+			changed = dalistate_response(state, frame, err == USBDALI_RESPONSE ? (int) response : -1, monotonic_msec());
+		} else {
+			changed = dalistate_command(state, frame, monotonic_msec());
+		}
+		if (changed > 0) {
+			daliboard_update(board, state);
+			dali_update_groups(bus);
+		}
+		if (err == USBDALI_RESPONSE) {
+			dalicache_store(cache, frame, (uint8_t) response, monotonic_msec());
+			if (arg) {
+				dalicache_track(cache, frame, ((Client *) arg)->slot);
+			}
+		} else if (dalicache_invalidate(cache, frame, monotonic_msec()) > 0) {
+			// Queries sent before the command may have stored old responses in the meantime
+			stats_add("cache.invalidated", 1);
+		}
+	}
+	Client *client = (Client *) arg;
+	if (client && client->handler) {
+		client->handler(client, err, frame, response);
+		return;
+	}
+	ConnectionPtr conn = client ? client->conn : NULL;
+	if (err == USBDALI_SUCCESS || err == USBDALI_RESPONSE) {
 		if (conn) {
 			char rbuffer[DEFAULT_NET_FRAMESIZE];
 			rbuffer[0] = DEFAULT_NET_PROTOCOL;
@@ -252,9 +658,13 @@ static void dali_inband_handler(UsbDaliError err, DaliFramePtr frame, unsigned i
 			rbuffer[3] = 0;
 			connection_reply(conn, rbuffer, sizeof(rbuffer));
 		}
+	} else if (err == USBDALI_EXPIRED) {
+		if (conn) {
+			stats_add("net.expired", 1);
+			net_reply(conn, NET_STATUS_EXPIRED, 0, 0);
+		}
 	} else {
 		log_error("Error sending DALI message: %s", usbdali_error_string(err));
-		ConnectionPtr conn = (ConnectionPtr) arg;
 		if (conn) {
 			char rbuffer[DEFAULT_NET_FRAMESIZE];
 			rbuffer[0] = DEFAULT_NET_PROTOCOL;
@@ -266,27 +676,325 @@ static void dali_inband_handler(UsbDaliError err, DaliFramePtr frame, unsigned i
 	}
 }
 
+static void dali_invalidate_handler(unsigned int slot, uint8_t address, uint8_t opcode, void *arg) {
+	if (slot < DALICACHE_SLOTS && trackers[slot]) {
+		log_debug("Invalidating (0x%02x 0x%02x) on connection %p", address, opcode, trackers[slot]);
+		stats_add("cache.pushed", 1);
+		net_reply(trackers[slot], NET_STATUS_INVALIDATED, address, opcode);
+	}
+}
+
+static void dali_inventory_start(UsbDaliPtr dali) {
+	if (!dali || inventory_pending > 0) {
+		return;
+	}
+	log_info("Scanning the bus for devices");
+	unsigned int device;
+	for (device = 0; device < DALISTATE_DEVICES; device++) {
+		// Query control gear
+		DaliFramePtr frame = daliframe_new((uint8_t) ((device << 1) | 1), 0x91);
+		if (frame) {
+			UsbDaliError err = usbdali_queue(dali, frame, inventory.priority, inventory.ttl, &inventory);
+			if (err == USBDALI_SUCCESS) {
+				inventory_pending++;
+			} else {
+				log_warn("Can't queue inventory query: %s", usbdali_error_string(err));
+				daliframe_free(frame);
+			}
+		}
+	}
+}
+
+static void dali_inventory_handler(Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response) {
+	if (inventory_pending > 0 && --inventory_pending == 0) {
+		uint64_t present = dalistate_inventory(state, DALISTATE_PRESENT);
+		stats_set("state.present", __builtin_popcountll(present));
+		log_info("Inventory complete, %d devices present", __builtin_popcountll(present));
+		if (inventory_file && !dalistate_save_inventory(state, inventory_file)) {
+			log_error("Can't save %s: %s", inventory_file, strerror(errno));
+		}
+	}
+}
+
+static void dali_bulk_handler(Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response) {
+	Bulk *bulk = (Bulk *) client;
+	unsigned int device = frame->address >> 1;
+	if (err == USBDALI_RESPONSE) {
+		bulk->status[device] |= NET_BULK_ANSWERED;
+		bulk->response[device] = (uint8_t) response;
+	} else if (err != USBDALI_SUCCESS) {
+		bulk->status[device] |= NET_BULK_ERROR;
+	}
+	if (--bulk->pending == 0) {
+		ListNodePtr node = list_find(bulks, list_equal, bulk);
+		if (node) {
+			list_remove(bulks, node);
+		}
+		net_reply_bulk(bulk);
+		free(bulk);
+	}
+}
+
+static void dali_task_handler(Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response) {
+	Task *task = (Task *) client;
+	if (err != USBDALI_SUCCESS && err != USBDALI_RESPONSE) {
+		task->failed = 1;
+	}
+	// The frames of a sequence complete one by one, the last result counts
+	if (--task->pending > 0) {
+		return;
+	}
+	if (task->failed) {
+		dalirun_response(task->run, DALIRUN_SEND_FAILED);
+	} else if (err == USBDALI_RESPONSE) {
+		dalirun_response(task->run, (int) response);
+	} else {
+		dalirun_response(task->run, DALIRUN_NO_RESPONSE);
+	}
+	net_step_task(task);
+}
+
+static void dali_commission_handler(Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response) {
+	Commission *run = (Commission *) client;
+	// Frames that are sent twice complete twice, the second result counts
+	if (--run->pending > 0) {
+		return;
+	}
+	if (err == USBDALI_RESPONSE) {
+		dalicommission_response(run->engine, (int) response);
+	} else if (err == USBDALI_SUCCESS) {
+		dalicommission_response(run->engine, DALICOMMISSION_NO_RESPONSE);
+	} else {
+		dalicommission_response(run->engine, DALICOMMISSION_SEND_FAILED);
+	}
+	net_step_commission(run);
+}
+
+static void dali_schedule(UsbDaliPtr dali) {
+	if (!dali) {
+		return;
+	}
+	unsigned long now = monotonic_msec();
+	DaliFramePtr frames[DALISCHEDULE_MAX_FRAMES];
+	unsigned int id;
+	unsigned long due;
+	size_t count;
+	while ((count = dalischedule_next(schedule, now, frames, &id, &due)) > 0) {
+		log_info("Sending scheduled batch %u, %lu msec late", id, now - due);
+		stats_add("schedule.triggered", 1);
+		stats_set("schedule.missed", dalischedule_missed(schedule));
+		UsbDaliError err;
+		if (count == 1) {
+			err = usbdali_queue(dali, frames[0], scheduler.priority, 0, &scheduler);
+		} else {
+			err = usbdali_queue_sequence(dali, frames, count, 0, scheduler.priority, 0, &scheduler);
+		}
+		if (err != USBDALI_SUCCESS) {
+			log_error("Can't queue scheduled batch %u: %s", id, usbdali_error_string(err));
+			size_t i;
+			for (i = 0; i < count; i++) {
+				daliframe_free(frames[i]);
+			}
+		}
+	}
+}
+
+static void dali_rule_action(unsigned int id, DaliFramePtr const *frames, size_t count, void *arg) {
+	UsbDaliPtr dali = (UsbDaliPtr) arg;
+	if (!dali) {
+		return;
+	}
+	log_info("Rule %u matched, sending %lu frames", id, count);
+	DaliFramePtr copies[DALIRULES_MAX_FRAMES];
+	size_t i;
+	for (i = 0; i < count; i++) {
+		copies[i] = daliframe_clone(frames[i]);
+		if (!copies[i]) {
+			break;
+		}
+	}
+	UsbDaliError err = USBDALI_NO_MEMORY;
+	if (i == count) {
+		if (count == 1) {
+			err = usbdali_queue(dali, copies[0], reactor.priority, 0, &reactor);
+		} else {
+			err = usbdali_queue_sequence(dali, copies, count, 0, reactor.priority, 0, &reactor);
+		}
+	}
+	if (err != USBDALI_SUCCESS) {
+		log_error("Can't queue frames of rule %u: %s", id, usbdali_error_string(err));
+		while (i > 0) {
+			daliframe_free(copies[--i]);
+		}
+	}
+}
+
+static void dali_poll(UsbDaliPtr dali) {
+	// Polling only uses the bus when nothing else is waiting for it
+	if (!dali || !poller || usbdali_get_queue_length(dali) > 0) {
+		return;
+	}
+	unsigned long now = monotonic_msec();
+	DaliFramePtr frame = dalipoller_next(poller, dalistate_inventory(state, DALISTATE_PRESENT), now);
+	if (frame) {
+		UsbDaliError err = usbdali_queue(dali, frame, polling.priority, polling.ttl, &polling);
+		if (err == USBDALI_SUCCESS) {
+			stats_add("poll.frames", 1);
+		} else {
+			log_warn("Can't queue status query: %s", usbdali_error_string(err));
+			daliframe_free(frame);
+			dalipoller_response(poller, DALIPOLLER_SEND_FAILED, now);
+		}
+	}
+}
+
+static void dali_poll_handler(Client *client, UsbDaliError err, DaliFramePtr frame, unsigned int response) {
+	unsigned long now = monotonic_msec();
+	int changed;
+	if (err == USBDALI_RESPONSE) {
+		changed = dalipoller_response(poller, (int) response, now);
+	} else if (err == USBDALI_SUCCESS) {
+		changed = dalipoller_response(poller, DALIPOLLER_NO_RESPONSE, now);
+	} else {
+		changed = dalipoller_response(poller, DALIPOLLER_SEND_FAILED, now);
+	}
+	stats_set("poll.utilization", dalipoller_utilization(poller, now));
+	stats_set("poll.cycles", dalipoller_cycles(poller));
+	if (changed) {
+		log_info("Status of (0x%02x 0x%02x) has changed", frame->address, frame->command);
+		stats_add("poll.changes", 1);
+		ListNodePtr node = list_first(listeners);
+		while (node) {
+			// A failed write removes the connection and its node
+			ListNodePtr next = list_next(node);
+			net_reply((ConnectionPtr) list_data(node), NET_STATUS_CHANGED, frame->address, frame->command);
+			node = next;
+		}
+	}
+}
+
+static int dali_get_timeout(UsbDaliPtr dali) {
+	int timeout = usbdali_get_timeout(dali);
+	if (dali) {
+		long wait = dalischedule_wait(schedule, monotonic_msec());
+		if (wait >= 0 && (timeout < 0 || wait < timeout)) {
+			timeout = wait > INT_MAX ? INT_MAX : (int) wait;
+		}
+	}
+	// Frames that are waiting wake us up when they complete
+	if (dali && poller && usbdali_get_queue_length(dali) == 0) {
+		long wait = dalipoller_wait(poller, dalistate_inventory(state, DALISTATE_PRESENT), monotonic_msec());
+		if (wait >= 0 && (timeout < 0 || wait < timeout)) {
+			timeout = (int) wait;
+		}
+	}
+	return timeout;
+}
+
+static void dali_update_groups(UsbDaliPtr dali) {
+	uint64_t present = dalistate_inventory(state, DALISTATE_PRESENT);
+	uint64_t known = present | dalistate_inventory(state, DALISTATE_ABSENT);
+	unsigned int device;
+	for (device = 0; device < DALISTATE_DEVICES; device++) {
+		if ((present & ((uint64_t) 1 << device)) && !(dalistate_device(state, device)->flags & DALISTATE_GROUPS_KNOWN)) {
+			known &= ~((uint64_t) 1 << device);
+		}
+	}
+	// Group and broadcast commands would also reach devices we don't know enough about
+	uint64_t groups[DALISTATE_GROUPS];
+	unsigned int group;
+	for (group = 0; group < DALISTATE_GROUPS; group++) {
+		groups[group] = known == UINT64_MAX ? dalistate_members(state, group) & present : 0;
+	}
+	usbdali_set_groups(dali, groups, known == UINT64_MAX ? present : 0);
+}
+
+static void dali_queue_handler(int full, void *arg) {
+	ServerPtr server = (ServerPtr) arg;
+	if (full) {
+		log_warn("DALI queue is filling up, not accepting new requests");
+		stats_add("net.paused", 1);
+	} else {
+		log_info("DALI queue has drained, accepting requests again");
+	}
+	server_pause(server, full);
+}
+
 static void net_frame_handler(void *arg, const char *buffer, size_t bufsize, ConnectionPtr conn) {
 	if (buffer && bufsize >= DEFAULT_NET_FRAMESIZE) {
 		log_info("Got frame: 0x%02x 0x%02x 0x%02x 0x%02x", (uint8_t) buffer[0], (uint8_t) buffer[1], (uint8_t) buffer[2], (uint8_t) buffer[3]);
+		stats_add("net.frames", 1);
+		// Program code, scheduled batches and rules follow their upload request as raw data
+		Client *uploader = (Client *) connection_get_data(conn);
+		if (uploader && uploader->upload) {
+			net_add_upload(uploader, conn, buffer);
+			return;
+		}
 		if ((uint8_t) buffer[0] == DEFAULT_NET_PROTOCOL) {
-			if ((uint8_t) buffer[1] == NET_TYPE_SEND) {
-				UsbDaliPtr dali = (UsbDaliPtr) arg;
-				if (dali) {
-					DaliFramePtr frame = daliframe_new((uint8_t) buffer[2], (uint8_t) buffer[3]);
-					usbdali_queue(dali, frame, conn);
+			Client *client = net_get_client(conn);
+			if (!client) {
+				net_reply(conn, NET_STATUS_ERROR, 0, 0);
+				return;
+			}
+			if (client->sequence_expected > 0 && (uint8_t) buffer[1] != NET_TYPE_SEND) {
+				log_warn("Sequence interrupted by request type %u on connection %p", (uint8_t) buffer[1], conn);
+				net_abort_sequence(client, conn, NET_STATUS_ERROR, 0, 0);
+			}
+			switch ((uint8_t) buffer[1]) {
+			case NET_TYPE_SEND: {
+				// Only admitted frames are allocated, rejected ones are checked on the stack
+				struct DaliFrame frame = { 0, (uint8_t) buffer[2], (uint8_t) buffer[3] };
+				if (client->sequence_expected > 0) {
+					net_add_sequence((UsbDaliPtr) arg, client, conn, &frame);
 				} else {
-					uint8_t response = 0;
-					log_info("Faking response: 0x%02x", response);
-					char rbuffer[DEFAULT_NET_FRAMESIZE];
-					rbuffer[0] = DEFAULT_NET_PROTOCOL;
-					rbuffer[1] = NET_STATUS_RESPONSE;
-					rbuffer[2] = (uint8_t) response;
-					rbuffer[3] = 0;
-					connection_reply(conn, rbuffer, sizeof(rbuffer));
+					net_send_frame((UsbDaliPtr) arg, client, conn, &frame, 1);
 				}
-			} else {
+			} break;
+			case NET_TYPE_SEQUENCE:
+				net_start_sequence(client, conn, (uint8_t) buffer[2], (uint8_t) buffer[3]);
+				break;
+			case NET_TYPE_UPLOAD:
+			case NET_TYPE_SCHEDULE:
+			case NET_TYPE_RULE:
+				net_start_upload(client, conn, (NetCommand) buffer[1], (uint8_t) buffer[2], (uint8_t) buffer[3]);
+				break;
+			case NET_TYPE_RUN:
+				net_run_program((UsbDaliPtr) arg, client, (uint8_t) buffer[2], (uint8_t) buffer[3]);
+				break;
+			case NET_TYPE_COMMISSION:
+				net_start_commission((UsbDaliPtr) arg, client, (uint8_t) buffer[2]);
+				break;
+			case NET_TYPE_LEVEL:
+				net_send_level((UsbDaliPtr) arg, client, conn, (uint8_t) buffer[2], (uint8_t) buffer[3]);
+				break;
+			case NET_TYPE_INVENTORY:
+				net_send_inventory((UsbDaliPtr) arg, conn, (uint8_t) buffer[3]);
+				break;
+			case NET_TYPE_BULK:
+				net_send_bulk((UsbDaliPtr) arg, client, (uint8_t) buffer[2], (uint8_t) buffer[3]);
+				break;
+			case NET_TYPE_OPTION:
+				if (net_set_option(client, conn, (uint8_t) buffer[2], (uint8_t) buffer[3])) {
+					net_reply(conn, NET_STATUS_SUCCESS, 0, 0);
+				} else {
+					log_warn("Invalid option %u=%u", (uint8_t) buffer[2], (uint8_t) buffer[3]);
+					net_reply(conn, NET_STATUS_ERROR, 0, 0);
+				}
+				break;
+			case NET_TYPE_STATS:
+				net_send_stats(conn);
+				break;
+			case NET_TYPE_STATE:
+				net_send_state(conn);
+				break;
+			case NET_TYPE_CLASSIFY: {
+				// Lets clients make the same scheduling decisions as the server
+				struct DaliFrame frame = { 0, (uint8_t) buffer[2], (uint8_t) buffer[3] };
+				net_reply(conn, NET_STATUS_RESPONSE, (uint8_t) daliframe_classify(&frame), (uint8_t) daliframe_flags(&frame));
+			} break;
+			default:
 				log_warn("Frame with unsupported command received: %u", (uint8_t) buffer[1]);
+				break;
 			}
 		} else {
 			log_warn("Frame with invalid protocol version received: %u", (uint8_t) buffer[0]);
@@ -294,11 +1002,817 @@ static void net_frame_handler(void *arg, const char *buffer, size_t bufsize, Con
 	}
 }
 
+static void net_send_frame(UsbDaliPtr dali, Client *client, ConnectionPtr conn, DaliFramePtr request, int cached) {
+	// Cache hits don't use the bus, so they aren't rate limited
+	if (cached && net_reply_cached(client, conn, request)) {
+		return;
+	}
+	// Don't wait for answers from devices that aren't there
+	if (absent_ttl > 0 && daliframe_classify(request) == DALIFRAME_CLASS_QUERY && (request->address & 0x80) == 0 && dalistate_absent(state, request->address >> 1, monotonic_msec(), absent_ttl)) {
+		log_info("Device %u is absent, not sending (0x%02x 0x%02x)", request->address >> 1, request->address, request->command);
+		stats_add("state.absent", 1);
+		net_reply(conn, NET_STATUS_ABSENT, 0, 0);
+		return;
+	}
+	unsigned int wait = net_admit(client, conn);
+	if (wait > 0) {
+		log_info("Rate limit exceeded on connection %p, retry in %u msec", conn, wait);
+		net_reply(conn, NET_STATUS_RATE_LIMITED, (uint8_t) (wait >> 8), (uint8_t) wait);
+		return;
+	}
+	if (dali) {
+		// Drop stale responses right away, later queries must not be answered before the command is sent
+		dalicache_invalidate(cache, request, monotonic_msec());
+		DaliFramePtr frame = daliframe_clone(request);
+		if (!frame) {
+			net_reply(conn, NET_STATUS_ERROR, 0, 0);
+			return;
+		}
+		UsbDaliError err = usbdali_queue(dali, frame, client->priority, client->ttl, client);
+		if (err != USBDALI_SUCCESS) {
+			daliframe_free(frame);
+			if (err == USBDALI_QUEUE_FULL) {
+				log_info("Queue full, rejecting DALI message from connection %p", conn);
+				net_reply_busy(conn, dali);
+			} else {
+				log_warn("Can't queue DALI message: %s", usbdali_error_string(err));
+				net_reply(conn, NET_STATUS_ERROR, 0, 0);
+			}
+		}
+	} else {
+		uint8_t response = 0;
+		log_info("Faking response: 0x%02x", response);
+		net_reply(conn, NET_STATUS_RESPONSE, response, 0);
+	}
+}
+
+static void net_start_sequence(Client *client, ConnectionPtr conn, uint8_t length, uint8_t gap) {
+	if (length == 0 || length > MAX_SEQUENCE_LENGTH) {
+		log_warn("Invalid sequence length %u", length);
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	log_debug("Receiving sequence of %u frames on connection %p", length, conn);
+	client->sequence_length = 0;
+	client->sequence_expected = length;
+	client->sequence_gap = gap * 10;
+}
+
+static void net_add_sequence(UsbDaliPtr dali, Client *client, ConnectionPtr conn, DaliFramePtr request) {
+	// Frames are kept by value until the whole sequence is admitted
+	client->sequence[client->sequence_length++] = *request;
+	if (client->sequence_length == client->sequence_expected) {
+		net_send_sequence(dali, client, conn);
+	}
+}
+
+static void net_send_sequence(UsbDaliPtr dali, Client *client, ConnectionPtr conn) {
+	stats_add("net.sequences", 1);
+	// A sequence counts as one request, like a bulk query
+	unsigned int wait = net_admit(client, conn);
+	if (wait > 0) {
+		log_info("Rate limit exceeded on connection %p, retry in %u msec", conn, wait);
+		net_abort_sequence(client, conn, NET_STATUS_RATE_LIMITED, (uint8_t) (wait >> 8), (uint8_t) wait);
+		return;
+	}
+	if (!dali) {
+		log_info("Faking responses to sequence");
+		net_abort_sequence(client, conn, NET_STATUS_RESPONSE, 0, 0);
+		return;
+	}
+	DaliFramePtr frames[MAX_SEQUENCE_LENGTH];
+	unsigned int i;
+	for (i = 0; i < client->sequence_length; i++) {
+		frames[i] = daliframe_clone(&client->sequence[i]);
+		if (!frames[i]) {
+			while (i > 0) {
+				daliframe_free(frames[--i]);
+			}
+			net_abort_sequence(client, conn, NET_STATUS_ERROR, 0, 0);
+			return;
+		}
+	}
+	for (i = 0; i < client->sequence_length; i++) {
+		// Drop stale responses right away, like for single frames
+		dalicache_invalidate(cache, frames[i], monotonic_msec());
+	}
+	UsbDaliError err = usbdali_queue_sequence(dali, frames, client->sequence_length, client->sequence_gap, client->priority, client->ttl, client);
+	if (err != USBDALI_SUCCESS) {
+		for (i = 0; i < client->sequence_length; i++) {
+			daliframe_free(frames[i]);
+		}
+		if (err == USBDALI_QUEUE_FULL) {
+			log_info("Queue full, rejecting DALI sequence from connection %p", conn);
+			for (i = 0; i < client->sequence_length; i++) {
+				net_reply_busy(conn, dali);
+			}
+			net_abort_sequence(client, NULL, 0, 0, 0);
+		} else {
+			log_warn("Can't queue DALI sequence: %s", usbdali_error_string(err));
+			net_abort_sequence(client, conn, NET_STATUS_ERROR, 0, 0);
+		}
+		return;
+	}
+	// The frames belong to the USB layer now
+	client->sequence_length = 0;
+	client->sequence_expected = 0;
+}
+
+static void net_abort_sequence(Client *client, ConnectionPtr conn, uint8_t status, uint8_t data0, uint8_t data1) {
+	unsigned int i;
+	for (i = 0; i < client->sequence_length; i++) {
+		if (conn) {
+			net_reply(conn, status, data0, data1);
+		}
+	}
+	client->sequence_length = 0;
+	client->sequence_expected = 0;
+}
+
+static void net_send_level(UsbDaliPtr dali, Client *client, ConnectionPtr conn, uint8_t address, uint8_t flags) {
+	// Only single devices have a level
+	if (address & 0x80) {
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	if (!(flags & NET_LEVEL_QUERY)) {
+		int fading;
+		int level = dalistate_estimate(state, address >> 1, monotonic_msec(), &fading);
+		if (level >= 0) {
+			log_info("Estimated level of device %u: 0x%02x%s", address >> 1, level, fading ? " (fading)" : "");
+			stats_add("state.estimated", 1);
+			net_reply(conn, NET_STATUS_RESPONSE, (uint8_t) level, NET_LEVEL_ESTIMATED | (fading ? NET_LEVEL_FADING : 0));
+			return;
+		}
+	}
+	// Query actual level, the cache may be older than the last command, so it's skipped
+	struct DaliFrame query = { 0, (uint8_t) (address | 0x01), 0xa0 };
+	net_send_frame(dali, client, conn, &query, 0);
+}
+
+static void net_send_bulk(UsbDaliPtr dali, Client *client, uint8_t address, uint8_t opcode) {
+	ConnectionPtr conn = client->conn;
+	struct DaliFrame query = { 0, 0x01, opcode };
+	if (daliframe_classify(&query) != DALIFRAME_CLASS_QUERY) {
+		log_warn("Bulk request with invalid query 0x%02x", opcode);
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	// Group members are only known from QUERY GROUPS and from the commands that changed them
+	uint64_t targets;
+	if ((address & 0x80) == 0) {
+		targets = (uint64_t) 1 << (address >> 1);
+	} else if ((address & 0xe0) == 0x80) {
+		targets = dalistate_members(state, (address >> 1) & 0x0f);
+	} else if (address >= 0xfe) {
+		targets = ~(uint64_t) 0;
+	} else {
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	unsigned int wait = net_admit(client, conn);
+	if (wait > 0) {
+		log_info("Rate limit exceeded on connection %p, retry in %u msec", conn, wait);
+		net_reply(conn, NET_STATUS_RATE_LIMITED, (uint8_t) (wait >> 8), (uint8_t) wait);
+		return;
+	}
+	Bulk *bulk = malloc(sizeof(Bulk));
+	if (!bulk) {
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	stats_add("net.bulk", 1);
+	memset(bulk, 0, sizeof(Bulk));
+	net_init_client(&bulk->client, NULL);
+	bulk->client.handler = dali_bulk_handler;
+	bulk->client.priority = client->priority;
+	bulk->client.ttl = client->ttl;
+	// Responses read through a bulk query are tracked too
+	bulk->client.slot = client->slot;
+	bulk->requester = client;
+	unsigned long now = monotonic_msec();
+	unsigned int device;
+	for (device = 0; device < DALISTATE_DEVICES; device++) {
+		if (!(targets & ((uint64_t) 1 << device))) {
+			continue;
+		}
+		query.address = (uint8_t) ((device << 1) | 1);
+		if (absent_ttl > 0 && dalistate_absent(state, device, now, absent_ttl)) {
+			bulk->status[device] = NET_BULK_ABSENT;
+		} else if (client->cached && dalicache_lookup(cache, &query, now, &bulk->response[device])) {
+			stats_add("cache.hits", 1);
+			dalicache_track(cache, &query, client->slot);
+			bulk->status[device] = NET_BULK_ANSWERED | NET_BULK_CACHED;
+		} else if (dali) {
+			// All frames are queued at once, so they are sent back to back
+			DaliFramePtr frame = daliframe_clone(&query);
+			// They share the requester's part of the bus and queue
+			UsbDaliError err = frame ? usbdali_queue_owner(dali, frame, bulk->client.priority, bulk->client.ttl, client, &bulk->client) : USBDALI_NO_MEMORY;
+			if (err == USBDALI_SUCCESS) {
+				bulk->status[device] = NET_BULK_SENT;
+				bulk->pending++;
+			} else {
+				daliframe_free(frame);
+				bulk->status[device] = NET_BULK_ERROR;
+			}
+		} else {
+			bulk->status[device] = NET_BULK_ERROR;
+		}
+	}
+	if (bulk->pending == 0) {
+		net_reply_bulk(bulk);
+		free(bulk);
+	} else {
+		list_enqueue(bulks, bulk);
+	}
+}
+
+static void net_reply_bulk(Bulk *bulk) {
+	char data[DALISTATE_DEVICES * 2];
+	unsigned int device;
+	for (device = 0; device < DALISTATE_DEVICES; device++) {
+		data[device * 2] = bulk->status[device];
+		data[device * 2 + 1] = bulk->response[device];
+	}
+	net_reply_data(bulk->requester->conn, data, sizeof(data));
+}
+
+static void net_start_upload(Client *client, ConnectionPtr conn, NetCommand type, uint8_t id, uint8_t length) {
+	if (length == 0) {
+		switch (type) {
+		case NET_TYPE_SCHEDULE:
+			log_info("Deleting scheduled batch %u", id);
+			dalischedule_remove(schedule, id);
+			break;
+		case NET_TYPE_RULE:
+			log_info("Deleting rule %u", id);
+			dalirules_remove(rules, id);
+			break;
+		default:
+			log_info("Deleting program %u", id);
+			daliprogram_free(programs[id]);
+			programs[id] = NULL;
+			break;
+		}
+		net_reply(conn, NET_STATUS_SUCCESS, 0, 0);
+		return;
+	}
+	// The code is sent in whole frames, the rest of the last one is ignored
+	client->upload = malloc((length + 3) & ~3);
+	if (!client->upload) {
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	client->upload_type = type;
+	client->upload_id = id;
+	client->upload_length = length;
+	client->upload_received = 0;
+}
+
+static void net_add_upload(Client *client, ConnectionPtr conn, const char *buffer) {
+	memcpy(&client->upload[client->upload_received], buffer, DEFAULT_NET_FRAMESIZE);
+	client->upload_received += DEFAULT_NET_FRAMESIZE;
+	if (client->upload_received < client->upload_length) {
+		return;
+	}
+	int valid;
+	switch (client->upload_type) {
+	case NET_TYPE_SCHEDULE:
+		valid = net_add_schedule(client->upload_id, client->upload, client->upload_length);
+		break;
+	case NET_TYPE_RULE:
+		valid = net_add_rule(client->upload_id, client->upload, client->upload_length);
+		break;
+	default:
+		valid = net_add_program(client->upload_id, client->upload, client->upload_length);
+		break;
+	}
+	net_reply(conn, valid ? NET_STATUS_SUCCESS : NET_STATUS_ERROR, 0, 0);
+	free(client->upload);
+	client->upload = NULL;
+}
+
+static int net_add_program(uint8_t id, const uint8_t *data, size_t length) {
+	DaliProgramPtr program = daliprogram_new(data, length);
+	if (!program) {
+		log_warn("Invalid program %u uploaded", id);
+		return 0;
+	}
+	log_info("Uploaded program %u (%lu bytes)", id, length);
+	daliprogram_free(programs[id]);
+	programs[id] = program;
+	return 1;
+}
+
+static int net_add_schedule(uint8_t id, const uint8_t *data, size_t length) {
+	if (length < NET_SCHEDULE_HEADER || (length - NET_SCHEDULE_HEADER) % 2 != 0) {
+		log_warn("Invalid batch %u scheduled", id);
+		return 0;
+	}
+	uint8_t flags = data[0];
+	unsigned long when = ((unsigned long) data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4];
+	unsigned long period = ((unsigned long) data[5] << 24) | (data[6] << 16) | (data[7] << 8) | data[8];
+	unsigned long now = monotonic_msec();
+	unsigned long delay = when;
+	if (!(flags & NET_SCHEDULE_RELATIVE)) {
+		// Wall clock times are converted once, the schedule follows the monotonic clock
+		unsigned long wall = (unsigned long) time(NULL);
+		if (when < wall) {
+			if (period == 0) {
+				log_warn("Batch %u scheduled in the past", id);
+				return 0;
+			}
+			// Recurring batches start at their next occurrence
+			when += (wall - when + period - 1) / period * period;
+		}
+		delay = when - wall;
+	}
+	size_t count = (length - NET_SCHEDULE_HEADER) / 2;
+	if (!dalischedule_add(schedule, id, &data[NET_SCHEDULE_HEADER], count, now + delay * 1000, period * 1000)) {
+		log_warn("Invalid batch %u scheduled", id);
+		return 0;
+	}
+	log_info("Scheduled batch %u of %lu frames in %lu sec, every %lu sec", id, count, delay, period);
+	return 1;
+}
+
+static int net_add_rule(uint8_t id, const uint8_t *data, size_t length) {
+	if (length < NET_RULE_HEADER || (length - NET_RULE_HEADER) % 2 != 0) {
+		log_warn("Invalid rule %u uploaded", id);
+		return 0;
+	}
+	DaliRulePattern pattern = { data[0], data[1], data[2], data[3], data[4], data[5] };
+	size_t count = (length - NET_RULE_HEADER) / 2;
+	if (!dalirules_add(rules, id, &pattern, &data[NET_RULE_HEADER], count)) {
+		log_warn("Invalid rule %u uploaded, or not enough memory", id);
+		return 0;
+	}
+	log_info("Added rule %u for (0x%02x/0x%02x 0x%02x/0x%02x 0x%02x/0x%02x) with %lu frames", id, data[0], data[1], data[2], data[3], data[4], data[5], count);
+	return 1;
+}
+
+static void net_run_program(UsbDaliPtr dali, Client *client, uint8_t id, uint8_t x) {
+	ConnectionPtr conn = client->conn;
+	if (!programs[id]) {
+		log_warn("Program %u doesn't exist", id);
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	// A program counts as one request, like a bulk query
+	unsigned int wait = net_admit(client, conn);
+	if (wait > 0) {
+		log_info("Rate limit exceeded on connection %p, retry in %u msec", conn, wait);
+		net_reply(conn, NET_STATUS_RATE_LIMITED, (uint8_t) (wait >> 8), (uint8_t) wait);
+		return;
+	}
+	Task *task = malloc(sizeof(Task));
+	if (!task) {
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	task->run = dalirun_new(programs[id], state, x);
+	if (!task->run) {
+		free(task);
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	stats_add("net.programs", 1);
+	log_debug("Running program %u with X=%u for connection %p", id, x, conn);
+	net_init_client(&task->client, NULL);
+	task->client.handler = dali_task_handler;
+	task->client.priority = client->priority;
+	task->client.ttl = client->ttl;
+	task->client.slot = client->slot;
+	task->requester = client;
+	task->dali = dali;
+	task->pending = 0;
+	task->failed = 0;
+	list_enqueue(tasks, task);
+	net_step_task(task);
+}
+
+static void net_step_task(Task *task) {
+	Client *client = task->requester;
+	DaliFramePtr frames[DALIRUN_MAX_SEQUENCE];
+	size_t count;
+	DaliRunStatus status;
+	// Frames that can be answered without the bus don't return to the event loop
+	while ((status = dalirun_step(task->run, frames, &count)) == DALIRUN_SEND) {
+		DaliFramePtr frame = frames[count - 1];
+		unsigned long now = monotonic_msec();
+		uint8_t response;
+		int query = count == 1 && daliframe_classify(frame) == DALIFRAME_CLASS_QUERY;
+		size_t i;
+		if (query && absent_ttl > 0 && (frame->address & 0x80) == 0 && dalistate_absent(state, frame->address >> 1, now, absent_ttl)) {
+			stats_add("state.absent", 1);
+			dalirun_response(task->run, DALIRUN_NO_RESPONSE);
+		} else if (query && client->cached && dalicache_lookup(cache, frame, now, &response)) {
+			stats_add("cache.hits", 1);
+			dalicache_track(cache, frame, client->slot);
+			dalirun_response(task->run, response);
+		} else if (task->dali) {
+			for (i = 0; i < count; i++) {
+				dalicache_invalidate(cache, frames[i], now);
+			}
+			UsbDaliError err;
+			if (count > 1) {
+				// DTR writes and the commands that use them, see dalirun_step
+				err = usbdali_queue_sequence_owner(task->dali, frames, count, 100, task->client.priority, task->client.ttl, task->requester, &task->client);
+			} else {
+				err = usbdali_queue_owner(task->dali, frame, task->client.priority, task->client.ttl, task->requester, &task->client);
+			}
+			if (err == USBDALI_SUCCESS) {
+				// Continued in dali_task_handler
+				task->pending = (unsigned int) count;
+				task->failed = 0;
+				return;
+			}
+			log_warn("Can't queue program frame: %s", usbdali_error_string(err));
+			dalirun_response(task->run, DALIRUN_SEND_FAILED);
+		} else {
+			dalirun_response(task->run, DALIRUN_SEND_FAILED);
+		}
+		for (i = 0; i < count; i++) {
+			daliframe_free(frames[i]);
+		}
+	}
+	if (status == DALIRUN_DONE) {
+		const uint8_t *results;
+		size_t length = dalirun_results(task->run, &results);
+		net_reply_data(client->conn, (const char *) results, length);
+	} else {
+		log_warn("Program stopped with an error on connection %p", client->conn);
+		net_reply(client->conn, NET_STATUS_ERROR, 0, 0);
+	}
+	net_free_task(task);
+}
+
+static void net_free_task(Task *task) {
+	ListNodePtr node = list_find(tasks, list_equal, task);
+	if (node) {
+		list_remove(tasks, node);
+	}
+	dalirun_free(task->run);
+	free(task);
+}
+
+static void net_start_commission(UsbDaliPtr dali, Client *client, uint8_t flags) {
+	ConnectionPtr conn = client->conn;
+	if (commission || !dali) {
+		log_warn("Can't start address assignment, %s", commission ? "it is running already" : "there is no bus");
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	// Addresses of devices that keep theirs can't be assigned again
+	uint64_t used = (flags & DALICOMMISSION_UNADDRESSED) ? dalistate_inventory(state, DALISTATE_PRESENT) : 0;
+	Commission *run = malloc(sizeof(Commission));
+	if (!run) {
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	run->engine = dalicommission_new(flags & (DALICOMMISSION_UNADDRESSED | DALICOMMISSION_FAST), used);
+	if (!run->engine) {
+		free(run);
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	stats_add("net.commissions", 1);
+	log_info("Starting address assignment for connection %p", conn);
+	net_init_client(&run->client, NULL);
+	run->client.handler = dali_commission_handler;
+	run->client.priority = client->priority;
+	run->requester = client;
+	run->dali = dali;
+	run->pending = 0;
+	run->reported = 0;
+	commission = run;
+	net_step_commission(run);
+}
+
+static void net_step_commission(Commission *run) {
+	ConnectionPtr conn = run->requester->conn;
+	const DaliCommissionDevice *devices;
+	size_t count = dalicommission_devices(run->engine, &devices);
+	for (; run->reported < count; run->reported++) {
+		log_info("Device with random address 0x%06x is now %u", devices[run->reported].random, devices[run->reported].address);
+		net_reply(conn, NET_STATUS_PROGRESS, devices[run->reported].address, (uint8_t) (run->reported + 1));
+		if (commission != run) {
+			// The write failed, the connection was removed and the assignment stopped with it
+			return;
+		}
+	}
+	DaliFramePtr frame;
+	int twice;
+	DaliCommissionStatus status;
+	while ((status = dalicommission_step(run->engine, &frame, &twice)) == DALICOMMISSION_SEND) {
+		UsbDaliError err;
+		if (twice) {
+			DaliFramePtr frames[2] = { frame, daliframe_clone(frame) };
+			err = frames[1] ? usbdali_queue_sequence(run->dali, frames, 2, 100, run->client.priority, 0, &run->client) : USBDALI_NO_MEMORY;
+			if (err != USBDALI_SUCCESS) {
+				daliframe_free(frames[1]);
+			}
+		} else {
+			err = usbdali_queue(run->dali, frame, run->client.priority, 0, &run->client);
+		}
+		if (err == USBDALI_SUCCESS) {
+			// Continued in dali_commission_handler
+			run->pending = twice ? 2 : 1;
+			return;
+		}
+		log_warn("Can't queue address assignment frame: %s", usbdali_error_string(err));
+		daliframe_free(frame);
+		dalicommission_response(run->engine, DALICOMMISSION_SEND_FAILED);
+	}
+	// Finished, a failed reply must not stop it again
+	commission = NULL;
+	if (status == DALICOMMISSION_DONE) {
+		log_info("Address assignment complete, %lu devices in %lu frames", count, dalicommission_frames(run->engine));
+		char data[64 * 5];
+		size_t i;
+		for (i = 0; i < count; i++) {
+			data[i * 5] = devices[i].address;
+			data[i * 5 + 1] = devices[i].verified ? 0x01 : 0x00;
+			data[i * 5 + 2] = (uint8_t) (devices[i].random >> 16);
+			data[i * 5 + 3] = (uint8_t) (devices[i].random >> 8);
+			data[i * 5 + 4] = (uint8_t) devices[i].random;
+		}
+		net_reply_data(conn, data, count * 5);
+	} else {
+		log_warn("Address assignment failed");
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+	}
+	// The devices that are present have changed
+	UsbDaliPtr dali = run->dali;
+	dalicommission_free(run->engine);
+	free(run);
+	dali_inventory_start(dali);
+}
+
+static void net_stop_commission(Commission *run) {
+	log_info("Stopping address assignment");
+	usbdali_cancel(run->dali, &run->client);
+	// Make sure the devices leave initialisation mode
+	DaliFramePtr terminate = daliframe_new(0xa1, 0x00);
+	if (terminate && usbdali_queue(run->dali, terminate, DALIQUEUE_PRIORITY_INTERACTIVE, 0, NULL) != USBDALI_SUCCESS) {
+		daliframe_free(terminate);
+	}
+	dalicommission_free(run->engine);
+	free(run);
+	commission = NULL;
+}
+
+static void net_reply(ConnectionPtr conn, uint8_t status, uint8_t data0, uint8_t data1) {
+	char rbuffer[DEFAULT_NET_FRAMESIZE];
+	rbuffer[0] = DEFAULT_NET_PROTOCOL;
+	rbuffer[1] = status;
+	rbuffer[2] = data0;
+	rbuffer[3] = data1;
+	connection_reply(conn, rbuffer, sizeof(rbuffer));
+}
+
+static void net_reply_busy(ConnectionPtr conn, UsbDaliPtr dali) {
+	stats_add("net.busy", 1);
+	size_t depth = usbdali_get_queue_length(dali);
+	// The estimated wait is sent in units of 100 msec, rounded up
+	unsigned long wait = (usbdali_get_queue_wait(dali) + 99) / 100;
+	net_reply(conn, NET_STATUS_BUSY, (uint8_t) (depth > 0xff ? 0xff : depth), (uint8_t) (wait > 0xff ? 0xff : wait));
+}
+
+static void net_init_client(Client *client, ConnectionPtr conn) {
+	client->conn = conn;
+	client->handler = NULL;
+	client->priority = DALIQUEUE_PRIORITY_NORMAL;
+	client->ttl = 0;
+	client->cached = 1;
+	client->slot = -1;
+	client->events = 0;
+	tokenbucket_init(&client->limit, connection_rate, connection_burst, monotonic_msec());
+	client->sequence_length = 0;
+	client->sequence_expected = 0;
+	client->sequence_gap = 0;
+	client->upload = NULL;
+	client->upload_type = NET_TYPE_UPLOAD;
+	client->upload_id = 0;
+	client->upload_length = 0;
+	client->upload_received = 0;
+}
+
+static Client *net_get_client(ConnectionPtr conn) {
+	Client *client = (Client *) connection_get_data(conn);
+	if (!client) {
+		client = malloc(sizeof(Client));
+		if (client) {
+			net_init_client(client, conn);
+			connection_set_data(conn, client);
+		}
+	}
+	return client;
+}
+
+static void net_send_inventory(UsbDaliPtr dali, ConnectionPtr conn, uint8_t flags) {
+	if (flags & NET_INVENTORY_SCAN) {
+		dali_inventory_start(dali);
+	}
+	uint64_t present = dalistate_inventory(state, DALISTATE_PRESENT);
+	uint64_t absent = dalistate_inventory(state, DALISTATE_ABSENT);
+	char data[16];
+	unsigned int i;
+	for (i = 0; i < 8; i++) {
+		data[i] = (uint8_t) (present >> (56 - i * 8));
+		data[8 + i] = (uint8_t) (absent >> (56 - i * 8));
+	}
+	net_reply_data(conn, data, sizeof(data));
+}
+
+static int net_set_option(Client *client, ConnectionPtr conn, uint8_t option, uint8_t value) {
+	switch (option) {
+	case NET_OPTION_PRIORITY:
+		// Clients can't use the reserved classes before interactive
+		if (value < DALIQUEUE_PRIORITIES - DALIQUEUE_PRIORITY_INTERACTIVE) {
+			log_debug("Setting connection priority to %u", value);
+			client->priority = (DaliQueuePriority) (value + DALIQUEUE_PRIORITY_INTERACTIVE);
+			return 1;
+		}
+		break;
+	case NET_OPTION_TTL:
+		log_debug("Setting connection TTL to %u00 msec", value);
+		client->ttl = value * 100;
+		return 1;
+	case NET_OPTION_CACHE:
+		if (value <= 1) {
+			log_debug("%s response cache", value ? "Enabling" : "Disabling");
+			client->cached = value;
+			return 1;
+		}
+		break;
+	case NET_OPTION_TRACKING:
+		if (value == 0) {
+			if (client->slot >= 0) {
+				log_debug("Disabling response tracking");
+				dalicache_unsubscribe(cache, client->slot);
+				trackers[client->slot] = NULL;
+				client->slot = -1;
+			}
+			return 1;
+		}
+		if (value == 1) {
+			if (client->slot < 0) {
+				client->slot = dalicache_subscribe(cache);
+				if (client->slot < 0) {
+					log_warn("No free tracking slots");
+					return 0;
+				}
+				log_debug("Enabling response tracking in slot %d", client->slot);
+				trackers[client->slot] = conn;
+			}
+			return 1;
+		}
+		break;
+	case NET_OPTION_EVENTS:
+		if (value <= 1) {
+			log_debug("%s polling events", value ? "Enabling" : "Disabling");
+			if (value && !client->events) {
+				list_enqueue(listeners, conn);
+			} else if (!value && client->events) {
+				list_remove(listeners, list_find(listeners, list_equal, conn));
+			}
+			client->events = value;
+			return 1;
+		}
+		break;
+	}
+	return 0;
+}
+
+static unsigned int net_admit(Client *client, ConnectionPtr conn) {
+	unsigned long now = monotonic_msec();
+	// The connection limit comes first, so a single client can't use up the allowance of its host
+	unsigned int wait = tokenbucket_take(&client->limit, now);
+	if (wait > 0) {
+		stats_add("net.limited.connection", 1);
+	} else {
+		wait = ratelimit_table_take(address_limits, connection_get_address(conn), now);
+		if (wait > 0) {
+			stats_add("net.limited.address", 1);
+		}
+	}
+	if (wait > 0xffff) {
+		wait = 0xffff;
+	}
+	return wait;
+}
+
+static int net_reply_cached(Client *client, ConnectionPtr conn, DaliFramePtr frame) {
+	if (cache && daliframe_classify(frame) == DALIFRAME_CLASS_QUERY) {
+		uint8_t response;
+		if (client->cached && dalicache_lookup(cache, frame, monotonic_msec(), &response)) {
+			log_info("Cached response to (0x%02x 0x%02x): 0x%02x", frame->address, frame->command, response);
+			stats_add("cache.hits", 1);
+			dalicache_track(cache, frame, client->slot);
+			net_reply(conn, NET_STATUS_RESPONSE, response, 0);
+			return 1;
+		}
+		stats_add("cache.misses", 1);
+	}
+	return 0;
+}
+
+static void net_send_stats(ConnectionPtr conn) {
+	stats_set("net.limited.hosts", ratelimit_table_length(address_limits));
+	unsigned long hits = stats_get("cache.hits");
+	unsigned long misses = stats_get("cache.misses");
+	if (hits + misses > 0) {
+		// In percent
+		stats_set("cache.hitrate", hits * 100 / (hits + misses));
+	}
+	size_t length = stats_dump(NULL, 0);
+	if (length > 0xffff) {
+		length = 0xffff;
+	}
+	// stats_dump needs room for the terminating null byte
+	char *data = malloc(length + 1);
+	if (!data) {
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	stats_dump(data, length + 1);
+	net_reply_data(conn, data, length);
+	free(data);
+}
+
+static void net_send_state(ConnectionPtr conn) {
+	if (!state) {
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	char data[DALISTATE_PACKED_SIZE];
+	dalistate_pack(state, data, sizeof(data));
+	net_reply_data(conn, data, sizeof(data));
+}
+
+static void net_reply_data(ConnectionPtr conn, const char *data, size_t length) {
+	char *rbuffer = malloc(DEFAULT_NET_FRAMESIZE + length);
+	if (!rbuffer) {
+		net_reply(conn, NET_STATUS_ERROR, 0, 0);
+		return;
+	}
+	rbuffer[0] = DEFAULT_NET_PROTOCOL;
+	rbuffer[1] = NET_STATUS_DATA;
+	rbuffer[2] = (uint8_t) (length >> 8);
+	rbuffer[3] = (uint8_t) length;
+	memcpy(&rbuffer[DEFAULT_NET_FRAMESIZE], data, length);
+	connection_reply(conn, rbuffer, DEFAULT_NET_FRAMESIZE + length);
+	free(rbuffer);
+}
+
 void net_dequeue_connection(void *arg, ConnectionPtr conn) {
-	if (arg && conn) {
-		log_debug("Dequeueing connection %p", conn);
-		UsbDaliPtr usb = (UsbDaliPtr) arg;
-		usbdali_cancel(usb, conn);
+	if (conn) {
+		Client *client = (Client *) connection_get_data(conn);
+		if (arg && client) {
+			log_debug("Dequeueing connection %p", conn);
+			UsbDaliPtr usb = (UsbDaliPtr) arg;
+			usbdali_cancel(usb, client);
+			// Nobody is left to receive the results of its bulk queries
+			ListNodePtr node = list_first(bulks);
+			while (node) {
+				ListNodePtr next = list_next(node);
+				Bulk *bulk = (Bulk *) list_data(node);
+				if (bulk->requester == client) {
+					usbdali_cancel(usb, &bulk->client);
+					list_remove(bulks, node);
+					free(bulk);
+				}
+				node = next;
+			}
+			// Its programs are stopped, the frame on the bus is finished without them
+			node = list_first(tasks);
+			while (node) {
+				ListNodePtr next = list_next(node);
+				Task *task = (Task *) list_data(node);
+				if (task->requester == client) {
+					usbdali_cancel(usb, &task->client);
+					net_free_task(task);
+				}
+				node = next;
+			}
+			if (commission && commission->requester == client) {
+				net_stop_commission(commission);
+			}
+		}
+		if (client && client->slot >= 0) {
+			dalicache_unsubscribe(cache, client->slot);
+			trackers[client->slot] = NULL;
+		}
+		if (client && client->events) {
+			list_remove(listeners, list_find(listeners, list_equal, conn));
+		}
+		if (client) {
+			net_abort_sequence(client, NULL, 0, 0, 0);
+			free(client->upload);
+		}
+		free(client);
+		connection_set_data(conn, NULL);
 	}
 }
 
@@ -313,12 +1827,24 @@ static Options *parse_opt(int argc, char *const argv[]) {
 	opts->logfile = NULL;
 	opts->background = 0;
 	opts->pidfile = NULL;
+	opts->board = NULL;
+	opts->inventory = NULL;
+	opts->absentttl = DEFAULT_ABSENT_TTL;
 	opts->usbbus = -1;
 	opts->usbdev = -1;
+	opts->connrate = 0;
+	opts->connburst = 0;
+	opts->addrrate = 0;
+	opts->addrburst = 0;
+	opts->cancelclasses = 1 << DALIFRAME_CLASS_QUERY;
+	opts->pollsets = 0;
+	opts->pollcycle = DEFAULT_POLL_CYCLE;
+	opts->polltarget = DEFAULT_POLL_TARGET;
+	opts->groupwindow = 0;
 
 	int opt;
 	opterr = 0;
-	while ((opt = getopt(argc, argv, "d:l:p:nsf:br:u:")) != -1) {
+	while ((opt = getopt(argc, argv, "d:l:p:nsf:br:u:c:a:k:m:i:t:q:Q:g:")) != -1) {
 		switch (opt) {
 		case 'd':
 			if (strcmp(optarg, "fatal") == 0) {
@@ -370,6 +1896,58 @@ static Options *parse_opt(int argc, char *const argv[]) {
 				return NULL;
 			}
 			break;
+		case 'c':
+			if (!split_rate(optarg, &opts->connrate, &opts->connburst)) {
+				free_opt(opts);
+				return NULL;
+			}
+			break;
+		case 'a':
+			if (!split_rate(optarg, &opts->addrrate, &opts->addrburst)) {
+				free_opt(opts);
+				return NULL;
+			}
+			break;
+		case 'k':
+			if (!split_classes(optarg, &opts->cancelclasses)) {
+				free_opt(opts);
+				return NULL;
+			}
+			break;
+		case 'i':
+			free(opts->inventory);
+			opts->inventory = strdup(optarg);
+			break;
+		case 't':
+			opts->absentttl = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			opts->groupwindow = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			if (!split_poll(optarg, opts)) {
+				free_opt(opts);
+				return NULL;
+			}
+			break;
+		case 'Q': {
+			unsigned int cycle, target;
+			if (!split_rate(optarg, &cycle, &target) || target > 100) {
+				free_opt(opts);
+				return NULL;
+			}
+			opts->pollcycle = cycle;
+			if (strchr(optarg, ':')) {
+				opts->polltarget = target;
+			}
+			break;
+		}
+#ifdef HAVE_SHM_OPEN
+		case 'm':
+			free(opts->board);
+			opts->board = strdup(optarg);
+			break;
+#endif
 		default:
 			free_opt(opts);
 			return NULL;
@@ -384,6 +1962,8 @@ static void free_opt(Options *opts) {
 		free(opts->address);
 		free(opts->logfile);
 		free(opts->pidfile);
+		free(opts->board);
+		free(opts->inventory);
 		free(opts);
 	}
 }
@@ -404,8 +1984,111 @@ static int split_usbdev(const char *arg, int *usbbus, int *usbdev) {
 	return 0;
 }
 
+static int split_rate(const char *arg, unsigned int *rate, unsigned int *burst) {
+	if (arg && rate && burst) {
+		char *end;
+		long r = strtol(arg, &end, 0);
+		long b = 0;
+		if (*end == ':') {
+			b = strtol(end + 1, &end, 0);
+		}
+		if (*end == 0 && r >= 0 && r <= 0xffff && b >= 0 && b <= 0xffff) {
+			*rate = (unsigned int) r;
+			*burst = (unsigned int) b;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int split_classes(const char *arg, unsigned int *classes) {
+	if (arg && classes) {
+		unsigned int mask = 0;
+		if (strcmp(arg, "none") != 0) {
+			const char *start = arg;
+			while (*start) {
+				size_t length = strcspn(start, ",");
+				DaliFrameClass cls;
+				for (cls = 0; cls < DALIFRAME_CLASSES; cls++) {
+					const char *name = daliframe_class_name(cls);
+					if (strlen(name) == length && strncmp(start, name, length) == 0) {
+						break;
+					}
+				}
+				if (cls == DALIFRAME_CLASSES) {
+					return 0;
+				}
+				mask |= 1 << cls;
+				start += length;
+				if (*start == ',') {
+					start++;
+				}
+			}
+		}
+		*classes = mask;
+		return 1;
+	}
+	return 0;
+}
+
+static int split_poll(const char *arg, Options *opts) {
+	if (arg && opts && opts->pollsets < DALIPOLLER_MAX_SETS) {
+		size_t set = opts->pollsets;
+		size_t count = 0;
+		const char *start = arg;
+		while (*start && *start != '@') {
+			char *end;
+			long query = strtol(start, &end, 0);
+			if (end == start || query < 0 || query > 0xff || count >= DALIPOLLER_MAX_QUERIES) {
+				return 0;
+			}
+			opts->pollqueries[set][count++] = (uint8_t) query;
+			start = end;
+			if (*start == ',') {
+				start++;
+			}
+		}
+		opts->polldevices[set] = 0;
+		if (*start == '@' && !split_devices(start + 1, &opts->polldevices[set])) {
+			return 0;
+		}
+		if (count > 0) {
+			opts->pollcount[set] = count;
+			opts->pollsets++;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int split_devices(const char *arg, uint64_t *devices) {
+	uint64_t mask = 0;
+	while (*arg) {
+		char *end;
+		long first = strtol(arg, &end, 0);
+		long last = first;
+		if (*end == '-') {
+			last = strtol(end + 1, &end, 0);
+		}
+		if (end == arg || first < 0 || last > 63 || first > last) {
+			return 0;
+		}
+		for (; first <= last; first++) {
+			mask |= 1ULL << first;
+		}
+		arg = end;
+		if (*arg == ',') {
+			arg++;
+		} else if (*arg) {
+			return 0;
+		}
+	}
+	*devices = mask;
+	return mask != 0;
+}
+
 static void show_help() {
-	fprintf(stderr, "Usage: daliserver [-d <loglevel>] [-l <address>] [-p <port>] [-n]\n");
+	fprintf(stderr, "Usage: daliserver [-d <loglevel>] [-l <address>] [-p <port>] [-n] [-c <rate[:burst]>] [-a <rate[:burst]>] [-k <classes>] [-m <name>] [-i <file>] [-t <sec>] [-q <queries[@devices]>] [-Q <sec[:percent]>] [-g <msec>]\n");
 	fprintf(stderr, "\n");
 	if (log_debug_enabled()) {
 		fprintf(stderr, "-d <loglevel> Set the logging level (fatal, error, warn, info, debug, default=info)\n");
@@ -426,6 +2109,21 @@ static void show_help() {
 	fprintf(stderr, "-b            Fork into background (implies -r)\n");
 	fprintf(stderr, "-r <file>     Save PID to file (default=/var/run/daliserver.pid)\n");
 	fprintf(stderr, "-u <bus:dev>  Only drive the USB device at bus:dev\n");
+	fprintf(stderr, "-c <rate[:burst]> Limit the DALI commands per second of each connection\n");
+	fprintf(stderr, "-a <rate[:burst]> Limit the DALI commands per second of each remote address\n");
+	fprintf(stderr, "-k <classes>  Drop queued commands of these classes when their client disconnects\n");
+	fprintf(stderr, "              (comma separated list of arc, command, config, query, special or none, default=query)\n");
+	fprintf(stderr, "-i <file>     Save the devices found on the bus to file and load them on startup\n");
+	fprintf(stderr, "-t <sec>      Reject queries to absent devices for this long (default=600, 0=never)\n");
+	fprintf(stderr, "-q <queries[@devices]> Poll the status of devices in the background, may be repeated\n");
+	fprintf(stderr, "              (like 0x90,0x92@0-15, default devices=all present ones)\n");
+	fprintf(stderr, "-Q <sec[:percent]> Start a polling cycle at most every sec seconds, and fill the bus\n");
+	fprintf(stderr, "              up to percent utilization (default=60:50)\n");
+	fprintf(stderr, "-g <msec>     Wait this long for commands to single devices that can be merged\n");
+	fprintf(stderr, "              into one group or broadcast command (default=0, no merging)\n");
+#ifdef HAVE_SHM_OPEN
+	fprintf(stderr, "-m <name>     Publish the device state in the shared memory segment name (like /daliserver)\n");
+#endif
 	fprintf(stderr, "\n");
 }
 
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "board.h"
+
+int main(int argc, char **argv) {
+	printf("Test 1: Publish and read\n");
+
+	char name[32];
+	snprintf(name, sizeof(name), "/testboard%d", (int) getpid());
+	DaliBoardPtr board = daliboard_new(name);
+	if (!board) {
+		printf("Shared memory not available, skipping\n");
+		return 0;
+	}
+	const DaliBoardData *data = daliboard_attach(name);
+	if (!data) {
+		printf("Can't attach to board\n");
+		return 1;
+	}
+	DaliBoardData copy;
+	uint32_t sequence = daliboard_snapshot(data, &copy);
+	if (copy.devices != DALISTATE_DEVICES || copy.device[5].flags != 0) {
+		printf("Board not empty\n");
+		return 1;
+	}
+
+	DaliStatePtr state = dalistate_new();
+	// Set device 5 to 100, add it to group 2
+	DaliFramePtr frame = daliframe_new(0x0a, 100);
+	dalistate_command(state, frame, 1234);
+	daliframe_free(frame);
+	frame = daliframe_new(0x0b, 0x62);
+	dalistate_command(state, frame, 1235);
+	daliframe_free(frame);
+	daliboard_update(board, state);
+
+	uint32_t next = daliboard_snapshot(data, &copy);
+	if (next != sequence + 2 || (next & 1)) {
+		printf("Wrong sequence: %u %u\n", sequence, next);
+		return 1;
+	}
+	if (!(copy.device[5].flags & DALISTATE_LEVEL) || copy.device[5].level != 100 || copy.device[5].groups != 0x4 || copy.device[5].changed != 1235) {
+		printf("Wrong device state\n");
+		return 1;
+	}
+
+	printf("Test 2: Removal\n");
+
+	daliboard_detach(data);
+	dalistate_free(state);
+	daliboard_free(board);
+	if (daliboard_attach(name)) {
+		printf("Board not removed\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include "cache.h"
+
+static int lookup(DaliCachePtr cache, uint8_t address, uint8_t command, unsigned long now, uint8_t *response) {
+	DaliFramePtr frame = daliframe_new(address, command);
+	int ret = dalicache_lookup(cache, frame, now, response);
+	daliframe_free(frame);
+	return ret;
+}
+
+static void store(DaliCachePtr cache, uint8_t address, uint8_t command, uint8_t response, unsigned long now) {
+	DaliFramePtr frame = daliframe_new(address, command);
+	dalicache_store(cache, frame, response, now);
+	daliframe_free(frame);
+}
+
+static unsigned int notified;
+static uint8_t notified_address;
+static uint64_t notified_slots;
+
+static void invalidated(unsigned int slot, uint8_t address, uint8_t opcode, void *arg) {
+	notified++;
+	notified_address = address;
+	notified_slots |= (uint64_t) 1 << slot;
+}
+
+static void track(DaliCachePtr cache, uint8_t address, uint8_t command, int slot) {
+	DaliFramePtr frame = daliframe_new(address, command);
+	dalicache_track(cache, frame, slot);
+	daliframe_free(frame);
+}
+
+static unsigned int invalidate(DaliCachePtr cache, uint8_t address, uint8_t command, unsigned long now) {
+	DaliFramePtr frame = daliframe_new(address, command);
+	unsigned int ret = dalicache_invalidate(cache, frame, now);
+	daliframe_free(frame);
+	return ret;
+}
+
+int main(int argc, char **argv) {
+	printf("Test 1: Lookup and expiry\n");
+
+	DaliCachePtr cache = dalicache_new();
+	uint8_t response = 0;
+	// Actual level of device 1
+	store(cache, 0x03, 0xa0, 0x80, 1000);
+	if (!lookup(cache, 0x03, 0xa0, 1000, &response) || response != 0x80) {
+		printf("Stored response not found\n");
+		return 1;
+	}
+	if (lookup(cache, 0x05, 0xa0, 1000, &response) || lookup(cache, 0x03, 0xa1, 1000, &response)) {
+		printf("Response found for the wrong query\n");
+		return 1;
+	}
+	if (lookup(cache, 0x03, 0xa0, 1000 + dalicache_ttl(0xa0), &response)) {
+		printf("Expired response found\n");
+		return 1;
+	}
+	// DTR contents, group queries and commands are never cached
+	store(cache, 0x03, 0x98, 0x10, 1000);
+	store(cache, 0x81, 0xa0, 0x10, 1000);
+	store(cache, 0x03, 0x05, 0x10, 1000);
+	if (lookup(cache, 0x03, 0x98, 1000, &response) || lookup(cache, 0x81, 0xa0, 1000, &response) || lookup(cache, 0x03, 0x05, 1000, &response)) {
+		printf("Uncacheable response found\n");
+		return 1;
+	}
+
+	printf("Test 2: Short address invalidation\n");
+
+	store(cache, 0x03, 0xa0, 0x80, 2000);
+	store(cache, 0x03, 0xa1, 0xfe, 2000);
+	store(cache, 0x05, 0xa0, 0x40, 2000);
+	// Recall max level on device 1
+	if (invalidate(cache, 0x03, 0x05, 2000) != 1) {
+		printf("Wrong number of devices invalidated\n");
+		return 1;
+	}
+	if (lookup(cache, 0x03, 0xa0, 2000, &response)) {
+		printf("Level not invalidated\n");
+		return 1;
+	}
+	if (!lookup(cache, 0x03, 0xa1, 2000, &response) || !lookup(cache, 0x05, 0xa0, 2000, &response)) {
+		printf("Unrelated response invalidated\n");
+		return 1;
+	}
+	// Store DTR as max level
+	invalidate(cache, 0x03, 0x2a, 2000);
+	if (lookup(cache, 0x03, 0xa1, 2000, &response)) {
+		printf("Configuration not invalidated\n");
+		return 1;
+	}
+	// Queries change nothing
+	if (invalidate(cache, 0x05, 0xa0, 2000) != 0 || !lookup(cache, 0x05, 0xa0, 2000, &response)) {
+		printf("Query invalidated the cache\n");
+		return 1;
+	}
+
+	printf("Test 3: Group invalidation\n");
+
+	dalicache_clear(cache);
+	// Device 1 is in group 2, device 2 in no group, membership of device 3 is unknown
+	store(cache, 0x03, 0xc0, 0x04, 3000);
+	store(cache, 0x03, 0xc1, 0x00, 3000);
+	store(cache, 0x05, 0xc0, 0x00, 3000);
+	store(cache, 0x05, 0xc1, 0x00, 3000);
+	store(cache, 0x03, 0xa0, 0x80, 3000);
+	store(cache, 0x05, 0xa0, 0x80, 3000);
+	store(cache, 0x07, 0xa0, 0x80, 3000);
+	// Off on group 2
+	if (invalidate(cache, 0x85, 0x00, 3000) != 63) {
+		printf("Wrong number of devices invalidated\n");
+		return 1;
+	}
+	if (lookup(cache, 0x03, 0xa0, 3000, &response) || lookup(cache, 0x07, 0xa0, 3000, &response)) {
+		printf("Group members not invalidated\n");
+		return 1;
+	}
+	if (!lookup(cache, 0x05, 0xa0, 3000, &response) || !lookup(cache, 0x03, 0xc0, 3000, &response)) {
+		printf("Non-member invalidated\n");
+		return 1;
+	}
+
+	printf("Test 4: Broadcast and special command invalidation\n");
+
+	invalidate(cache, 0xff, 0x05, 4000);
+	if (lookup(cache, 0x05, 0xa0, 4000, &response) || !lookup(cache, 0x05, 0xc0, 4000, &response)) {
+		printf("Broadcast invalidated the wrong responses\n");
+		return 1;
+	}
+	// Setting the DTR changes nothing, initialise changes everything
+	store(cache, 0x05, 0xa0, 0x80, 4000);
+	if (invalidate(cache, 0xa3, 0x10, 4000) != 0 || !lookup(cache, 0x05, 0xa0, 4000, &response)) {
+		printf("DTR invalidated the cache\n");
+		return 1;
+	}
+	invalidate(cache, 0xa5, 0x00, 4000);
+	if (lookup(cache, 0x05, 0xa0, 4000, &response) || lookup(cache, 0x05, 0xc0, 4000, &response)) {
+		printf("Special command didn't clear the cache\n");
+		return 1;
+	}
+
+	printf("Test 5: Tracking\n");
+
+	dalicache_set_invalidate_callback(cache, invalidated, NULL);
+	int slot1 = dalicache_subscribe(cache);
+	int slot2 = dalicache_subscribe(cache);
+	if (slot1 != 0 || slot2 != 1) {
+		printf("Wrong slots: %d %d\n", slot1, slot2);
+		return 1;
+	}
+	// Both read the level of device 1, only the second one the max level
+	store(cache, 0x03, 0xa0, 0x80, 5000);
+	store(cache, 0x03, 0xa1, 0xfe, 5000);
+	track(cache, 0x03, 0xa0, slot1);
+	track(cache, 0x03, 0xa0, slot2);
+	track(cache, 0x03, 0xa1, slot2);
+	// A command to another device doesn't concern them
+	invalidate(cache, 0x05, 0x00, 5000);
+	if (notified != 0) {
+		printf("Unrelated command notified\n");
+		return 1;
+	}
+	invalidate(cache, 0x03, 0x00, 5000);
+	if (notified != 2 || notified_address != 0x03 || notified_slots != 0x3) {
+		printf("Wrong notifications: %u %02x %llx\n", notified, notified_address, (unsigned long long) notified_slots);
+		return 1;
+	}
+	// Notifications are sent once until the response is read again
+	invalidate(cache, 0x03, 0x00, 5000);
+	if (notified != 2) {
+		printf("Notified twice\n");
+		return 1;
+	}
+	// A changed response notifies, even if it wasn't caused by a command
+	notified = 0;
+	notified_slots = 0;
+	store(cache, 0x03, 0x90, 0x04, 5000);
+	track(cache, 0x03, 0x90, slot1);
+	store(cache, 0x03, 0x90, 0x04, 10000);
+	store(cache, 0x03, 0x90, 0x06, 11000);
+	if (notified != 1 || notified_slots != 0x1) {
+		printf("Changed response not notified\n");
+		return 1;
+	}
+	// Unsubscribed slots are freed and forgotten
+	dalicache_unsubscribe(cache, slot2);
+	if (dalicache_subscribe(cache) != slot2) {
+		printf("Slot not reused\n");
+		return 1;
+	}
+	invalidate(cache, 0x03, 0x2a, 12000);
+	if (notified != 1) {
+		printf("Unsubscribed slot notified\n");
+		return 1;
+	}
+
+	dalicache_free(cache);
+
+	return 0;
+}
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "commission.h"
+
+// A simulated bus with devices that implement the random address search
+typedef struct {
+	uint32_t random;
+	// 0xff if the device has no short address
+	uint8_t address;
+	int initialised;
+	int withdrawn;
+} Device;
+
+typedef struct {
+	Device devices[64];
+	size_t count;
+	uint32_t search;
+	unsigned long frames;
+	unsigned int seed;
+	// Identical answers of several devices don't collide
+	int identical;
+} Bus;
+
+// Average bus time of a frame with settling time, and of a frame with a backward frame
+static const unsigned int FORWARD_TIME = 25; //msec
+static const unsigned int BACKWARD_TIME = 35; //msec
+
+static unsigned int next_random(Bus *bus) {
+	bus->seed = bus->seed * 1103515245 + 12345;
+	return (bus->seed >> 8) & 0xffffff;
+}
+
+static void setup(Bus *bus, size_t count, unsigned int seed) {
+	memset(bus, 0, sizeof(Bus));
+	bus->count = count;
+	bus->seed = seed;
+	size_t i;
+	for (i = 0; i < count; i++) {
+		bus->devices[i].address = 0xff;
+	}
+}
+
+static int transmit(Bus *bus, DaliFramePtr frame) {
+	bus->frames++;
+	int answers = 0;
+	int value = 0xff;
+	int same = 1;
+	size_t i;
+	for (i = 0; i < bus->count; i++) {
+		Device *device = &bus->devices[i];
+		switch (frame->address) {
+		case 0xa1:
+			device->initialised = 0;
+			break;
+		case 0xa5:
+			if (frame->command == 0x00 || (frame->command == 0xff && device->address == 0xff)) {
+				device->initialised = 1;
+				device->withdrawn = 0;
+			}
+			break;
+		case 0xa7:
+			if (device->initialised) {
+				device->random = next_random(bus);
+			}
+			break;
+		case 0xa9:
+			if (device->initialised && !device->withdrawn && device->random <= bus->search) {
+				answers++;
+			}
+			break;
+		case 0xab:
+			if (device->initialised && device->random == bus->search) {
+				device->withdrawn = 1;
+			}
+			break;
+		case 0xb7:
+			if (device->initialised && device->random == bus->search) {
+				device->address = frame->command == 0xff ? 0xff : frame->command >> 1;
+			}
+			break;
+		case 0xb9:
+			if (device->initialised && device->address == frame->command >> 1) {
+				answers++;
+			}
+			break;
+		default:
+			// QUERY RANDOM ADDRESS (H, M, L)
+			if ((frame->address & 0x81) == 0x01 && device->address == frame->address >> 1 && frame->command >= 0xc2 && frame->command <= 0xc4) {
+				int byte = (int) ((device->random >> ((0xc4 - frame->command) * 8)) & 0xff);
+				if (answers > 0 && byte != value) {
+					same = 0;
+				}
+				value = byte;
+				answers++;
+			}
+			break;
+		}
+	}
+	switch (frame->address) {
+	case 0xb1:
+		bus->search = (bus->search & 0x00ffff) | (frame->command << 16);
+		break;
+	case 0xb3:
+		bus->search = (bus->search & 0xff00ff) | (frame->command << 8);
+		break;
+	case 0xb5:
+		bus->search = (bus->search & 0xffff00) | frame->command;
+		break;
+	}
+	if (answers == 0) {
+		return DALICOMMISSION_NO_RESPONSE;
+	}
+	// Answers of several devices collide into garbage
+	return answers == 1 || (bus->identical && same) ? value : (int) (next_random(bus) % 0xff);
+}
+
+static int step(Bus *bus, DaliCommissionPtr commission, unsigned long *time) {
+	DaliFramePtr frame;
+	int twice;
+	DaliCommissionStatus status = dalicommission_step(commission, &frame, &twice);
+	if (status != DALICOMMISSION_SEND) {
+		return status;
+	}
+	if (twice) {
+		transmit(bus, frame);
+		*time += FORWARD_TIME;
+	}
+	int response = transmit(bus, frame);
+	*time += frame->address == 0xa9 || frame->address == 0xb9 || frame->address < 0x80 ? BACKWARD_TIME : FORWARD_TIME;
+	dalicommission_response(commission, response);
+	daliframe_free(frame);
+	return status;
+}
+
+static int check(Bus *bus, DaliCommissionPtr commission, uint64_t used) {
+	const DaliCommissionDevice *found;
+	size_t count = dalicommission_devices(commission, &found);
+	size_t i, j;
+	for (i = 0; i < bus->count; i++) {
+		Device *device = &bus->devices[i];
+		if (device->address == 0xff || device->initialised) {
+			printf("Device %lu not commissioned\n", i);
+			return 0;
+		}
+		for (j = i + 1; j < bus->count; j++) {
+			if (bus->devices[j].address == device->address) {
+				printf("Devices %lu and %lu have the same address %u\n", i, j, device->address);
+				return 0;
+			}
+		}
+		if (!(used & ((uint64_t) 1 << device->address))) {
+			for (j = 0; j < count && found[j].address != device->address; j++);
+			if (j == count || found[j].random != device->random) {
+				printf("Device %lu not reported\n", i);
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static unsigned long run(Bus *bus, unsigned int flags, uint64_t used, unsigned long *time) {
+	DaliCommissionPtr commission = dalicommission_new(flags, used);
+	*time = 0;
+	int status;
+	while ((status = step(bus, commission, time)) == DALICOMMISSION_SEND);
+	unsigned long frames = dalicommission_frames(commission);
+	if (status != DALICOMMISSION_DONE || frames != bus->frames || !check(bus, commission, used)) {
+		frames = 0;
+	}
+	dalicommission_free(commission);
+	return frames;
+}
+
+int main(int argc, char **argv) {
+	printf("Test 1: Commissioning 64 devices\n");
+
+	Bus bus;
+	unsigned long time, frames, normal = 0, fast = 0;
+	unsigned int seed;
+	for (seed = 1; seed <= 10; seed++) {
+		setup(&bus, 64, seed);
+		frames = run(&bus, 0, 0, &time);
+		if (frames == 0) {
+			return 1;
+		}
+		normal += frames;
+		setup(&bus, 64, seed);
+		frames = run(&bus, DALICOMMISSION_FAST, 0, &time);
+		if (frames == 0) {
+			return 1;
+		}
+		fast += frames;
+	}
+	// Every device costs at most a full search: 24 compares and 3 search address bytes each
+	printf("Normal mode: %lu frames per bus\n", normal / 10);
+	printf("Fast mode: %lu frames per bus, last bus took %lu.%03lu s\n", fast / 10, time / 1000, time % 1000);
+	if (normal / 10 > 64 * (24 * 4 + 5) || fast >= normal) {
+		printf("Search too slow\n");
+		return 1;
+	}
+
+	printf("Test 2: Only devices without an address\n");
+
+	setup(&bus, 10, 42);
+	unsigned int i;
+	for (i = 0; i < 4; i++) {
+		bus.devices[i].address = i * 2;
+	}
+	if (!run(&bus, DALICOMMISSION_UNADDRESSED, 0x55, &time) || bus.devices[0].address != 0 || bus.devices[3].address != 6) {
+		printf("Existing addresses changed\n");
+		return 1;
+	}
+	// No free addresses left
+	setup(&bus, 3, 7);
+	DaliCommissionPtr commission = dalicommission_new(0, ~(uint64_t) 0x2);
+	while (step(&bus, commission, &time) == DALICOMMISSION_SEND);
+	if (dalicommission_devices(commission, NULL) != 1 || bus.devices[0].initialised) {
+		printf("Wrong number of devices commissioned\n");
+		return 1;
+	}
+	dalicommission_free(commission);
+	// Empty bus
+	setup(&bus, 0, 1);
+	if (!run(&bus, 0, 0, &time) || bus.frames != 4 + 3 + 1 + 1) {
+		printf("Empty bus not detected, %lu frames\n", bus.frames);
+		return 1;
+	}
+
+	printf("Test 3: Several buses at the same time\n");
+
+	Bus buses[2];
+	DaliCommissionPtr commissions[2];
+	int running = 2;
+	for (i = 0; i < 2; i++) {
+		setup(&buses[i], 64 - i * 20, 100 + i);
+		commissions[i] = dalicommission_new(DALICOMMISSION_FAST, 0);
+	}
+	while (running > 0) {
+		running = 0;
+		for (i = 0; i < 2; i++) {
+			if (step(&buses[i], commissions[i], &time) == DALICOMMISSION_SEND) {
+				running++;
+			}
+		}
+	}
+	for (i = 0; i < 2; i++) {
+		if (!check(&buses[i], commissions[i], 0) || dalicommission_devices(commissions[i], NULL) != buses[i].count) {
+			return 1;
+		}
+		dalicommission_free(commissions[i]);
+	}
+
+	printf("Test 4: Send errors\n");
+
+	setup(&bus, 4, 3);
+	commission = dalicommission_new(0, 0);
+	DaliFramePtr frame;
+	int twice;
+	step(&bus, commission, &time);
+	step(&bus, commission, &time);
+	if (dalicommission_step(commission, &frame, &twice) != DALICOMMISSION_SEND || dalicommission_step(commission, &frame, &twice) != DALICOMMISSION_ERROR) {
+		printf("Missing response not detected\n");
+		return 1;
+	}
+	daliframe_free(frame);
+	dalicommission_response(commission, DALICOMMISSION_SEND_FAILED);
+	// Initialisation is terminated
+	if (dalicommission_step(commission, &frame, &twice) != DALICOMMISSION_SEND || frame->address != 0xa1) {
+		printf("Not terminated\n");
+		return 1;
+	}
+	daliframe_free(frame);
+	dalicommission_response(commission, DALICOMMISSION_NO_RESPONSE);
+	if (dalicommission_step(commission, &frame, &twice) != DALICOMMISSION_ERROR) {
+		printf("Error not reported\n");
+		return 1;
+	}
+	dalicommission_free(commission);
+
+	printf("Test 5: Answers that don't collide\n");
+
+	for (seed = 1; seed <= 10; seed++) {
+		setup(&bus, 64, seed);
+		bus.identical = 1;
+		commission = dalicommission_new(DALICOMMISSION_FAST, 0);
+		while (step(&bus, commission, &time) == DALICOMMISSION_SEND);
+		if (!check(&bus, commission, 0) || dalicommission_devices(commission, NULL) != bus.count) {
+			printf("Devices missed with seed %u\n", seed);
+			return 1;
+		}
+		dalicommission_free(commission);
+	}
+	// Every address is confirmed in fast mode
+	setup(&bus, 8, 5);
+	commission = dalicommission_new(DALICOMMISSION_FAST, 0);
+	while (step(&bus, commission, &time) == DALICOMMISSION_SEND);
+	const DaliCommissionDevice *found;
+	size_t count = dalicommission_devices(commission, &found);
+	for (i = 0; i < count; i++) {
+		if (!found[i].verified) {
+			printf("Device %u not confirmed\n", found[i].address);
+			return 1;
+		}
+	}
+	dalicommission_free(commission);
+
+	return 0;
+}
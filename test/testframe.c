@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "frame.h"
+
+static int check(uint8_t address, uint8_t command, DaliFrameClass cls, unsigned int flags) {
+	struct DaliFrame frame = { 0, address, command };
+	if (daliframe_classify(&frame) != cls || daliframe_flags(&frame) != flags) {
+		printf("0x%02x 0x%02x: got %s 0x%02x, expected %s 0x%02x\n", address, command, daliframe_class_name(daliframe_classify(&frame)), daliframe_flags(&frame), daliframe_class_name(cls), flags);
+		return 0;
+	}
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	printf("Test 1: Command classes\n");
+
+	unsigned int command;
+	for (command = 0; command < 256; command++) {
+		struct DaliFrame frame = { 0, 0x03, (uint8_t) command };
+		DaliFrameClass cls = daliframe_classify(&frame);
+		DaliFrameClass expected = DALIFRAME_CLASS_QUERY;
+		if (command < 0x20) {
+			expected = DALIFRAME_CLASS_COMMAND;
+		} else if (command < 0x90 || (command >= 0xe0 && command <= 0xec)) {
+			expected = DALIFRAME_CLASS_CONFIG;
+		}
+		if (cls != expected) {
+			printf("Command 0x%02x is %s, expected %s\n", command, daliframe_class_name(cls), daliframe_class_name(expected));
+			return 1;
+		}
+		// The address doesn't matter, as long as it isn't special
+		frame.address = 0x9b;
+		if (daliframe_classify(&frame) != cls || daliframe_answered(&frame) != (cls == DALIFRAME_CLASS_QUERY)) {
+			printf("Group command 0x%02x classified differently\n", command);
+			return 1;
+		}
+	}
+
+	printf("Test 2: Flags\n");
+
+	unsigned int absolute = DALIFRAME_FLAG_ABSOLUTE | DALIFRAME_FLAG_REPEATABLE;
+	unsigned int answered = DALIFRAME_FLAG_ANSWERED | DALIFRAME_FLAG_REPEATABLE;
+	if (!check(0x04, 0x80, DALIFRAME_CLASS_ARC, absolute) || !check(0xfe, 0x00, DALIFRAME_CLASS_ARC, absolute)) {
+		return 1;
+	}
+	// Off and go to scene are absolute, up and step down and off are not
+	if (!check(0x05, 0x00, DALIFRAME_CLASS_COMMAND, absolute) || !check(0xff, 0x1f, DALIFRAME_CLASS_COMMAND, absolute) || !check(0x05, 0x01, DALIFRAME_CLASS_COMMAND, 0) || !check(0x05, 0x07, DALIFRAME_CLASS_COMMAND, 0)) {
+		return 1;
+	}
+	// Store DTR as scene is stored, store actual level in DTR isn't
+	if (!check(0x05, 0x42, DALIFRAME_CLASS_CONFIG, DALIFRAME_FLAG_TWICE | DALIFRAME_FLAG_STORED) || !check(0x05, 0x21, DALIFRAME_CLASS_CONFIG, DALIFRAME_FLAG_TWICE)) {
+		return 1;
+	}
+	if (!check(0x05, 0xa0, DALIFRAME_CLASS_QUERY, answered) || !check(0x05, 0xff, DALIFRAME_CLASS_QUERY, answered)) {
+		return 1;
+	}
+	// Read memory location advances the DTR
+	if (!check(0x05, 0xc5, DALIFRAME_CLASS_QUERY, DALIFRAME_FLAG_ANSWERED)) {
+		return 1;
+	}
+
+	printf("Test 3: Special commands\n");
+
+	// DTR, initialise, compare, query short address, physical selection, DTR2, write memory location
+	if (!check(0xa3, 0x10, DALIFRAME_CLASS_SPECIAL, DALIFRAME_FLAG_REPEATABLE) || !check(0xa5, 0x00, DALIFRAME_CLASS_SPECIAL, DALIFRAME_FLAG_TWICE)) {
+		return 1;
+	}
+	if (!check(0xa9, 0x00, DALIFRAME_CLASS_SPECIAL, answered) || !check(0xbb, 0x00, DALIFRAME_CLASS_SPECIAL, answered)) {
+		return 1;
+	}
+	if (!check(0xbd, 0x00, DALIFRAME_CLASS_SPECIAL, 0) || !check(0xc5, 0x00, DALIFRAME_CLASS_SPECIAL, DALIFRAME_FLAG_REPEATABLE) || !check(0xc7, 0x00, DALIFRAME_CLASS_SPECIAL, 0)) {
+		return 1;
+	}
+	// Reserved addresses and extended frames have no flags
+	if (!check(0xa4, 0x00, DALIFRAME_CLASS_SPECIAL, 0) || !check(0xad, 0x00, DALIFRAME_CLASS_SPECIAL, 0) || !check(0xe1, 0x00, DALIFRAME_CLASS_SPECIAL, 0) || !check(0xfd, 0x00, DALIFRAME_CLASS_SPECIAL, 0)) {
+		return 1;
+	}
+	struct DaliFrame extended = { 0x01, 0x05, 0x00 };
+	if (daliframe_classify(&extended) != DALIFRAME_CLASS_SPECIAL || daliframe_flags(&extended) != 0 || daliframe_classify(NULL) != DALIFRAME_CLASS_SPECIAL) {
+		printf("Extended frame classified\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "heap.h"
+
+typedef struct {
+	unsigned int key;
+	ssize_t index;
+} Entry;
+
+static int entry_compare(void *a, void *b) {
+	unsigned int ka = ((Entry *) a)->key;
+	unsigned int kb = ((Entry *) b)->key;
+	return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
+
+static void entry_index(void *data, ssize_t index) {
+	((Entry *) data)->index = index;
+}
+
+int main(int argc, char **argv) {
+	printf("Test 1: Ordering\n");
+
+	Entry entries[100];
+	HeapPtr heap = heap_new(entry_compare, entry_index);
+	size_t i;
+	for (i = 0; i < 100; i++) {
+		// Pseudo-random keys from a linear congruential generator
+		entries[i].key = (unsigned int) ((i * 7919 + 13) % 101);
+		heap_push(heap, &entries[i]);
+	}
+	for (i = 0; i < 100; i++) {
+		if (entries[i].index < 0 || heap_length(heap) <= (size_t) entries[i].index) {
+			printf("Invalid index %ld for entry %lu\n", entries[i].index, i);
+			return 1;
+		}
+	}
+	unsigned int last = 0;
+	for (i = 0; i < 100; i++) {
+		Entry *entry = heap_pop(heap);
+		if (!entry || entry->key < last || entry->index != -1) {
+			printf("Wrong order at %lu\n", i);
+			return 1;
+		}
+		last = entry->key;
+	}
+	if (heap_pop(heap) || heap_length(heap) != 0) {
+		printf("Heap not empty\n");
+		return 1;
+	}
+
+	printf("Test 2: Removal and update\n");
+
+	for (i = 0; i < 10; i++) {
+		entries[i].key = (unsigned int) i * 10;
+		heap_push(heap, &entries[i]);
+	}
+	// Remove 50, move 90 to the front and 0 to the back
+	heap_remove(heap, (size_t) entries[5].index);
+	entries[9].key = 5;
+	heap_update(heap, (size_t) entries[9].index);
+	entries[0].key = 95;
+	heap_update(heap, (size_t) entries[0].index);
+	unsigned int expected[] = { 5, 10, 20, 30, 40, 60, 70, 80, 95 };
+	for (i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+		Entry *entry = heap_pop(heap);
+		if (!entry || entry->key != expected[i]) {
+			printf("Got %u, expected %u\n", entry ? entry->key : 0, expected[i]);
+			return 1;
+		}
+	}
+	heap_free(heap);
+
+	return 0;
+}
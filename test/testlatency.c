@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "latency.h"
+
+int main(int argc, char **argv) {
+	printf("Test 1: Fixed timeout until enough transfers were seen\n");
+
+	DaliLatencyPtr latency = dalilatency_new(100, 1000);
+	if (!latency || dalilatency_timeout(latency) != 1000 || dalilatency_percentile(latency, 99) != 0) {
+		printf("Wrong initial timeout\n");
+		return 1;
+	}
+	unsigned int i;
+	for (i = 0; i < DALILATENCY_MIN_SAMPLES - 1; i++) {
+		dalilatency_add(latency, 30);
+	}
+	if (dalilatency_timeout(latency) != 1000) {
+		printf("Timeout adapted too early\n");
+		return 1;
+	}
+
+	printf("Test 2: Timeout follows the latency\n");
+
+	// A healthy adapter answers in 25-35 msec, with an occasional slower transfer
+	for (i = 0; i < DALILATENCY_SAMPLES; i++) {
+		dalilatency_add(latency, i == 0 ? 60 : 25 + i % 11);
+	}
+	unsigned int p99 = dalilatency_percentile(latency, 99);
+	printf("p50=%u p99=%u timeout=%u\n", dalilatency_percentile(latency, 50), p99, dalilatency_timeout(latency));
+	if (p99 != 35 || dalilatency_timeout(latency) != 35 * DALILATENCY_FACTOR || dalilatency_length(latency) != DALILATENCY_SAMPLES) {
+		printf("Wrong timeout\n");
+		return 1;
+	}
+	// Lost responses now and then don't make it rise
+	dalilatency_expired(latency);
+	if (dalilatency_timeout(latency) != 35 * DALILATENCY_FACTOR) {
+		printf("Single timeout changed the timeout\n");
+		return 1;
+	}
+
+	printf("Test 3: Floor and ceiling\n");
+
+	for (i = 0; i < DALILATENCY_SAMPLES; i++) {
+		dalilatency_add(latency, 5);
+	}
+	if (dalilatency_timeout(latency) != 100) {
+		printf("Timeout below the floor\n");
+		return 1;
+	}
+	// A slow adapter times out repeatedly until the ceiling is reached
+	for (i = 0; i < 10 && dalilatency_timeout(latency) < 1000; i++) {
+		dalilatency_expired(latency);
+	}
+	if (dalilatency_timeout(latency) != 1000 || i > 3) {
+		printf("Timeout didn't rise to the ceiling (%u after %u)\n", dalilatency_timeout(latency), i);
+		return 1;
+	}
+	dalilatency_free(latency);
+
+	if (dalilatency_new(1000, 100)) {
+		printf("Floor above ceiling accepted\n");
+		return 1;
+	}
+
+	return 0;
+}
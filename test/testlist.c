@@ -29,6 +29,14 @@ int main(int argc, char **argv) {
 	free(list_remove(list, node));
 
 	printf("After removing 2 elements: %ld\n", list_length(list));
+
+	void *first = malloc(4);
+	list_push(list, first);
+	if (list_data(list_first(list)) != first || list_dequeue(list) != first) {
+		printf("Pushed element is not the first one\n");
+		return 1;
+	}
+	free(first);
 	
 	list_free(list);
 	
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "poller.h"
+
+// Bus time of a query in the simulation
+static const unsigned long FRAME_TIME = 25; //msec
+
+// Sends the next query if it's due and answers it with response
+// Returns 1 if a query was sent, -1 if the response was reported as a change
+static int poll(DaliPollerPtr poller, uint64_t present, unsigned long now, uint8_t *address, uint8_t *command, int response) {
+	DaliFramePtr frame = dalipoller_next(poller, present, now);
+	if (!frame) {
+		return 0;
+	}
+	*address = frame->address;
+	*command = frame->command;
+	daliframe_free(frame);
+	return dalipoller_response(poller, response, now + FRAME_TIME) ? -1 : 1;
+}
+
+// Simulates seconds of bus time with other traffic every interval msec (0 = none)
+// Returns the number of queries sent by the poller
+static unsigned long simulate(DaliPollerPtr poller, unsigned long start, unsigned long seconds, unsigned long interval, unsigned long *others) {
+	unsigned long now;
+	unsigned long free_at = start;
+	unsigned long pending = 0;
+	unsigned long next_other = start;
+	unsigned long sent = 0;
+	for (now = start; now < start + seconds * 1000; now++) {
+		if (interval > 0 && now >= next_other) {
+			pending++;
+			next_other += interval;
+		}
+		if (now < free_at) {
+			continue;
+		}
+		// Other traffic comes first, polling only uses the idle bus
+		if (pending > 0) {
+			pending--;
+			(*others)++;
+			free_at = now + FRAME_TIME;
+			dalipoller_busy(poller, now);
+			continue;
+		}
+		DaliFramePtr frame = dalipoller_next(poller, 0x3, now);
+		if (frame) {
+			daliframe_free(frame);
+			free_at = now + FRAME_TIME;
+			dalipoller_response(poller, 0, free_at);
+			sent++;
+		}
+	}
+	return sent;
+}
+
+int main(int argc, char **argv) {
+	printf("Test 1: Polling cycle\n");
+	DaliPollerPtr poller = dalipoller_new(10000, 100);
+	uint8_t status[] = { 0x90, 0x92 };
+	uint8_t fade[] = { 0xa5 };
+	uint8_t many[DALIPOLLER_MAX_QUERIES + 1] = { 0 };
+	if (!dalipoller_add(poller, status, sizeof(status), 0) || !dalipoller_add(poller, fade, sizeof(fade), 1ULL << 5)) {
+		printf("Can't add query sets\n");
+		return 1;
+	}
+	if (dalipoller_add(poller, many, sizeof(many), 0)) {
+		printf("Query set with too many queries was accepted\n");
+		return 1;
+	}
+	uint8_t expected[][2] = { { 0x03, 0x90 }, { 0x03, 0x92 }, { 0x07, 0x90 }, { 0x07, 0x92 }, { 0x0b, 0xa5 } };
+	uint64_t present = (1ULL << 1) | (1ULL << 3);
+	unsigned long now = 1000;
+	size_t i;
+	for (i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+		uint8_t address, command;
+		if (dalipoller_wait(poller, present, now) != 0 || poll(poller, present, now, &address, &command, 0) != 1) {
+			printf("Query %lu was not sent\n", i);
+			return 1;
+		}
+		if (address != expected[i][0] || command != expected[i][1]) {
+			printf("Query %lu: expected (0x%02x 0x%02x), got (0x%02x 0x%02x)\n", i, expected[i][0], expected[i][1], address, command);
+			return 1;
+		}
+		now += FRAME_TIME;
+	}
+	long wait = dalipoller_wait(poller, present, now);
+	if (wait != 10000 - 5 * FRAME_TIME || dalipoller_cycles(poller) != 1) {
+		printf("Next cycle should start in %lu msec, waiting %ld, %lu cycles\n", 10000 - 5 * FRAME_TIME, wait, dalipoller_cycles(poller));
+		return 1;
+	}
+	now += wait;
+
+	printf("Test 2: Changes\n");
+	int responses[] = { 0, 0, 0x02, 0, DALIPOLLER_NO_RESPONSE };
+	int changes = 0;
+	for (i = 0; i < sizeof(responses) / sizeof(responses[0]); i++) {
+		uint8_t address, command;
+		int result = poll(poller, present, now, &address, &command, responses[i]);
+		if (result == 0) {
+			printf("Query %lu was not sent\n", i);
+			return 1;
+		}
+		if (result < 0) {
+			changes++;
+		}
+		now += FRAME_TIME;
+	}
+	if (changes != 2) {
+		printf("Expected 2 changes, got %d\n", changes);
+		return 1;
+	}
+	// Failed sends are retried in the next cycle and don't count as a change
+	now += dalipoller_wait(poller, present, now);
+	uint8_t address, command;
+	if (poll(poller, present, now, &address, &command, DALIPOLLER_SEND_FAILED) != 1) {
+		printf("A failed send was reported as a change\n");
+		return 1;
+	}
+	dalipoller_free(poller);
+
+	printf("Test 3: Nothing to poll\n");
+	poller = dalipoller_new(0, 50);
+	dalipoller_add(poller, status, sizeof(status), 0);
+	if (dalipoller_wait(poller, 0, 0) != -1 || dalipoller_next(poller, 0, 0)) {
+		printf("Polling without any present devices\n");
+		return 1;
+	}
+	DaliFramePtr frame = dalipoller_next(poller, 1, 0);
+	if (!frame || dalipoller_wait(poller, 1, 0) != -1 || dalipoller_next(poller, 1, 0)) {
+		printf("A second query was sent while the first was outstanding\n");
+		return 1;
+	}
+	daliframe_free(frame);
+	dalipoller_free(poller);
+
+	printf("Test 4: Adapting to the bus utilization\n");
+	poller = dalipoller_new(0, 50);
+	dalipoller_add(poller, status, sizeof(status), 0);
+	unsigned long others = 0;
+	unsigned long idle = simulate(poller, 0, 20, 0, &others);
+	printf("Idle bus: %lu queries in 20 sec, %lu%% of the bus\n", idle, idle * FRAME_TIME * 100 / 20000);
+	if (idle < 380 || idle > 400) {
+		printf("Polling should use half of an idle bus\n");
+		return 1;
+	}
+	// Other traffic uses 40% of the bus
+	unsigned long polled = simulate(poller, 20000, 20, 62, &others);
+	unsigned long utilization = dalipoller_utilization(poller, 40000);
+	printf("Busy bus: %lu queries and %lu other frames in 20 sec, %lu%% utilization measured, %lu%% total\n", polled, others, utilization, (polled + others) * FRAME_TIME * 100 / 20000);
+	if (utilization < 35 || utilization > 45 || polled > idle / 2 || (polled + others) * FRAME_TIME * 100 / 20000 > 60) {
+		printf("Polling didn't back off\n");
+		return 1;
+	}
+	// The load is gone again
+	others = 0;
+	polled = simulate(poller, 40000, 20, 0, &others);
+	if (polled < idle * 8 / 10) {
+		printf("Polling didn't recover, %lu queries\n", polled);
+		return 1;
+	}
+	// Other traffic saturates the bus, polling gets nothing
+	polled = simulate(poller, 60000, 20, 20, &others);
+	if (polled > 0) {
+		printf("Polling used a saturated bus, %lu queries\n", polled);
+		return 1;
+	}
+	dalipoller_free(poller);
+
+	return 0;
+}
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <string.h>
+#include "program.h"
+#include "queue.h"
+
+// A simulated bus: devices store scene levels from the DTR
+typedef struct {
+	uint64_t present;
+	uint8_t dtr;
+	uint8_t scenes[64][16];
+	unsigned int frames;
+	// Frames of this device fail to send
+	int broken;
+	// Calls to dalirun_step that returned frames
+	unsigned int steps;
+} Bus;
+
+static int transmit(Bus *bus, DaliFramePtr frame) {
+	bus->frames++;
+	unsigned int device = frame->address >> 1;
+	if (frame->address == 0xa3) {
+		bus->dtr = frame->command;
+		return DALIRUN_NO_RESPONSE;
+	}
+	if ((frame->address & 0x80) || !(bus->present & ((uint64_t) 1 << device))) {
+		return DALIRUN_NO_RESPONSE;
+	}
+	if ((int) device == bus->broken) {
+		return DALIRUN_SEND_FAILED;
+	}
+	if (frame->command >= 0x40 && frame->command <= 0x4f) {
+		bus->scenes[device][frame->command & 0x0f] = bus->dtr;
+	} else if (frame->command >= 0xb0 && frame->command <= 0xbf) {
+		return bus->scenes[device][frame->command & 0x0f];
+	}
+	return DALIRUN_NO_RESPONSE;
+}
+
+static DaliRunStatus execute(Bus *bus, DaliProgramPtr program, DaliStatePtr state, uint8_t x, const uint8_t **results, size_t *length) {
+	DaliRunPtr run = dalirun_new(program, state, x);
+	DaliFramePtr frames[DALIRUN_MAX_SEQUENCE];
+	size_t count;
+	DaliRunStatus status;
+	while ((status = dalirun_step(run, frames, &count)) == DALIRUN_SEND) {
+		int response = DALIRUN_NO_RESPONSE;
+		int failed = 0;
+		size_t i;
+		for (i = 0; i < count; i++) {
+			response = transmit(bus, frames[i]);
+			failed |= response == DALIRUN_SEND_FAILED;
+			daliframe_free(frames[i]);
+		}
+		bus->steps++;
+		dalirun_response(run, failed ? DALIRUN_SEND_FAILED : response);
+	}
+	static uint8_t copy[DALIPROGRAM_MAX_RESULTS * DALIPROGRAM_RECORD_SIZE];
+	const uint8_t *data;
+	*length = dalirun_results(run, &data);
+	memcpy(copy, data, *length);
+	*results = copy;
+	dalirun_free(run);
+	return status;
+}
+
+int main(int argc, char **argv) {
+	printf("Test 1: Checking programs\n");
+
+	uint8_t unknown[] = { 0x42 };
+	uint8_t truncated[] = { DALIPROGRAM_SEND, 0xa3 };
+	uint8_t inside[] = { DALIPROGRAM_JUMP, 3, DALIPROGRAM_SEND, 0xa3, 0x00 };
+	uint8_t beyond[] = { DALIPROGRAM_JNONE, 4, DALIPROGRAM_END };
+	if (daliprogram_new(unknown, sizeof(unknown)) || daliprogram_new(truncated, sizeof(truncated)) || daliprogram_new(inside, sizeof(inside)) || daliprogram_new(beyond, sizeof(beyond))) {
+		printf("Invalid program accepted\n");
+		return 1;
+	}
+	uint8_t end[] = { DALIPROGRAM_JNONE, 2 };
+	DaliProgramPtr program = daliprogram_new(end, sizeof(end));
+	if (!program || daliprogram_length(program) != 2) {
+		printf("Jump to the end rejected\n");
+		return 1;
+	}
+	daliprogram_free(program);
+
+	printf("Test 2: Storing a scene on all present devices\n");
+
+	Bus bus;
+	memset(&bus, 0, sizeof(bus));
+	bus.present = 0x8000000000000013ULL;
+	bus.broken = -1;
+	DaliStatePtr state = dalistate_new();
+	unsigned int device;
+	for (device = 0; device < 64; device++) {
+		DaliFramePtr frame = daliframe_new((uint8_t) ((device << 1) | 1), 0x91);
+		dalistate_response(state, frame, (bus.present & ((uint64_t) 1 << device)) ? 0xff : -1, 1000);
+		daliframe_free(frame);
+	}
+	// DTR = 200, store DTR as scene X twice, verify with QUERY SCENE LEVEL X,
+	// report the devices where it didn't work
+	uint8_t store[] = {
+		/*  0 */ DALIPROGRAM_PRESENT,
+		/*  1 */ DALIPROGRAM_EACH, 22,
+		/*  3 */ DALIPROGRAM_SEND, 0xa3, 200,
+		/*  6 */ DALIPROGRAM_DEVX, 0x40,
+		/*  8 */ DALIPROGRAM_DEVX, 0x40,
+		/* 10 */ DALIPROGRAM_DEVX, 0xb0,
+		/* 12 */ DALIPROGRAM_JEQ, 200, 1,
+		/* 15 */ DALIPROGRAM_EMIT,
+		/* 16 */ DALIPROGRAM_JUMP, 1,
+		/* 18 */ DALIPROGRAM_SEND, 0xff, 0x00,
+		/* 21 */ DALIPROGRAM_END,
+		/* 22 */ DALIPROGRAM_EMIT,
+	};
+	program = daliprogram_new(store, sizeof(store));
+	if (!program) {
+		printf("Program rejected\n");
+		return 1;
+	}
+	const uint8_t *results;
+	size_t length;
+	if (execute(&bus, program, state, 5, &results, &length) != DALIRUN_DONE) {
+		printf("Program failed\n");
+		return 1;
+	}
+	// DTR and both copies of the store command are one sequence per device
+	if (bus.frames != 4 * 4 || bus.steps != 4 * 2 || bus.scenes[0][5] != 200 || bus.scenes[1][5] != 200 || bus.scenes[4][5] != 200 || bus.scenes[63][5] != 200 || bus.scenes[2][5] != 0) {
+		printf("Scene not stored, %u frames sent\n", bus.frames);
+		return 1;
+	}
+	// Only the final record, all devices were verified
+	if (length != DALIPROGRAM_RECORD_SIZE || results[0] != 63 || results[1] != DALIPROGRAM_ANSWERED || results[2] != 200) {
+		printf("Wrong results\n");
+		return 1;
+	}
+	// A device that can't be reached is reported
+	bus.frames = 0;
+	bus.broken = 4;
+	if (execute(&bus, program, state, 6, &results, &length) != DALIRUN_DONE || length != 2 * DALIPROGRAM_RECORD_SIZE || results[0] != 4 || results[1] != DALIPROGRAM_FAILED || results[3] != 63) {
+		printf("Failure not reported\n");
+		return 1;
+	}
+	daliprogram_free(program);
+
+	printf("Test 3: Groups and branches on missing responses\n");
+
+	// Query scene 5 of 0, 1 and 2 from an explicit set, report the ones that answered
+	uint8_t query[] = {
+		/*  0 */ DALIPROGRAM_SET, 0, 0, 0, 0, 0, 0, 0, 0x07,
+		/*  9 */ DALIPROGRAM_LOADX, 5,
+		/* 11 */ DALIPROGRAM_EACH, 20,
+		/* 13 */ DALIPROGRAM_DEVX, 0xb0,
+		/* 15 */ DALIPROGRAM_JNONE, 11,
+		/* 17 */ DALIPROGRAM_EMIT,
+		/* 18 */ DALIPROGRAM_JUMP, 11,
+	};
+	program = daliprogram_new(query, sizeof(query));
+	bus.broken = -1;
+	if (!program || execute(&bus, program, state, 0, &results, &length) != DALIRUN_DONE || length != 2 * DALIPROGRAM_RECORD_SIZE || results[0] != 0 || results[3] != 1 || results[5] != 200) {
+		printf("Wrong devices reported\n");
+		return 1;
+	}
+	daliprogram_free(program);
+	// Group members come from the state table
+	DaliFramePtr frame = daliframe_new(0x03, 0x62);
+	dalistate_command(state, frame, 2000);
+	daliframe_free(frame);
+	uint8_t group[] = { DALIPROGRAM_GROUP, 2, DALIPROGRAM_EACH, 6, DALIPROGRAM_EMIT, DALIPROGRAM_END };
+	program = daliprogram_new(group, sizeof(group));
+	if (!program || execute(&bus, program, state, 0, &results, &length) != DALIRUN_DONE || length != DALIPROGRAM_RECORD_SIZE || results[0] != 1 || results[1] != 0) {
+		printf("Wrong group members\n");
+		return 1;
+	}
+	daliprogram_free(program);
+
+	printf("Test 4: Runtime errors\n");
+
+	uint8_t loop[] = { DALIPROGRAM_JUMP, 0 };
+	uint8_t nodevice[] = { DALIPROGRAM_DEV, 0xa0 };
+	program = daliprogram_new(loop, sizeof(loop));
+	if (!program || execute(&bus, program, state, 0, &results, &length) != DALIRUN_ERROR) {
+		printf("Endless loop not stopped\n");
+		return 1;
+	}
+	daliprogram_free(program);
+	program = daliprogram_new(nodevice, sizeof(nodevice));
+	if (!program || execute(&bus, program, state, 0, &results, &length) != DALIRUN_ERROR) {
+		printf("Command without a device sent\n");
+		return 1;
+	}
+	daliprogram_free(program);
+	// Stepping again without a response is an error
+	uint8_t send[] = { DALIPROGRAM_SEND, 0xff, 0x00 };
+	program = daliprogram_new(send, sizeof(send));
+	DaliRunPtr run = dalirun_new(program, state, 0);
+	// The run has its own copy of the code
+	daliprogram_free(program);
+	DaliFramePtr frames[DALIRUN_MAX_SEQUENCE];
+	size_t count;
+	if (dalirun_step(run, frames, &count) != DALIRUN_SEND || count != 1 || frames[0]->address != 0xff || dalirun_step(run, frames, &count) != DALIRUN_ERROR) {
+		printf("Missing response not detected\n");
+		return 1;
+	}
+	daliframe_free(frames[0]);
+	dalirun_free(run);
+
+	printf("Test 5: Another client writing the DTR at the same time\n");
+
+	// The program and another client share the queue, the other client
+	// sets the DTR to 0 whenever it gets the chance
+	DaliQueuePtr queue = daliqueue_new();
+	int task, other;
+	memset(bus.scenes, 0, sizeof(bus.scenes));
+	program = daliprogram_new(store, sizeof(store));
+	run = dalirun_new(program, state, 7);
+	DaliRunStatus status;
+	unsigned long now = 0;
+	while ((status = dalirun_step(run, frames, &count)) == DALIRUN_SEND) {
+		DaliTransactionPtr sequence = dalitransaction_new(frames[0], DALIQUEUE_PRIORITY_NORMAL, &task);
+		size_t i;
+		for (i = 1; i < count; i++) {
+			dalitransaction_append(sequence, dalitransaction_new(frames[i], DALIQUEUE_PRIORITY_NORMAL, &task), 100);
+		}
+		daliqueue_push(queue, sequence);
+		int response = DALIRUN_NO_RESPONSE;
+		while (count > 0) {
+			daliqueue_push(queue, dalitransaction_new(daliframe_new(0xa3, 0), DALIQUEUE_PRIORITY_NORMAL, &other));
+			DaliTransactionPtr transaction = daliqueue_pop(queue);
+			if (!transaction) {
+				printf("Queue empty\n");
+				return 1;
+			}
+			now += transaction->cost;
+			response = transmit(&bus, transaction->request);
+			daliqueue_finish(queue, now, 0);
+			if (transaction->arg == &task) {
+				count--;
+			}
+			dalitransaction_free(transaction);
+		}
+		dalirun_response(run, response);
+	}
+	daliprogram_free(program);
+	dalirun_free(run);
+	if (status != DALIRUN_DONE || bus.scenes[0][7] != 200 || bus.scenes[1][7] != 200 || bus.scenes[4][7] != 200 || bus.scenes[63][7] != 200) {
+		printf("DTR changed in the middle of the program\n");
+		return 1;
+	}
+	daliqueue_free(queue);
+
+	dalistate_free(state);
+
+	return 0;
+}
@@ -0,0 +1,551 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "queue.h"
+
+static DaliTransactionPtr push(DaliQueuePtr queue, uint8_t address, DaliQueuePriority priority, void *arg) {
+	DaliTransactionPtr transaction = dalitransaction_new(daliframe_new(address, 0), priority, arg);
+	daliqueue_push(queue, transaction);
+	return transaction;
+}
+
+static DaliTransactionPtr push_deadline(DaliQueuePtr queue, uint8_t address, DaliQueuePriority priority, void *arg, unsigned long deadline) {
+	DaliTransactionPtr transaction = dalitransaction_new(daliframe_new(address, 0), priority, arg);
+	transaction->deadline = deadline;
+	daliqueue_push(queue, transaction);
+	return transaction;
+}
+
+static DaliTransactionPtr push_held(DaliQueuePtr queue, uint8_t address, uint8_t command, void *arg, unsigned long hold) {
+	DaliTransactionPtr transaction = dalitransaction_new(daliframe_new(address, command), DALIQUEUE_PRIORITY_NORMAL, arg);
+	transaction->hold = hold;
+	daliqueue_push(queue, transaction);
+	return transaction;
+}
+
+static int pop(DaliQueuePtr queue, uint8_t address) {
+	DaliTransactionPtr transaction = daliqueue_pop(queue);
+	if (!transaction) {
+		printf("Queue empty, expected 0x%02x\n", address);
+		return 0;
+	}
+	if (transaction->request->address != address) {
+		printf("Got 0x%02x, expected 0x%02x\n", transaction->request->address, address);
+		dalitransaction_free(transaction);
+		return 0;
+	}
+	dalitransaction_free(transaction);
+	return 1;
+}
+
+// A simulated adapter that puts one frame on the bus per step
+typedef struct {
+	unsigned long now;
+	uint8_t sent[32];
+	void *owners[32];
+	size_t count;
+	size_t expired;
+} Adapter;
+
+static DaliTransactionPtr sequence(uint8_t *frames, size_t count, unsigned int gap, void *arg) {
+	DaliTransactionPtr first = dalitransaction_new(daliframe_new(frames[0], frames[1]), DALIQUEUE_PRIORITY_NORMAL, arg);
+	size_t i;
+	for (i = 1; i < count; i++) {
+		dalitransaction_append(first, dalitransaction_new(daliframe_new(frames[i * 2], frames[i * 2 + 1]), DALIQUEUE_PRIORITY_NORMAL, arg), gap);
+	}
+	return first;
+}
+
+static int step(Adapter *adapter, DaliQueuePtr queue, unsigned long delay, int failed) {
+	DaliTransactionPtr transaction;
+	while ((transaction = daliqueue_expire(queue, adapter->now))) {
+		adapter->expired++;
+		dalitransaction_free(transaction);
+	}
+	transaction = daliqueue_pop(queue);
+	if (!transaction) {
+		return 0;
+	}
+	adapter->sent[adapter->count] = transaction->request->command;
+	adapter->owners[adapter->count] = transaction->arg;
+	adapter->count++;
+	adapter->now += transaction->cost;
+	daliqueue_finish(queue, adapter->now, failed);
+	// Time until the adapter is ready for the next frame
+	adapter->now += delay;
+	dalitransaction_free(transaction);
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	printf("Test 1: Priority classes\n");
+
+	DaliQueuePtr queue = daliqueue_new();
+	push(queue, 0x01, DALIQUEUE_PRIORITY_BACKGROUND, NULL);
+	push(queue, 0x02, DALIQUEUE_PRIORITY_BACKGROUND, NULL);
+	push(queue, 0x03, DALIQUEUE_PRIORITY_NORMAL, NULL);
+	push(queue, 0x04, DALIQUEUE_PRIORITY_BACKGROUND, NULL);
+	push(queue, 0x05, DALIQUEUE_PRIORITY_INTERACTIVE, NULL);
+	push(queue, 0x06, DALIQUEUE_PRIORITY_NORMAL, NULL);
+
+	printf("Length: %lu\n", daliqueue_length(queue));
+	if (daliqueue_length(queue) != 6 || daliqueue_length_priority(queue, DALIQUEUE_PRIORITY_BACKGROUND) != 3) {
+		printf("Wrong queue length\n");
+		return 1;
+	}
+	if (!pop(queue, 0x05) || !pop(queue, 0x03) || !pop(queue, 0x06) || !pop(queue, 0x01)) {
+		return 1;
+	}
+	// An interactive frame overtakes the remaining background frames
+	push(queue, 0x07, DALIQUEUE_PRIORITY_INTERACTIVE, NULL);
+	if (!pop(queue, 0x07) || !pop(queue, 0x02) || !pop(queue, 0x04)) {
+		return 1;
+	}
+	if (daliqueue_pop(queue) || daliqueue_length(queue) != 0) {
+		printf("Queue not empty\n");
+		return 1;
+	}
+
+	printf("Test 2: Cancellation\n");
+
+	int a, b;
+	DaliTransactionPtr ta = push(queue, 0x10, DALIQUEUE_PRIORITY_NORMAL, &a);
+	DaliTransactionPtr tb = push(queue, 0x11, DALIQUEUE_PRIORITY_BACKGROUND, &b);
+	daliqueue_cancel(queue, &a);
+	if (ta->arg != NULL || tb->arg != &b) {
+		printf("Wrong transaction cancelled\n");
+		return 1;
+	}
+	daliqueue_free(queue);
+
+	printf("Test 3: Fairness between owners\n");
+
+	queue = daliqueue_new();
+	unsigned int i;
+	for (i = 0; i < 6; i++) {
+		push(queue, 0x20 + i, DALIQUEUE_PRIORITY_NORMAL, &a);
+	}
+	push(queue, 0x30, DALIQUEUE_PRIORITY_NORMAL, &b);
+	push(queue, 0x31, DALIQUEUE_PRIORITY_NORMAL, &b);
+	if (daliqueue_length_owner(queue, &a) != 6 || daliqueue_length_owner(queue, &b) != 2) {
+		printf("Wrong owner queue length\n");
+		return 1;
+	}
+	// The second owner doesn't have to wait for the first one's backlog
+	if (!pop(queue, 0x20) || !pop(queue, 0x30) || !pop(queue, 0x21) || !pop(queue, 0x31)) {
+		return 1;
+	}
+	for (i = 2; i < 6; i++) {
+		if (!pop(queue, 0x20 + i)) {
+			return 1;
+		}
+	}
+	if (daliqueue_pop(queue) || daliqueue_length_owner(queue, &a) != 0) {
+		printf("Queue not empty\n");
+		return 1;
+	}
+
+	printf("Test 4: Removing cancelled queries\n");
+
+	// Query actual level, set level, off, query status
+	push(queue, 0x01, DALIQUEUE_PRIORITY_NORMAL, &a);
+	push(queue, 0x02, DALIQUEUE_PRIORITY_NORMAL, &a);
+	push(queue, 0x03, DALIQUEUE_PRIORITY_BACKGROUND, &a);
+	push(queue, 0x04, DALIQUEUE_PRIORITY_NORMAL, &b);
+	daliqueue_push(queue, dalitransaction_new(daliframe_new(0x03, 0xa0), DALIQUEUE_PRIORITY_NORMAL, &a));
+	daliqueue_push(queue, dalitransaction_new(daliframe_new(0x02, 0xfe), DALIQUEUE_PRIORITY_NORMAL, &a));
+	daliqueue_push(queue, dalitransaction_new(daliframe_new(0x03, 0x00), DALIQUEUE_PRIORITY_NORMAL, &a));
+	daliqueue_push(queue, dalitransaction_new(daliframe_new(0x03, 0x90), DALIQUEUE_PRIORITY_BACKGROUND, &a));
+	size_t removed = daliqueue_remove(queue, &a, 1 << DALIFRAME_CLASS_QUERY);
+	printf("Removed: %lu\n", removed);
+	if (removed != 2 || daliqueue_length(queue) != 6 || daliqueue_length_owner(queue, &a) != 5) {
+		printf("Wrong transactions removed\n");
+		return 1;
+	}
+	if (!pop(queue, 0x01) || !pop(queue, 0x04) || !pop(queue, 0x02) || !pop(queue, 0x02) || !pop(queue, 0x03) || !pop(queue, 0x03)) {
+		return 1;
+	}
+	if (daliqueue_pop(queue)) {
+		printf("Queue not empty\n");
+		return 1;
+	}
+
+	printf("Test 5: Deadlines\n");
+
+	push_deadline(queue, 0x01, DALIQUEUE_PRIORITY_NORMAL, &a, 3000);
+	push(queue, 0x02, DALIQUEUE_PRIORITY_NORMAL, &a);
+	push_deadline(queue, 0x03, DALIQUEUE_PRIORITY_BACKGROUND, &b, 1000);
+	push_deadline(queue, 0x04, DALIQUEUE_PRIORITY_NORMAL, &b, 2000);
+	if (daliqueue_expire(queue, 999)) {
+		printf("Transaction expired too early\n");
+		return 1;
+	}
+	DaliTransactionPtr expired = daliqueue_expire(queue, 2000);
+	if (!expired || expired->request->address != 0x03) {
+		printf("Wrong transaction expired first\n");
+		return 1;
+	}
+	dalitransaction_free(expired);
+	expired = daliqueue_expire(queue, 2000);
+	if (!expired || expired->request->address != 0x04 || daliqueue_expire(queue, 2000)) {
+		printf("Wrong transaction expired second\n");
+		return 1;
+	}
+	dalitransaction_free(expired);
+	// A transaction that was sent in time doesn't expire anymore
+	if (!pop(queue, 0x01) || daliqueue_expire(queue, 5000) || daliqueue_length(queue) != 1 || daliqueue_cost(queue) != 25) {
+		printf("Sent transaction expired\n");
+		return 1;
+	}
+	if (!pop(queue, 0x02) || daliqueue_pop(queue)) {
+		printf("Queue not empty\n");
+		return 1;
+	}
+
+	printf("Test 6: Coalescing\n");
+
+	int c;
+	// Set level 10 on address 1, then 20 and 30 from different clients
+	daliqueue_push(queue, dalitransaction_new(daliframe_new(0x02, 10), DALIQUEUE_PRIORITY_NORMAL, &a));
+	DaliTransactionPtr merged = dalitransaction_new(daliframe_new(0x02, 20), DALIQUEUE_PRIORITY_NORMAL, &b);
+	DaliTransactionPtr queued = daliqueue_coalesce(queue, merged);
+	dalitransaction_free(merged);
+	merged = dalitransaction_new(daliframe_new(0x02, 30), DALIQUEUE_PRIORITY_NORMAL, &c);
+	if (!queued || daliqueue_coalesce(queue, merged) != queued || queued->request->command != 30) {
+		printf("Level not merged\n");
+		return 1;
+	}
+	dalitransaction_free(merged);
+	// Off on address 1 is queued after the level and can't be merged into an earlier off anymore
+	daliqueue_push(queue, dalitransaction_new(daliframe_new(0x03, 0x00), DALIQUEUE_PRIORITY_NORMAL, &a));
+	merged = dalitransaction_new(daliframe_new(0x02, 40), DALIQUEUE_PRIORITY_NORMAL, &a);
+	if (daliqueue_coalesce(queue, merged)) {
+		printf("Level merged across an off command\n");
+		return 1;
+	}
+	daliqueue_push(queue, merged);
+	// Step up isn't idempotent
+	daliqueue_push(queue, dalitransaction_new(daliframe_new(0x05, 0x03), DALIQUEUE_PRIORITY_NORMAL, &a));
+	merged = dalitransaction_new(daliframe_new(0x05, 0x03), DALIQUEUE_PRIORITY_NORMAL, &b);
+	if (daliqueue_coalesce(queue, merged)) {
+		printf("Step up merged\n");
+		return 1;
+	}
+	dalitransaction_free(merged);
+	if (daliqueue_length(queue) != 4) {
+		printf("Wrong queue length\n");
+		return 1;
+	}
+	DaliTransactionPtr popped = daliqueue_pop(queue);
+	if (popped->arg != &a || dalitransaction_next_waiter(popped) != &b || dalitransaction_next_waiter(popped) != &c || dalitransaction_next_waiter(popped)) {
+		printf("Wrong waiters\n");
+		return 1;
+	}
+	dalitransaction_free(popped);
+	while ((popped = daliqueue_pop(queue))) {
+		dalitransaction_free(popped);
+	}
+
+	printf("Test 7: Shared queries\n");
+
+	// Query actual level on address 1 from three clients, with a level change in between
+	daliqueue_push(queue, dalitransaction_new(daliframe_new(0x03, 0xa0), DALIQUEUE_PRIORITY_NORMAL, &a));
+	merged = dalitransaction_new(daliframe_new(0x03, 0xa0), DALIQUEUE_PRIORITY_NORMAL, &b);
+	queued = daliqueue_coalesce(queue, merged);
+	if (!queued || queued->arg != &a || !dalitransaction_same_query(queued, merged->request)) {
+		printf("Query not shared\n");
+		return 1;
+	}
+	dalitransaction_free(merged);
+	daliqueue_push(queue, dalitransaction_new(daliframe_new(0x02, 0x80), DALIQUEUE_PRIORITY_NORMAL, &a));
+	merged = dalitransaction_new(daliframe_new(0x03, 0xa0), DALIQUEUE_PRIORITY_NORMAL, &c);
+	if (daliqueue_coalesce(queue, merged)) {
+		printf("Query shared across a level change\n");
+		return 1;
+	}
+	daliqueue_push(queue, merged);
+	// The first client goes away, the shared query is still sent for the second one
+	if (daliqueue_remove(queue, &a, 1 << DALIFRAME_CLASS_QUERY) != 0 || queued->arg != &b || daliqueue_length(queue) != 3) {
+		printf("Shared query removed\n");
+		return 1;
+	}
+	while ((popped = daliqueue_pop(queue))) {
+		dalitransaction_free(popped);
+	}
+	// Read memory location answers with the next cell every time
+	daliqueue_push(queue, dalitransaction_new(daliframe_new(0x03, 0xc5), DALIQUEUE_PRIORITY_NORMAL, &a));
+	merged = dalitransaction_new(daliframe_new(0x03, 0xc5), DALIQUEUE_PRIORITY_NORMAL, &b);
+	if (daliqueue_coalesce(queue, merged)) {
+		printf("Read memory location shared\n");
+		return 1;
+	}
+	popped = daliqueue_pop(queue);
+	if (!popped || dalitransaction_same_query(popped, merged->request)) {
+		printf("Read memory location shared\n");
+		return 1;
+	}
+	dalitransaction_free(popped);
+	dalitransaction_free(merged);
+
+	printf("Test 8: Sequences with interleaved clients\n");
+
+	Adapter adapter = { 0, { 0 }, { NULL }, 0, 0 };
+	// DTR = 200, store DTR as max level (sent twice), then a query, all to address 1
+	uint8_t config[] = { 0xa3, 200, 0x03, 0x2a, 0x03, 0x2a, 0x03, 0xa1 };
+	// Other clients keep sending levels, a frame of each is queued before the sequence
+	push(queue, 0x10, DALIQUEUE_PRIORITY_NORMAL, &b);
+	push(queue, 0x20, DALIQUEUE_PRIORITY_NORMAL, &c);
+	daliqueue_push(queue, sequence(config, 4, 100, &a));
+	if (daliqueue_length(queue) != 6 || daliqueue_cost(queue) != 6 * 25) {
+		printf("Wrong queue length\n");
+		return 1;
+	}
+	uint8_t level = 0;
+	while (step(&adapter, queue, 0, 0)) {
+		// Interleave: a new frame from each of the other clients after every step
+		if (level < 8) {
+			daliqueue_push(queue, dalitransaction_new(daliframe_new(0x10, level++), DALIQUEUE_PRIORITY_NORMAL, &b));
+			daliqueue_push(queue, dalitransaction_new(daliframe_new(0x21, 0x05), DALIQUEUE_PRIORITY_INTERACTIVE, &c));
+		}
+	}
+	size_t first = adapter.count;
+	for (i = 0; i < adapter.count; i++) {
+		if (adapter.owners[i] == &a) {
+			first = i;
+			break;
+		}
+	}
+	if (first + 4 > adapter.count) {
+		printf("Sequence not sent\n");
+		return 1;
+	}
+	for (i = 0; i < 4; i++) {
+		if (adapter.owners[first + i] != &a || adapter.sent[first + i] != config[i * 2 + 1]) {
+			printf("Frame %u of the sequence is 0x%02x, expected 0x%02x\n", i, adapter.sent[first + i], config[i * 2 + 1]);
+			return 1;
+		}
+	}
+	if (adapter.count != 6 + 16 || adapter.expired != 0 || daliqueue_length(queue) != 0 || daliqueue_cost(queue) != 0) {
+		printf("Wrong number of frames sent\n");
+		return 1;
+	}
+	// Sequences are never merged with other frames
+	daliqueue_push(queue, sequence(config, 2, 0, &a));
+	merged = dalitransaction_new(daliframe_new(0xa3, 100), DALIQUEUE_PRIORITY_NORMAL, &b);
+	DaliTransactionPtr other = sequence(config, 2, 0, &b);
+	if (daliqueue_coalesce(queue, merged) || daliqueue_coalesce(queue, other)) {
+		printf("Sequence merged\n");
+		return 1;
+	}
+	dalitransaction_free(merged);
+	dalitransaction_free(other);
+	while (step(&adapter, queue, 0, 0));
+
+	printf("Test 9: Sequence timing and failures\n");
+
+	// The adapter is too slow for the second frame
+	adapter.count = 0;
+	daliqueue_push(queue, sequence(config, 3, 100, &a));
+	if (!step(&adapter, queue, 150, 0) || step(&adapter, queue, 0, 0) || adapter.expired != 2 || daliqueue_length(queue) != 0) {
+		printf("Late frames were sent\n");
+		return 1;
+	}
+	// The second frame fails, the third isn't sent
+	adapter.count = 0;
+	adapter.expired = 0;
+	daliqueue_push(queue, sequence(config, 3, 0, &a));
+	if (!step(&adapter, queue, 1000, 0) || !step(&adapter, queue, 0, 1) || step(&adapter, queue, 0, 0) || adapter.count != 2 || adapter.expired != 1) {
+		printf("Sequence continued after a failure\n");
+		return 1;
+	}
+	// The first frame expires in the queue, so does the rest
+	adapter.expired = 0;
+	DaliTransactionPtr late = sequence(config, 3, 0, &a);
+	late->deadline = adapter.now + 10;
+	daliqueue_push(queue, late);
+	adapter.now += 20;
+	if (step(&adapter, queue, 0, 0) || adapter.expired != 3 || daliqueue_length(queue) != 0) {
+		printf("Sequence not expired\n");
+		return 1;
+	}
+	// Cancelling a client only removes its sequences if they can be dropped as a whole
+	uint8_t queries[] = { 0x03, 0xa0, 0x05, 0xa0 };
+	daliqueue_push(queue, sequence(queries, 2, 0, &a));
+	daliqueue_push(queue, sequence(config, 4, 0, &a));
+	if (daliqueue_remove(queue, &a, 1 << DALIFRAME_CLASS_QUERY) != 1 || daliqueue_length(queue) != 4) {
+		printf("Wrong sequences removed\n");
+		return 1;
+	}
+	// A sequence on the bus is finished, but nobody gets the results anymore
+	adapter.count = 0;
+	step(&adapter, queue, 0, 0);
+	daliqueue_cancel(queue, &a);
+	while (step(&adapter, queue, 0, 0));
+	if (adapter.count != 4 || adapter.owners[0] != &a || adapter.owners[1] != NULL || adapter.owners[3] != NULL) {
+		printf("Cancelled sequence not finished\n");
+		return 1;
+	}
+
+	daliqueue_free(queue);
+
+	printf("Test 10: Grouping\n");
+
+	queue = daliqueue_new();
+	// Group 2 has devices 1-3, devices 0-4 are on the bus
+	uint64_t groups[DALIQUEUE_GROUPS] = { 0 };
+	groups[2] = 0x0e;
+	daliqueue_set_groups(queue, groups, 0x1f);
+	push_held(queue, 0x02, 0x80, &a, 100);
+	push_held(queue, 0x04, 0x80, &b, 100);
+	if (daliqueue_pop(queue) || daliqueue_length_held(queue) != 2 || daliqueue_hold_wait(queue, 40) != 60) {
+		printf("Frames not held\n");
+		return 1;
+	}
+	// The frames for a broadcast may still come, so they wait until their time is up
+	unsigned long cost = 0;
+	if (daliqueue_group(queue, push_held(queue, 0x06, 0x80, &c, 100), &cost) != 0 || daliqueue_unhold(queue, 99, &cost) != 0) {
+		printf("Frames grouped too early\n");
+		return 1;
+	}
+	if (daliqueue_unhold(queue, 100, &cost) != 2 || cost != 50 || daliqueue_length(queue) != 1 || daliqueue_length_held(queue) != 0) {
+		printf("Frames not grouped\n");
+		return 1;
+	}
+	DaliTransactionPtr grouped = daliqueue_pop(queue);
+	if (!grouped || grouped->request->address != 0x84 || grouped->request->command != 0x80 || grouped->arg != &c) {
+		printf("Wrong group frame\n");
+		return 1;
+	}
+	void *waiter1 = dalitransaction_next_waiter(grouped);
+	void *waiter2 = dalitransaction_next_waiter(grouped);
+	if (waiter1 != &a || waiter2 != &b || dalitransaction_next_waiter(grouped)) {
+		printf("Wrong waiters of the group frame\n");
+		return 1;
+	}
+	dalitransaction_free(grouped);
+	// Different levels are not merged, the frames are sent when their hold time is over
+	push_held(queue, 0x02, 0x10, &a, 100);
+	push_held(queue, 0x04, 0x20, &a, 100);
+	if (daliqueue_group(queue, push_held(queue, 0x06, 0x10, &a, 100), NULL) != 0 || daliqueue_hold_wait(queue, 100) != 0) {
+		printf("Different levels grouped\n");
+		return 1;
+	}
+	if (daliqueue_unhold(queue, 100, NULL) != 0) {
+		printf("Different levels grouped\n");
+		return 1;
+	}
+	if (!pop(queue, 0x02) || !pop(queue, 0x04) || !pop(queue, 0x06) || daliqueue_hold_wait(queue, 100) != -1) {
+		return 1;
+	}
+	// A frame that was overtaken by another one to the same device stays as it is
+	push_held(queue, 0x02, 0x30, &a, 100);
+	push(queue, 0x03, DALIQUEUE_PRIORITY_NORMAL, &b);
+	push_held(queue, 0x04, 0x30, &a, 100);
+	if (daliqueue_group(queue, push_held(queue, 0x06, 0x30, &a, 100), NULL) != 0 || daliqueue_unhold(queue, 200, NULL) != 0) {
+		printf("Overtaken frame grouped\n");
+		return 1;
+	}
+	while ((grouped = daliqueue_pop(queue))) {
+		dalitransaction_free(grouped);
+	}
+	// Nothing is larger than a broadcast, it is sent right away; queries are never held
+	for (i = 0; i < 4; i++) {
+		push_held(queue, i << 1 | 1, 0x00, &a, 100);
+	}
+	push_held(queue, 0x09, 0xa0, &a, 100);
+	if (daliqueue_length_held(queue) != 4 || daliqueue_group(queue, push_held(queue, 0x09, 0x00, &a, 100), NULL) != 4) {
+		printf("Frames not broadcast\n");
+		return 1;
+	}
+	if (!pop(queue, 0x09) || !pop(queue, 0xff) || daliqueue_length(queue) != 0) {
+		return 1;
+	}
+
+	daliqueue_free(queue);
+
+	printf("Test 11: Retries\n");
+
+	queue = daliqueue_new();
+	daliqueue_set_groups(queue, groups, 0x1f);
+	push(queue, 0x02, DALIQUEUE_PRIORITY_NORMAL, &a);
+	push(queue, 0x04, DALIQUEUE_PRIORITY_NORMAL, &a);
+	push(queue, 0x06, DALIQUEUE_PRIORITY_NORMAL, &b);
+	DaliTransactionPtr failed = daliqueue_pop(queue);
+	if (!daliqueue_requeue(queue, failed, 100) || failed->retries != 1 || daliqueue_length(queue) != 3 || daliqueue_length_held(queue) != 1) {
+		printf("Transaction not requeued\n");
+		return 1;
+	}
+	// The owner waits for the retry, the others don't
+	if (!pop(queue, 0x06) || daliqueue_pop(queue) || daliqueue_unhold(queue, 100, NULL) != 0) {
+		return 1;
+	}
+	if (!pop(queue, 0x02) || !pop(queue, 0x04) || daliqueue_length(queue) != 0) {
+		return 1;
+	}
+	// Frames of a sequence are not sent again
+	uint8_t dtr[] = { 0xa3, 0x10, 0x03, 0x2e };
+	daliqueue_push(queue, sequence(dtr, 2, 0, &a));
+	failed = daliqueue_pop(queue);
+	if (daliqueue_requeue(queue, failed, 0)) {
+		printf("Sequence requeued\n");
+		return 1;
+	}
+	dalitransaction_free(failed);
+	if (!pop(queue, 0x03)) {
+		return 1;
+	}
+	// A frame that is sent again isn't merged with newer ones, even if they would make up group 2
+	failed = push_held(queue, 0x02, 0x80, &a, 100);
+	if (daliqueue_pop(queue) || daliqueue_unhold(queue, 100, NULL) != 0 || daliqueue_pop(queue) != failed) {
+		return 1;
+	}
+	daliqueue_requeue(queue, failed, 200);
+	push_held(queue, 0x04, 0x80, &b, 200);
+	if (daliqueue_group(queue, push_held(queue, 0x06, 0x80, &c, 200), NULL) != 0 || daliqueue_unhold(queue, 200, NULL) != 0) {
+		printf("Retried frame grouped\n");
+		return 1;
+	}
+	if (!pop(queue, 0x02) || !pop(queue, 0x04) || !pop(queue, 0x06) || daliqueue_length(queue) != 0) {
+		return 1;
+	}
+
+	daliqueue_free(queue);
+
+	printf("Test 12: Sequence expiring while another one is sent\n");
+
+	queue = daliqueue_new();
+	uint8_t on_bus[] = { 0x01, 0x01, 0x01, 0x02 };
+	uint8_t stale[] = { 0x01, 0x04, 0x01, 0x05, 0x01, 0x06 };
+	daliqueue_push(queue, sequence(on_bus, 2, 0, &a));
+	DaliTransactionPtr waiting = sequence(stale, 3, 0, &b);
+	waiting->deadline = 100;
+	daliqueue_push(queue, waiting);
+	DaliTransactionPtr running = daliqueue_pop(queue);
+	if (!running || running->request->command != 0x01) {
+		printf("First sequence not started\n");
+		return 1;
+	}
+	dalitransaction_free(running);
+	// The waiting sequence expires as a whole, the running one goes on
+	for (i = 0x04; i <= 0x06; i++) {
+		DaliTransactionPtr expired = daliqueue_expire(queue, 200);
+		if (!expired || expired->request->command != i || expired->arg != &b) {
+			printf("Frame 0x%02x not expired\n", i);
+			return 1;
+		}
+		dalitransaction_free(expired);
+	}
+	if (daliqueue_expire(queue, 200) || daliqueue_length(queue) != 1) {
+		printf("Too many frames expired\n");
+		return 1;
+	}
+	running = daliqueue_pop(queue);
+	if (!running || running->request->command != 0x02 || running->arg != &a || daliqueue_length(queue) != 0) {
+		printf("Running sequence lost\n");
+		return 1;
+	}
+	dalitransaction_free(running);
+
+	daliqueue_free(queue);
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include "ratelimit.h"
+
+int main(int argc, char **argv) {
+	printf("Test 1: Token bucket\n");
+
+	TokenBucket bucket;
+	// 10 frames per second, up to 3 at once
+	tokenbucket_init(&bucket, 10, 3, 1000);
+	unsigned int i;
+	for (i = 0; i < 3; i++) {
+		if (tokenbucket_take(&bucket, 1000) != 0) {
+			printf("Burst frame %u rejected\n", i);
+			return 1;
+		}
+	}
+	unsigned int wait = tokenbucket_take(&bucket, 1000);
+	printf("Wait: %u\n", wait);
+	if (wait != 100) {
+		printf("Wrong wait time\n");
+		return 1;
+	}
+	if (tokenbucket_take(&bucket, 1050) != 50 || tokenbucket_take(&bucket, 1100) != 0) {
+		printf("Bucket not refilled correctly\n");
+		return 1;
+	}
+	if (tokenbucket_full(&bucket, 1200) || !tokenbucket_full(&bucket, 5000)) {
+		printf("Wrong fill state\n");
+		return 1;
+	}
+
+	printf("Test 2: Unlimited bucket\n");
+
+	tokenbucket_init(&bucket, 0, 0, 0);
+	for (i = 0; i < 1000; i++) {
+		if (tokenbucket_take(&bucket, 0) != 0) {
+			printf("Frame rejected\n");
+			return 1;
+		}
+	}
+
+	printf("Test 3: Table\n");
+
+	RateLimitTablePtr table = ratelimit_table_new(1, 2);
+	if (ratelimit_table_take(table, "10.0.0.1", 0) != 0 || ratelimit_table_take(table, "10.0.0.1", 0) != 0) {
+		printf("Burst frame rejected\n");
+		return 1;
+	}
+	if (ratelimit_table_take(table, "10.0.0.1", 0) != 1000) {
+		printf("Frame over the limit not rejected\n");
+		return 1;
+	}
+	// Other addresses have their own bucket
+	if (ratelimit_table_take(table, "10.0.0.2", 500) != 0 || ratelimit_table_length(table) != 2) {
+		printf("Second address rejected\n");
+		return 1;
+	}
+	// Both buckets are full again after two seconds, only the active one is kept
+	if (ratelimit_table_take(table, "10.0.0.2", 3000) != 0 || ratelimit_table_length(table) != 1) {
+		printf("Idle bucket not removed\n");
+		return 1;
+	}
+	ratelimit_table_free(table);
+
+	return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rules.h"
+
+typedef struct {
+	unsigned int ids[DALIRULES_MAX];
+	size_t count;
+	DaliFramePtr first;
+} Matches;
+
+static void collect(unsigned int id, DaliFramePtr const *frames, size_t count, void *arg) {
+	Matches *matches = (Matches *) arg;
+	if (matches->count == 0) {
+		matches->first = frames[0];
+	}
+	matches->ids[matches->count++] = id;
+}
+
+static size_t match(DaliRulesPtr rules, uint8_t ecommand, uint8_t address, uint8_t command, Matches *matches) {
+	struct DaliFrame frame = { ecommand, address, command };
+	matches->count = 0;
+	matches->first = NULL;
+	return dalirules_match(rules, &frame, collect, matches);
+}
+
+static int matches_pattern(const DaliRulePattern *pattern, uint8_t ecommand, uint8_t address, uint8_t command) {
+	return (ecommand & pattern->ecommand_mask) == (pattern->ecommand & pattern->ecommand_mask) &&
+		(address & pattern->address_mask) == (pattern->address & pattern->address_mask) &&
+		(command & pattern->command_mask) == (pattern->command & pattern->command_mask);
+}
+
+int main(int argc, char **argv) {
+	printf("Test 1: Exact patterns\n");
+	DaliRulesPtr rules = dalirules_new();
+	// A push button that sends RECALL MAX to group 1 switches group 2 as well
+	DaliRulePattern button = { 0x00, 0xff, 0x83, 0xff, 0x05, 0xff };
+	uint8_t group2[] = { 0x85, 0x05 };
+	// DTR write and store as scene 1 of all devices
+	uint8_t scene[] = { 0xa3, 0x80, 0xff, 0x41, 0xff, 0x41 };
+	if (!dalirules_add(rules, 10, &button, group2, 1)) {
+		printf("Can't add rule\n");
+		return 1;
+	}
+	Matches matches;
+	if (match(rules, 0x00, 0x83, 0x05, &matches) != 1 || matches.ids[0] != 10 || matches.first->address != 0x85 || matches.first->command != 0x05) {
+		printf("Button press didn't match\n");
+		return 1;
+	}
+	if (match(rules, 0x00, 0x83, 0x06, &matches) != 0 || match(rules, 0x00, 0x85, 0x05, &matches) != 0 || match(rules, 0x01, 0x83, 0x05, &matches) != 0) {
+		printf("Other frames matched\n");
+		return 1;
+	}
+
+	printf("Test 2: Masks and order\n");
+	// Any command to group 1, and any frame at all
+	DaliRulePattern group = { 0x00, 0xff, 0x83, 0xff, 0x00, 0x00 };
+	DaliRulePattern any = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	// Extended frames of an input device, instance 2 (address 0x85 with the low bits ignored)
+	DaliRulePattern sensor = { 0x12, 0xff, 0x84, 0xfc, 0x00, 0x00 };
+	dalirules_add(rules, 2, &group, group2, 1);
+	dalirules_add(rules, 200, &any, scene, 3);
+	dalirules_add(rules, 5, &sensor, group2, 1);
+	if (match(rules, 0x00, 0x83, 0x05, &matches) != 3 || matches.ids[0] != 2 || matches.ids[1] != 10 || matches.ids[2] != 200) {
+		printf("Expected rules 2, 10, 200 in this order\n");
+		return 1;
+	}
+	if (match(rules, 0x12, 0x86, 0x40, &matches) != 2 || matches.ids[0] != 5 || match(rules, 0x12, 0x88, 0x40, &matches) != 1) {
+		printf("Sensor rule didn't match\n");
+		return 1;
+	}
+	// Replacing a rule changes its pattern
+	dalirules_add(rules, 200, &button, scene, 3);
+	if (dalirules_length(rules) != 4 || match(rules, 0x12, 0x88, 0x40, &matches) != 0 || match(rules, 0x00, 0x83, 0x05, &matches) != 3) {
+		printf("Rule 200 wasn't replaced\n");
+		return 1;
+	}
+	if (!dalirules_remove(rules, 10) || dalirules_remove(rules, 10) || match(rules, 0x00, 0x83, 0x05, &matches) != 2) {
+		printf("Rule 10 wasn't removed\n");
+		return 1;
+	}
+
+	printf("Test 3: Invalid rules\n");
+	uint8_t query[] = { 0x01, 0x90 };
+	uint8_t compare[] = { 0xa9, 0x00 };
+	uint8_t many[(DALIRULES_MAX_FRAMES + 1) * 2];
+	memset(many, 0xff, sizeof(many));
+	if (dalirules_add(rules, 1, &any, query, 1) || dalirules_add(rules, 1, &any, compare, 1) || dalirules_add(rules, 1, &any, group2, 0) ||
+		dalirules_add(rules, 1, &any, many, DALIRULES_MAX_FRAMES + 1) || dalirules_add(rules, DALIRULES_MAX, &any, group2, 1) ||
+		dalirules_length(rules) != 3) {
+		printf("An invalid rule was accepted\n");
+		return 1;
+	}
+	dalirules_free(rules);
+
+	printf("Test 4: Index against a linear search\n");
+	rules = dalirules_new();
+	DaliRulePattern patterns[DALIRULES_MAX];
+	int present[DALIRULES_MAX] = { 0 };
+	srand(1234);
+	unsigned int id;
+	for (id = 0; id < DALIRULES_MAX; id++) {
+		// Mostly exact addresses, some wildcards
+		patterns[id].ecommand = (uint8_t) (rand() % 4);
+		patterns[id].ecommand_mask = rand() % 2 ? 0xff : 0x00;
+		patterns[id].address = (uint8_t) rand();
+		patterns[id].address_mask = rand() % 8 ? 0xff : (uint8_t) rand();
+		patterns[id].command = (uint8_t) rand();
+		patterns[id].command_mask = rand() % 2 ? 0xff : 0xf0;
+		if (rand() % 4) {
+			dalirules_add(rules, id, &patterns[id], group2, 1);
+			present[id] = 1;
+		}
+	}
+	unsigned long i;
+	unsigned long total = 0;
+	for (i = 0; i < 200000; i++) {
+		if (i == 100000) {
+			// The index must follow removed and replaced rules
+			for (id = 0; id < DALIRULES_MAX; id += 3) {
+				dalirules_remove(rules, id);
+				present[id] = 0;
+			}
+			for (id = 1; id < DALIRULES_MAX; id += 5) {
+				patterns[id].address = (uint8_t) rand();
+				patterns[id].address_mask = rand() % 2 ? 0xff : 0xf0;
+				if (!dalirules_add(rules, id, &patterns[id], group2, 1)) {
+					printf("Rule %u not replaced\n", id);
+					return 1;
+				}
+				present[id] = 1;
+			}
+		}
+		uint8_t ecommand = (uint8_t) (rand() % 4);
+		uint8_t address = (uint8_t) rand();
+		uint8_t command = (uint8_t) rand();
+		// Hit the patterns now and then
+		if (rand() % 2) {
+			DaliRulePattern *pattern = &patterns[rand() % DALIRULES_MAX];
+			ecommand = pattern->ecommand;
+			address = pattern->address;
+			command = pattern->command;
+		}
+		match(rules, ecommand, address, command, &matches);
+		size_t expected = 0;
+		for (id = 0; id < DALIRULES_MAX; id++) {
+			if (present[id] && matches_pattern(&patterns[id], ecommand, address, command)) {
+				if (expected >= matches.count || matches.ids[expected] != id) {
+					printf("Frame (0x%02x 0x%02x 0x%02x) should match rule %u\n", ecommand, address, command, id);
+					return 1;
+				}
+				expected++;
+			}
+		}
+		if (expected != matches.count) {
+			printf("Frame (0x%02x 0x%02x 0x%02x) matched %lu rules instead of %lu\n", ecommand, address, command, matches.count, expected);
+			return 1;
+		}
+		total += expected;
+	}
+	printf("%lu matches in %lu frames\n", total, i);
+	dalirules_free(rules);
+
+	return 0;
+}
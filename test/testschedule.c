@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "schedule.h"
+
+static void free_frames(DaliFramePtr *frames, size_t count) {
+	size_t i;
+	for (i = 0; i < count; i++) {
+		daliframe_free(frames[i]);
+	}
+}
+
+// Triggers all entries that are due and checks their order
+// Returns the number of triggered entries, or -1 on error
+static long trigger(DaliSchedulePtr schedule, unsigned long now, unsigned int *ids, size_t max) {
+	DaliFramePtr frames[DALISCHEDULE_MAX_FRAMES];
+	unsigned int id;
+	unsigned long due;
+	size_t count;
+	long triggered = 0;
+	while ((count = dalischedule_next(schedule, now, frames, &id, &due)) > 0) {
+		free_frames(frames, count);
+		if (due > now) {
+			printf("Entry %u triggered %lu msec early\n", id, due - now);
+			return -1;
+		}
+		if ((size_t) triggered < max) {
+			ids[triggered] = id;
+		}
+		triggered++;
+	}
+	return triggered;
+}
+
+#define ENTRIES 5000
+#define DURATION 600000UL
+
+int main(int argc, char **argv) {
+	printf("Test 1: Trigger order\n");
+	DaliSchedulePtr schedule = dalischedule_new();
+	uint8_t on[] = { 0xfe, 0xfe };
+	uint8_t scene[] = { 0xa3, 0x80, 0x01, 0x41, 0x01, 0x41 };
+	uint8_t off[] = { 0xff, 0x00 };
+	dalischedule_add(schedule, 1, on, 1, 1000, 0);
+	dalischedule_add(schedule, 2, scene, 3, 500, 0);
+	dalischedule_add(schedule, 3, off, 1, 1000, 300);
+	dalischedule_add(schedule, 4, off, 1, 200, 0);
+	// Replaces the entry that is due at 200
+	dalischedule_add(schedule, 4, on, 1, 2000, 0);
+	if (dalischedule_length(schedule) != 4 || dalischedule_wait(schedule, 0) != 500) {
+		printf("Expected 4 entries and 500 msec to wait, got %lu and %ld\n", dalischedule_length(schedule), dalischedule_wait(schedule, 0));
+		return 1;
+	}
+	DaliFramePtr frames[DALISCHEDULE_MAX_FRAMES];
+	unsigned int id;
+	unsigned long due;
+	size_t count = dalischedule_next(schedule, 600, frames, &id, &due);
+	if (count != 3 || id != 2 || due != 500 || frames[0]->address != 0xa3 || frames[2]->command != 0x41) {
+		printf("Expected the scene batch, got %lu frames of entry %u\n", count, id);
+		return 1;
+	}
+	free_frames(frames, count);
+	unsigned int ids[16];
+	unsigned int expected[] = { 1, 3, 3, 3, 4 };
+	// At 1900, the recurring entry is late by two periods: the trigger due at 1300 is sent,
+	// the one due at 1600 is skipped and the one due at 1900 is on time
+	if (trigger(schedule, 1000, ids, 16) != 2 || trigger(schedule, 1900, ids + 2, 14) != 2 ||
+		trigger(schedule, 2000, ids + 4, 12) != 1 || dalischedule_missed(schedule) != 1) {
+		printf("Wrong trigger count\n");
+		return 1;
+	}
+	size_t i;
+	for (i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+		if (ids[i] != expected[i]) {
+			printf("Trigger %lu: expected entry %u, got %u\n", i, expected[i], ids[i]);
+			return 1;
+		}
+	}
+	if (dalischedule_length(schedule) != 1 || dalischedule_wait(schedule, 2000) != 200) {
+		printf("Only the recurring entry should be left\n");
+		return 1;
+	}
+	if (!dalischedule_remove(schedule, 3) || dalischedule_remove(schedule, 3) || dalischedule_wait(schedule, 2000) != -1) {
+		printf("Can't remove the recurring entry\n");
+		return 1;
+	}
+
+	printf("Test 2: Invalid batches\n");
+	uint8_t query[] = { 0x01, 0x90 };
+	uint8_t compare[] = { 0xa9, 0x00 };
+	uint8_t many[(DALISCHEDULE_MAX_FRAMES + 1) * 2];
+	memset(many, 0xff, sizeof(many));
+	if (dalischedule_add(schedule, 5, query, 1, 0, 0) || dalischedule_add(schedule, 5, compare, 1, 0, 0) ||
+		dalischedule_add(schedule, 5, on, 0, 0, 0) || dalischedule_add(schedule, 5, many, DALISCHEDULE_MAX_FRAMES + 1, 0, 0) ||
+		dalischedule_length(schedule) != 0) {
+		printf("An invalid batch was accepted\n");
+		return 1;
+	}
+	dalischedule_free(schedule);
+
+	printf("Test 3: Trigger jitter with %d entries\n", ENTRIES);
+	schedule = dalischedule_new();
+	srand(4711);
+	unsigned long expected_triggers = 0;
+	for (i = 0; i < ENTRIES; i++) {
+		unsigned long start = (unsigned long) rand() % 60000;
+		// A third of the entries recur every 1 to 60 seconds
+		unsigned long period = (i % 3 == 0) ? 1000 + (unsigned long) rand() % 59000 : 0;
+		uint8_t batch[] = { (uint8_t) ((i % 64) << 1), (uint8_t) (rand() % 0xfe) };
+		if (!dalischedule_add(schedule, (unsigned int) i, batch, 1, start, period)) {
+			printf("Can't add entry %lu\n", i);
+			return 1;
+		}
+		expected_triggers += period ? (DURATION - 1 - start) / period + 1 : 1;
+	}
+	// The event loop wakes up when the next entry is due, or earlier for other events,
+	// and is late by up to 2 msec after a timeout
+	unsigned long now = 0;
+	unsigned long triggers = 0;
+	unsigned long late = 0;
+	unsigned long jitter_max = 0;
+	unsigned long jitter_sum = 0;
+	unsigned long last_due = 0;
+	while (now < DURATION) {
+		while (now < DURATION && (count = dalischedule_next(schedule, now, frames, &id, &due)) > 0) {
+			free_frames(frames, count);
+			if (due > now || due < last_due) {
+				printf("Entry %u due at %lu was triggered at %lu, after one due at %lu\n", id, due, now, last_due);
+				return 1;
+			}
+			unsigned long jitter = now - due;
+			if (jitter > jitter_max) {
+				jitter_max = jitter;
+			}
+			if (jitter > 0) {
+				late++;
+			}
+			jitter_sum += jitter;
+			last_due = due;
+			triggers++;
+		}
+		long wait = dalischedule_wait(schedule, now);
+		unsigned long event = 1 + (unsigned long) rand() % 500;
+		if (wait >= 0 && (unsigned long) wait < event) {
+			now += (unsigned long) wait + (unsigned long) rand() % 3;
+		} else {
+			now += event;
+		}
+	}
+	printf("%lu triggers in %lu sec, %lu late, mean jitter %.3f msec, max %lu msec\n", triggers, DURATION / 1000, late, (double) jitter_sum / triggers, jitter_max);
+	if (triggers != expected_triggers || jitter_max > 2 || dalischedule_missed(schedule) != 0) {
+		printf("Expected %lu triggers with at most 2 msec jitter, %lu were missed\n", expected_triggers, dalischedule_missed(schedule));
+		return 1;
+	}
+	dalischedule_free(schedule);
+
+	printf("Test 4: Missed triggers\n");
+	schedule = dalischedule_new();
+	dalischedule_add(schedule, 1, on, 1, 1000, 1000);
+	// The server was blocked for 10 seconds: one late trigger, not ten
+	if (trigger(schedule, 10500, ids, 16) != 1 || dalischedule_missed(schedule) != 9 || dalischedule_wait(schedule, 10500) != 500) {
+		printf("Expected one trigger and 9 missed, got %lu missed, next in %ld msec\n", dalischedule_missed(schedule), dalischedule_wait(schedule, 10500));
+		return 1;
+	}
+	dalischedule_free(schedule);
+
+	return 0;
+}
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "state.h"
+
+static void command(DaliStatePtr state, uint8_t address, uint8_t command, unsigned long now) {
+	DaliFramePtr frame = daliframe_new(address, command);
+	dalistate_command(state, frame, now);
+	daliframe_free(frame);
+}
+
+static void response(DaliStatePtr state, uint8_t address, uint8_t command, int response, unsigned long now) {
+	DaliFramePtr frame = daliframe_new(address, command);
+	dalistate_response(state, frame, response, now);
+	daliframe_free(frame);
+}
+
+int main(int argc, char **argv) {
+	printf("Test 1: Levels\n");
+
+	DaliStatePtr state = dalistate_new();
+	const DaliDeviceState *dev = dalistate_device(state, 1);
+	if (dev->flags != 0) {
+		printf("New state not empty\n");
+		return 1;
+	}
+	// Set device 1 to 100
+	command(state, 0x02, 100, 1000);
+	if (!(dev->flags & DALISTATE_LEVEL) || dev->level != 100 || dev->changed != 1000) {
+		printf("Level not updated\n");
+		return 1;
+	}
+	// Limits apply to later levels
+	response(state, 0x03, 0xa1, 200, 1100);
+	response(state, 0x03, 0xa2, 50, 1100);
+	command(state, 0x02, 20, 1200);
+	if (dev->level != 50) {
+		printf("Level not clamped: %u\n", dev->level);
+		return 1;
+	}
+	command(state, 0x03, 0x05, 1300);
+	if (dev->level != 200) {
+		printf("Recall max not applied\n");
+		return 1;
+	}
+	// Up, the result is unknown
+	command(state, 0x03, 0x01, 1400);
+	if (dev->flags & DALISTATE_LEVEL) {
+		printf("Level still known after a step\n");
+		return 1;
+	}
+	response(state, 0x03, 0xa0, 210, 1500);
+	if (!(dev->flags & DALISTATE_LEVEL) || dev->level != 210 || !(dev->flags & DALISTATE_PRESENT)) {
+		printf("Queried level not stored\n");
+		return 1;
+	}
+	// Unchanged state doesn't update the timestamp
+	response(state, 0x03, 0xa0, 210, 1600);
+	if (dev->changed != 1500) {
+		printf("Timestamp updated without change\n");
+		return 1;
+	}
+
+	printf("Test 2: Status\n");
+
+	// Lamp failure, lamp off
+	response(state, 0x03, 0x90, DALISTATE_STATUS_LAMP_FAILURE, 2000);
+	if (!(dev->flags & DALISTATE_STATUS) || dev->level != 0) {
+		printf("Status not applied\n");
+		return 1;
+	}
+	command(state, 0x02, 100, 2100);
+	if (!(dev->status & DALISTATE_STATUS_LAMP_ON)) {
+		printf("Lamp on bit not set\n");
+		return 1;
+	}
+	// No answer to query control gear
+	response(state, 0x05, 0x91, -1, 2200);
+	if (!(dalistate_device(state, 2)->flags & DALISTATE_ABSENT)) {
+		printf("Absent device not marked\n");
+		return 1;
+	}
+
+	printf("Test 3: Groups\n");
+
+	// Device 1 is in group 3, device 2 in no group
+	response(state, 0x03, 0xc0, 0x08, 3000);
+	response(state, 0x03, 0xc1, 0x00, 3000);
+	response(state, 0x05, 0xc0, 0x00, 3000);
+	response(state, 0x05, 0xc1, 0x00, 3000);
+	if (dalistate_members(state, 3) != 0x2) {
+		printf("Wrong members: %llx\n", (unsigned long long) dalistate_members(state, 3));
+		return 1;
+	}
+	// Add device 2 to group 3
+	command(state, 0x05, 0x63, 3100);
+	if (dalistate_members(state, 3) != 0x6 || !(dalistate_device(state, 2)->groups & 0x8)) {
+		printf("Add to group not applied\n");
+		return 1;
+	}
+	// Remove device 1 from group 3
+	command(state, 0x03, 0x73, 3200);
+	if (dalistate_members(state, 3) != 0x4) {
+		printf("Remove from group not applied\n");
+		return 1;
+	}
+	// Set group 3 to 30: device 2 is a member, device 1 isn't, device 0 may be
+	command(state, 0x02, 100, 3300);
+	command(state, 0x00, 100, 3300);
+	command(state, 0x86, 30, 3400);
+	if (dalistate_device(state, 2)->level != 30 || dev->level != 100 || (dalistate_device(state, 0)->flags & DALISTATE_LEVEL)) {
+		printf("Group level not applied correctly\n");
+		return 1;
+	}
+	// Broadcast off
+	command(state, 0xff, 0x00, 3500);
+	if (dev->level != 0 || dalistate_device(state, 63)->level != 0 || !(dalistate_device(state, 63)->flags & DALISTATE_LEVEL)) {
+		printf("Broadcast not applied\n");
+		return 1;
+	}
+
+	printf("Test 4: Table\n");
+
+	char table[DALISTATE_PACKED_SIZE];
+	if (dalistate_pack(state, table, sizeof(table)) != DALISTATE_PACKED_SIZE) {
+		printf("Wrong table size\n");
+		return 1;
+	}
+	// Device 2 entry, then the member bitmap of group 3
+	if ((uint8_t) table[2 * 5 + 1] != 0 || (uint8_t) table[2 * 5 + 4] != 0x08 || (uint8_t) table[DALISTATE_DEVICES * 5 + 3 * 8 + 7] != 0x04) {
+		printf("Wrong table contents\n");
+		return 1;
+	}
+
+	printf("Test 5: Fades\n");
+
+	dalistate_free(state);
+	state = dalistate_new();
+	dev = dalistate_device(state, 4);
+	// Fade time 4 (2 seconds), fade rate 7 (45 steps per second), limits 10-250
+	response(state, 0x09, 0xa5, 0x47, 0);
+	response(state, 0x09, 0xa1, 250, 0);
+	response(state, 0x09, 0xa2, 10, 0);
+	response(state, 0x09, 0xa0, 100, 0);
+	command(state, 0x08, 200, 1000);
+	int fading;
+	int level = dalistate_estimate(state, 4, 1000, &fading);
+	if (level != 100 || !fading) {
+		printf("Wrong level at fade start: %d %d\n", level, fading);
+		return 1;
+	}
+	level = dalistate_estimate(state, 4, 2000, &fading);
+	if (level != 150 || !fading) {
+		printf("Wrong level during fade: %d %d\n", level, fading);
+		return 1;
+	}
+	level = dalistate_estimate(state, 4, 3000, &fading);
+	if (level != 200 || fading) {
+		printf("Wrong level after fade: %d %d\n", level, fading);
+		return 1;
+	}
+	// A new level interrupts the fade where it is
+	command(state, 0x08, 100, 3500);
+	command(state, 0x08, 200, 4500);
+	level = dalistate_estimate(state, 4, 4500, &fading);
+	if (level != 150) {
+		printf("Wrong start of interrupted fade: %d\n", level);
+		return 1;
+	}
+	// Up moves 9 steps in 200 msec
+	command(state, 0x09, 0x01, 7000);
+	level = dalistate_estimate(state, 4, 7200, &fading);
+	if (level != 209) {
+		printf("Wrong level after up: %d\n", level);
+		return 1;
+	}
+	// Fade time 0 from the DTR
+	command(state, 0xa3, 0x00, 8000);
+	command(state, 0x09, 0x2e, 8000);
+	command(state, 0x08, 50, 8000);
+	level = dalistate_estimate(state, 4, 8000, &fading);
+	if (level != 50 || fading || dev->fade != 0x07) {
+		printf("Fade time not learned from DTR: %d %02x\n", level, dev->fade);
+		return 1;
+	}
+	// Unknown level
+	command(state, 0x09, 0x10, 9000);
+	if (dalistate_estimate(state, 4, 9000, &fading) != -1) {
+		printf("Level known after scene\n");
+		return 1;
+	}
+
+	dalistate_free(state);
+
+	printf("Test 6: Inventory\n");
+
+	state = dalistate_new();
+	// Device 0 answers, device 1 doesn't
+	response(state, 0x01, 0x91, 0xff, 1000);
+	response(state, 0x03, 0x91, -1, 1000);
+	if (dalistate_inventory(state, DALISTATE_PRESENT) != 0x1 || dalistate_inventory(state, DALISTATE_ABSENT) != 0x2) {
+		printf("Wrong inventory\n");
+		return 1;
+	}
+	if (!dalistate_absent(state, 1, 1500, 1000) || dalistate_absent(state, 1, 2000, 1000) || dalistate_absent(state, 0, 1500, 1000)) {
+		printf("Wrong absence\n");
+		return 1;
+	}
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/teststate%d", (int) getpid());
+	if (!dalistate_save_inventory(state, path)) {
+		printf("Can't save inventory\n");
+		return 1;
+	}
+	dalistate_free(state);
+	state = dalistate_new();
+	if (!dalistate_load_inventory(state, path, 5000)) {
+		printf("Can't load inventory\n");
+		return 1;
+	}
+	unlink(path);
+	if (dalistate_inventory(state, DALISTATE_PRESENT) != 0x1 || !dalistate_absent(state, 1, 5500, 1000)) {
+		printf("Inventory not restored\n");
+		return 1;
+	}
+	// A device was given the address
+	command(state, 0xb7, 0x03, 6000);
+	if (dalistate_absent(state, 1, 6000, 1000)) {
+		printf("Programmed address still absent\n");
+		return 1;
+	}
+
+	dalistate_free(state);
+
+	return 0;
+}